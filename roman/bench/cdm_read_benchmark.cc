@@ -0,0 +1,162 @@
+// Measures reading a cdm image through libmirage: how long loading the image
+// takes, and how fast its sectors read sequentially, at random across the
+// disc, and at random among a few hot sectors. Needs image-cdm.so installed in
+// libmirage's plugin directory.
+//
+// Example usage:
+//   bazel run -c opt //roman/bench:cdm_read_benchmark -- --image=$PWD/game.cdm
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+#include "mirage/mirage.h"
+
+ABSL_FLAG(std::string, image, "", "The .cdm image to read.");
+ABSL_FLAG(int, iterations, 10, "Number of times to load the image.");
+ABSL_FLAG(int, random_reads, 10000, "Number of sectors to read at random.");
+ABSL_FLAG(int, hot_sectors, 256,
+          "Number of sectors the hot random reads are spread over.");
+
+namespace roman {
+namespace {
+
+// Keeps the compiler from dropping the sectors read.
+std::int64_t checksum = 0;
+
+MirageDisc *LoadImage(MirageContext *context, const std::string &image) {
+  const gchar *filenames[] = {image.c_str(), nullptr};
+  GError *error = nullptr;
+  MirageDisc *disc = mirage_context_load_image(
+      context, const_cast<gchar **>(filenames), &error);
+  if (!disc) {
+    absl::FPrintF(stderr, "Failed to load %s: %s\n", image, error->message);
+    g_error_free(error);
+  }
+  return disc;
+}
+
+bool ReadSector(MirageDisc *disc, gint address) {
+  GError *error = nullptr;
+  MirageSector *sector = mirage_disc_get_sector(disc, address, &error);
+  if (!sector) {
+    absl::FPrintF(stderr, "Failed to read sector %d: %s\n", address,
+                  error->message);
+    g_error_free(error);
+    return false;
+  }
+  const guint8 *data = nullptr;
+  gint length = 0;
+  bool ok = mirage_sector_get_data(sector, &data, &length, &error);
+  if (ok) {
+    checksum += data[0] + data[length - 1];
+  } else {
+    absl::FPrintF(stderr, "Failed to read sector %d: %s\n", address,
+                  error->message);
+    g_error_free(error);
+  }
+  g_object_unref(sector);
+  return ok;
+}
+
+// Reads the sectors at `addresses`, and prints how fast.
+bool Measure(const char *name, MirageDisc *disc,
+             const std::vector<gint> &addresses) {
+  absl::Time start = absl::Now();
+  for (gint address : addresses) {
+    if (!ReadSector(disc, address)) return false;
+  }
+  absl::Duration elapsed = absl::Now() - start;
+  absl::PrintF("%-19s%d sectors in %s, %.0f sectors/s\n", name,
+               addresses.size(), absl::FormatDuration(elapsed),
+               addresses.size() / absl::ToDoubleSeconds(elapsed));
+  return true;
+}
+
+bool Main() {
+  std::string image = absl::GetFlag(FLAGS_image);
+  if (image.empty()) {
+    absl::FPrintF(stderr, "--image is required\n");
+    return false;
+  }
+
+  GError *error = nullptr;
+  if (!mirage_initialize(&error)) {
+    absl::FPrintF(stderr, "Failed to initialize libmirage: %s\n",
+                  error->message);
+    g_error_free(error);
+    return false;
+  }
+  auto *context =
+      static_cast<MirageContext *>(g_object_new(MIRAGE_TYPE_CONTEXT, nullptr));
+
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  absl::Duration best = absl::InfiniteDuration();
+  absl::Duration total;
+  for (int i = 0; i < iterations; i++) {
+    absl::Time start = absl::Now();
+    MirageDisc *disc = LoadImage(context, image);
+    absl::Duration elapsed = absl::Now() - start;
+    if (!disc) return false;
+    g_object_unref(disc);
+    total += elapsed;
+    best = std::min(best, elapsed);
+  }
+  absl::PrintF("load best:         %s\n", absl::FormatDuration(best));
+  absl::PrintF("load mean:         %s\n",
+               absl::FormatDuration(total / iterations));
+
+  MirageDisc *disc = LoadImage(context, image);
+  if (!disc) return false;
+  gint start = mirage_disc_layout_get_start_sector(disc);
+  gint length = mirage_disc_layout_get_length(disc);
+  // The lead-in before the first track has no data.
+  gint first = std::max(start, 0);
+  absl::PrintF("sectors:           %d\n", start + length - first);
+
+  std::vector<gint> sequential;
+  for (gint address = first; address < start + length; address++) {
+    sequential.push_back(address);
+  }
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<gint> any_sector(first, start + length - 1);
+  std::vector<gint> random(absl::GetFlag(FLAGS_random_reads));
+  for (gint &address : random) address = any_sector(rng);
+  std::vector<gint> hot_set(absl::GetFlag(FLAGS_hot_sectors));
+  for (gint &address : hot_set) address = any_sector(rng);
+  std::uniform_int_distribution<std::size_t> any_hot(0, hot_set.size() - 1);
+  std::vector<gint> hot(random.size());
+  for (gint &address : hot) address = hot_set[any_hot(rng)];
+
+  bool ok = Measure("sequential:", disc, sequential) &&
+            Measure("random:", disc, random) &&
+            Measure("random, hot:", disc, hot);
+  absl::PrintF("checksum:          %d\n", checksum);
+
+  g_object_unref(disc);
+  g_object_unref(context);
+  mirage_shutdown(nullptr);
+  return ok;
+}
+
+}  // namespace
+}  // namespace roman
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(
+      "Benchmark loading and reading a cdm image.\n"
+      "Usage: cdm_read_benchmark --image=<image.cdm> [options]");
+  absl::ParseCommandLine(argc, argv);
+  return roman::Main() ? 0 : 1;
+}
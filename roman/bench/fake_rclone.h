@@ -0,0 +1,212 @@
+#ifndef ROMAN_BENCH_FAKE_RCLONE_H_
+#define ROMAN_BENCH_FAKE_RCLONE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "nlohmann/json.hpp"
+#include "rhutil/status.h"
+
+namespace roman {
+
+// A local stand-in for `rclone rcd --rc-serve`, serving a synthetic tree on a
+// single remote named "fake:". It implements the subset of the rc API roman
+// talks to: operations/fsinfo, operations/list and operations/hashsum
+// (optionally as async jobs polled through job/status) and ranged reads of
+// file contents through the rc-serve file endpoint (GET /[fake:]/path).
+//
+// The tree has Options::num_files files of Options::file_size bytes each,
+// spread over directories of Options::files_per_dir files. File contents are
+// derived from Options::seed, so repeated runs serve identical trees and
+// identical hashes. With Options::extra_files_per_dir, each directory also
+// holds files which aren't ROMs, like the artwork next to real collections.
+class FakeRClone {
+ public:
+  struct Options {
+    int num_files = 10000;
+    int files_per_dir = 100;
+    std::int64_t file_size = 1024;
+    // Artwork files added to every directory on top of files_per_dir.
+    int extra_files_per_dir = 0;
+
+    // Added to the service time of every request.
+    absl::Duration latency = absl::ZeroDuration();
+    // The time the backend takes to list each directory, as a real remote
+    // would while walking the tree.
+    absl::Duration dir_latency = absl::ZeroDuration();
+    // Fraction of rc calls which fail with an HTTP 500.
+    double error_rate = 0;
+    // If positive, rc calls beyond this many per second are rejected the way
+    // rclone reports a backend rate limit. job/status is never limited.
+    double rate_limit = 0;
+
+    // Whether the remote reports hashes, as most backends do. Without them it
+    // behaves like e.g. crypt, whose files can only be hashed by downloading
+    // them through operations/hashsum.
+    bool hashes = true;
+    // Bytes per second at which each download proceeds. 0 means unlimited.
+    std::int64_t download_bandwidth = 0;
+
+    std::uint64_t seed = 1;
+
+    // 0 picks an unused port.
+    int port = 0;
+  };
+
+  struct File {
+    std::string path;
+    std::string name;
+    std::int64_t size;
+    std::string md5;
+    std::string sha1;
+    // False for the extra files, which no dat describes.
+    bool rom = true;
+  };
+
+  // The subset of rclone's filtering that roman uses: include rules (with
+  // the glob syntax *, **, ?, {a,b} and \ escapes), --ignore-case and size
+  // bounds.
+  struct Filter {
+    std::vector<std::string> include_rules;
+    bool ignore_case = false;
+    // Negative means unbounded.
+    std::int64_t min_size = -1;
+    std::int64_t max_size = -1;
+
+    // From the _filter parameter of an rc call.
+    static Filter FromRc(const nlohmann::json &filter);
+
+    bool empty() const;
+    // Whether to list the file at `path`, relative to the listed fs.
+    bool Matches(std::string_view path, std::int64_t size) const;
+  };
+
+  struct Stats {
+    std::int64_t requests = 0;
+    std::int64_t injected_errors = 0;
+    std::int64_t throttled = 0;
+    std::int64_t bytes_downloaded = 0;
+    // Response bodies, e.g. listings, including file contents.
+    std::int64_t bytes_sent = 0;
+    // Service time of every request, in arrival order.
+    std::vector<absl::Duration> latencies;
+  };
+
+  static rhutil::StatusOr<std::unique_ptr<FakeRClone>> Start(
+      const Options &opts);
+
+  // Passes `opts` to a fake_rclone_cli started from this process, through the
+  // environment.
+  static void ExportOptions(const Options &opts);
+  static Options OptionsFromEnvironment();
+
+  // The tree served for `opts`, in listing order, or just the part of it
+  // under `prefix`.
+  static std::vector<File> MakeFiles(const Options &opts,
+                                     std::string_view prefix = "");
+  // Like MakeFiles, but passes each file to `callback` as it is made, and
+  // leaves their hashes empty unless `hash`.
+  static void ForEachFile(const Options &opts, std::string_view prefix,
+                          bool hash,
+                          const std::function<void(File file)> &callback);
+  // The contents of the `file_index`th file of the tree.
+  static std::string Content(const Options &opts, std::size_t file_index);
+  // The operations/list (or lsjson) entry for `file`. `hash_types` selects
+  // hashes by rclone name; empty means all of them.
+  static nlohmann::json ListEntry(const Options &opts, const File &file,
+                                  std::string_view path, bool show_hash,
+                                  bool mod_time,
+                                  const std::vector<std::string> &hash_types);
+
+  ~FakeRClone();
+
+  FakeRClone(const FakeRClone &) = delete;
+  FakeRClone &operator=(const FakeRClone &) = delete;
+
+  int port() const { return port_; }
+  // An --rclone_url suitable for talking to this server.
+  std::string url() const;
+
+  const std::vector<File> &files() const { return files_; }
+
+  Stats GetStats() const;
+  void ResetStats();
+
+ private:
+  struct Request {
+    std::string method;
+    std::string target;
+    std::string range;
+    std::string body;
+    bool keep_alive = true;
+  };
+
+  struct Response {
+    int code = 200;
+    std::string content_type = "application/json";
+    std::string content_range;
+    std::string body;
+  };
+
+  struct Job {
+    bool finished = false;
+    nlohmann::json result;
+    rhutil::Status status;
+  };
+
+  explicit FakeRClone(const Options &opts);
+
+  void AcceptLoop();
+  void ServeConnection(int fd);
+  Response Handle(const Request &req);
+  Response HandleRc(std::string_view method, const nlohmann::json &params);
+  Response HandleCat(const Request &req);
+
+  rhutil::StatusOr<nlohmann::json> Call(std::string_view method,
+                                        const nlohmann::json &params);
+  rhutil::StatusOr<nlohmann::json> OperationsFsInfo(
+      const nlohmann::json &params);
+  rhutil::StatusOr<nlohmann::json> OperationsList(const nlohmann::json &params);
+  rhutil::StatusOr<nlohmann::json> OperationsHashsum(
+      const nlohmann::json &params);
+  rhutil::StatusOr<nlohmann::json> JobStatus(const nlohmann::json &params);
+
+  std::string Content(std::size_t file_index) const {
+    return Content(opts_, file_index);
+  }
+  bool InjectError();
+  bool Throttle();
+  // Accounts for, and takes as long as, downloading `bytes`.
+  void Download(std::int64_t bytes);
+
+  const Options opts_;
+  std::vector<File> files_;
+  absl::flat_hash_map<std::string, std::size_t> files_by_path_;
+
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread accept_thread_;
+
+  mutable absl::Mutex mu_;
+  bool stopping_ GUARDED_BY(mu_) = false;
+  std::vector<int> conn_fds_ GUARDED_BY(mu_);
+  std::vector<std::thread> conn_threads_ GUARDED_BY(mu_);
+  std::vector<std::thread> job_threads_ GUARDED_BY(mu_);
+  std::vector<Job> jobs_ GUARDED_BY(mu_);
+  Stats stats_ GUARDED_BY(mu_);
+  std::uint64_t rng_state_ GUARDED_BY(mu_);
+  absl::Time rate_window_start_ GUARDED_BY(mu_) = absl::InfinitePast();
+  std::int64_t rate_window_requests_ GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_BENCH_FAKE_RCLONE_H_
@@ -0,0 +1,190 @@
+// A stand-in for the rclone command line serving the same synthetic tree as
+// FakeRClone, for benchmarking roman index --rclone_listing=lsjson. Supports
+//   rclone [flags] lsjson [flags] fake:path
+// with the filtering flags roman passes (see FakeRClone::Filter), and
+//   rclone [flags] backend features fake:
+// The tree is configured through the environment; see
+// FakeRClone::ExportOptions.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "nlohmann/json.hpp"
+#include "roman/bench/fake_rclone.h"
+
+namespace roman {
+namespace {
+
+using json = ::nlohmann::json;
+
+constexpr char kFs[] = "fake:";
+// rclone's exit code for a missing directory.
+constexpr int kExitDirNotFound = 3;
+
+struct Args {
+  std::vector<std::string> positional;
+  bool recursive = false;
+  bool hash = false;
+  bool no_mod_time = false;
+  bool dirs_only = false;
+  std::vector<std::string> hash_types;
+  FakeRClone::Filter filter;
+};
+
+// Parses an rclone size such as "1024B" or "4k". Without a suffix, rclone
+// reads KiB.
+std::int64_t ParseSize(std::string_view value) {
+  std::int64_t multiplier = 1024;
+  if (!value.empty()) {
+    switch (absl::ascii_tolower(value.back())) {
+      case 'b': multiplier = 1; break;
+      case 'k': multiplier = 1024; break;
+      case 'm': multiplier = 1024 * 1024; break;
+      case 'g': multiplier = 1024 * 1024 * 1024; break;
+    }
+    if (!absl::ascii_isdigit(value.back())) value.remove_suffix(1);
+  }
+  std::int64_t size = -1;
+  if (!absl::SimpleAtoi(value, &size)) return -1;
+  return size * multiplier;
+}
+
+Args ParseArgs(int argc, char *argv[]) {
+  Args args;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-R" || arg == "--recursive") {
+      args.recursive = true;
+    } else if (arg == "--hash") {
+      args.hash = true;
+    } else if (arg == "--no-modtime") {
+      args.no_mod_time = true;
+    } else if (arg == "--dirs-only") {
+      args.dirs_only = true;
+    } else if (arg == "--hash-type" && i + 1 < argc) {
+      args.hash_types.push_back(argv[++i]);
+    } else if (absl::ConsumePrefix(&arg, "--hash-type=")) {
+      args.hash_types.emplace_back(arg);
+    } else if (arg == "--include" && i + 1 < argc) {
+      args.filter.include_rules.push_back(argv[++i]);
+    } else if (arg == "--ignore-case") {
+      args.filter.ignore_case = true;
+    } else if (arg == "--min-size" && i + 1 < argc) {
+      args.filter.min_size = ParseSize(argv[++i]);
+    } else if (arg == "--max-size" && i + 1 < argc) {
+      args.filter.max_size = ParseSize(argv[++i]);
+    } else if (arg == "--config" && i + 1 < argc) {
+      i++;
+    } else if (!absl::StartsWith(arg, "-")) {
+      args.positional.emplace_back(arg);
+    }
+  }
+  // The fake names hashes the way older versions of rclone do.
+  for (std::string &type : args.hash_types) {
+    std::string normalized =
+        absl::StrReplaceAll(absl::AsciiStrToLower(type), {{"-", ""}});
+    if (normalized == "md5") type = "MD5";
+    if (normalized == "sha1") type = "SHA-1";
+  }
+  return args;
+}
+
+int BackendFeatures(const FakeRClone::Options &opts) {
+  json features = {
+    {"Name", "fake"},
+    {"Root", ""},
+    {"String", "Fake root ''"},
+    {"Precision", 1000000000},
+    {"Hashes", opts.hashes ? json{"MD5", "SHA-1"} : json::array()},
+    {"Features", json::object()},
+  };
+  std::cout << features.dump(1, '\t') << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int Lsjson(const FakeRClone::Options &opts, const Args &args,
+           std::string_view path) {
+  std::string dir(absl::StripSuffix(absl::StripPrefix(path, "/"), "/"));
+  std::string prefix = dir.empty() ? "" : absl::StrCat(dir, "/");
+
+  absl::SleepFor(opts.dir_latency);
+  bool found = dir.empty();
+  bool first = true;
+  std::string last_dir;
+  // Entries are printed as they are made, as rclone does, and hashed only
+  // when listed with them, so that the fake costs little next to roman.
+  FakeRClone::ForEachFile(
+      opts, prefix, /*hash=*/args.hash && opts.hashes,
+      [&](FakeRClone::File file) {
+        found = true;
+        std::string_view rest =
+            std::string_view(file.path).substr(prefix.size());
+        std::size_t slash = rest.find('/');
+        if (slash != std::string_view::npos) {
+          std::string subdir(rest.substr(0, slash));
+          bool new_dir = subdir != last_dir;
+          last_dir = subdir;
+          if (args.dirs_only) {
+            if (!new_dir) return;
+            std::cout << (first ? "[\n" : ",\n");
+            first = false;
+            std::cout << json{{"Path", subdir}, {"Name", subdir}, {"Size", -1},
+                              {"IsDir", true}}.dump();
+            return;
+          }
+          if (!args.recursive) return;
+          if (new_dir) absl::SleepFor(opts.dir_latency);
+        }
+        if (args.dirs_only) return;
+        if (!args.filter.Matches(rest, file.size)) return;
+
+        std::cout << (first ? "[\n" : ",\n");
+        first = false;
+        std::cout << FakeRClone::ListEntry(opts, file, rest, args.hash,
+                                           !args.no_mod_time, args.hash_types)
+                         .dump();
+      });
+  if (!found) {
+    std::cerr << "ERROR : error listing: directory not found" << std::endl;
+    return kExitDirNotFound;
+  }
+  std::cout << (first ? "[\n" : "\n") << "]" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int Main(int argc, char *argv[]) {
+  Args args = ParseArgs(argc, argv);
+  FakeRClone::Options opts = FakeRClone::OptionsFromEnvironment();
+
+  const std::vector<std::string> &pos = args.positional;
+  std::string_view path = pos.empty() ? "" : pos.back();
+  if (pos.size() < 2 || !absl::ConsumePrefix(&path, kFs)) {
+    std::cerr << "usage: fake_rclone_cli lsjson|backend features fake:path"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (pos[0] == "lsjson") return Lsjson(opts, args, path);
+  if (pos[0] == "backend" && pos[1] == "features") {
+    return BackendFeatures(opts);
+  }
+  std::cerr << "unsupported command " << pos[0] << std::endl;
+  return EXIT_FAILURE;
+}
+
+}  // namespace
+}  // namespace roman
+
+int main(int argc, char *argv[]) {
+  return roman::Main(argc, argv);
+}
@@ -0,0 +1,75 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include <pthread.h>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/time/time.h"
+#include "roman/bench/fake_rclone.h"
+
+ABSL_FLAG(int, port, 5572, "Port to listen on. 0 picks an unused port.");
+ABSL_FLAG(int, num_files, 10000, "Number of files in the synthetic tree.");
+ABSL_FLAG(int, files_per_dir, 100, "Number of files in each directory.");
+ABSL_FLAG(int64_t, file_size, 1024, "Size of each file in bytes.");
+ABSL_FLAG(absl::Duration, latency, absl::ZeroDuration(),
+          "Latency added to every request.");
+ABSL_FLAG(absl::Duration, dir_latency, absl::ZeroDuration(),
+          "Time the remote takes to list each directory.");
+ABSL_FLAG(double, error_rate, 0,
+          "Fraction of rc calls which fail with an HTTP 500.");
+ABSL_FLAG(bool, hashes, true,
+          "Whether the remote reports hashes. Without them, files can only be "
+          "hashed by downloading them.");
+ABSL_FLAG(int64_t, download_bandwidth, 0,
+          "Bytes per second at which each download proceeds. 0 means "
+          "unlimited.");
+ABSL_FLAG(double, rate_limit, 0,
+          "Rc calls per second beyond which calls fail as rate limited. 0 "
+          "means unlimited.");
+ABSL_FLAG(uint64_t, seed, 1, "Seed for the synthetic file contents.");
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(
+      "Serve a synthetic tree over a subset of the rclone rc API.\n"
+      "Usage: fake_rclone [options]");
+  absl::ParseCommandLine(argc, argv);
+
+  roman::FakeRClone::Options opts;
+  opts.port = absl::GetFlag(FLAGS_port);
+  opts.num_files = absl::GetFlag(FLAGS_num_files);
+  opts.files_per_dir = absl::GetFlag(FLAGS_files_per_dir);
+  opts.file_size = absl::GetFlag(FLAGS_file_size);
+  opts.latency = absl::GetFlag(FLAGS_latency);
+  opts.dir_latency = absl::GetFlag(FLAGS_dir_latency);
+  opts.error_rate = absl::GetFlag(FLAGS_error_rate);
+  opts.rate_limit = absl::GetFlag(FLAGS_rate_limit);
+  opts.hashes = absl::GetFlag(FLAGS_hashes);
+  opts.download_bandwidth = absl::GetFlag(FLAGS_download_bandwidth);
+  opts.seed = absl::GetFlag(FLAGS_seed);
+
+  // Block the signals before any server threads exist so that they all
+  // inherit the mask, then wait for them on the main thread.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  auto server_or = roman::FakeRClone::Start(opts);
+  if (!server_or.ok()) {
+    std::cerr << server_or.status() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::unique_ptr<roman::FakeRClone> server = std::move(server_or).value();
+  std::cerr << "Serving " << server->files().size() << " files at "
+            << server->url() << " as remote fake:" << std::endl;
+
+  int signal;
+  sigwait(&signals, &signal);
+
+  return EXIT_SUCCESS;
+}
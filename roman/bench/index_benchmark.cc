@@ -0,0 +1,311 @@
+// Runs `roman index` against a FakeRClone serving a synthetic tree, and reports
+// throughput, latency percentiles and peak RSS for each listing backend.
+//
+// Example usage, with each command wrapped here but run as a single line:
+//   bazel run -c opt //roman/bench:index_benchmark --
+//       --num_files=100000 --latency=5ms --iterations=5 --rate_limit=20
+//   bazel run -c opt //roman/bench:index_benchmark --
+//       --num_files=1000000 --dir_latency=1ms --backends=rc,lsjson
+//   bazel run -c opt //roman/bench:index_benchmark --
+//       --extra_files_per_dir=20 --index_args=--nofilter_listing
+//   bazel run -c opt //roman/bench:index_benchmark --
+//       --num_files=1000000 --dat_coverage=0.01 --index_args=--game_folders
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/status.h"
+#include "roman/bench/fake_rclone.h"
+
+ABSL_FLAG(std::string, roman, "roman/roman", "Path to the roman binary.");
+ABSL_FLAG(int, iterations, 3, "Number of times to run index.");
+ABSL_FLAG(int, num_files, 10000, "Number of files in the synthetic tree.");
+ABSL_FLAG(int, files_per_dir, 100, "Number of files in each directory.");
+ABSL_FLAG(int64_t, file_size, 1024, "Size of each file in bytes.");
+ABSL_FLAG(int, extra_files_per_dir, 0,
+          "Artwork files in each directory, which the dat doesn't describe.");
+ABSL_FLAG(absl::Duration, latency, absl::ZeroDuration(),
+          "Latency added to every rc request.");
+ABSL_FLAG(absl::Duration, dir_latency, absl::ZeroDuration(),
+          "Time the remote takes to list each directory.");
+ABSL_FLAG(double, error_rate, 0,
+          "Fraction of rc calls which fail with an HTTP 500.");
+ABSL_FLAG(bool, hashes, true,
+          "Whether the remote reports hashes. Without them, files can only be "
+          "hashed by downloading them.");
+ABSL_FLAG(int64_t, download_bandwidth, 0,
+          "Bytes per second at which each download proceeds. 0 means "
+          "unlimited.");
+ABSL_FLAG(double, rate_limit, 0,
+          "Rc calls per second beyond which the fake rclone fails calls as "
+          "rate limited. 0 means unlimited.");
+ABSL_FLAG(double, dat_coverage, 0.9,
+          "Fraction of the synthetic directories which appear as games in "
+          "the generated dat. The remaining files are unidentifiable.");
+ABSL_FLAG(std::vector<std::string>, backends, {"rc"},
+          "The --rclone_listing backends to benchmark.");
+ABSL_FLAG(std::string, rclone_cli, "roman/bench/fake_rclone_cli",
+          "Path to the fake rclone binary used by the lsjson backend.");
+ABSL_FLAG(std::vector<std::string>, index_args, {},
+          "Additional arguments passed to roman index.");
+
+extern char **environ;
+
+namespace roman {
+namespace {
+
+using ::dat2pb::RomDat;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::OkStatus;
+using ::rhutil::UnknownErrorBuilder;
+
+struct Run {
+  bool ok;
+  absl::Duration wall;
+  long max_rss_kb;
+};
+
+Status WriteDat(const FakeRClone &server, double coverage,
+                const std::string &path) {
+  RomDat dat;
+  std::string_view last_dir;
+  RomDat::Game *game = nullptr;
+  int num_dirs = 0;
+  for (const FakeRClone::File &file : server.files()) {
+    std::string_view dir =
+        std::string_view(file.path).substr(0, file.path.find('/'));
+    if (dir != last_dir) {
+      last_dir = dir;
+      num_dirs++;
+      // Spread the covered games evenly across the tree.
+      bool covered = static_cast<int>(num_dirs * coverage) !=
+                     static_cast<int>((num_dirs - 1) * coverage);
+      game = covered ? dat.add_game() : nullptr;
+      // Named after their folders, for --game_folders.
+      if (game) game->set_name(std::string(dir));
+    }
+    if (game == nullptr || !file.rom) continue;
+    RomDat::Game::Rom *rom = game->add_rom();
+    rom->set_name(file.name);
+    rom->set_size(file.size);
+    rom->set_md5(file.md5);
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!dat.SerializeToOstream(&out)) {
+    return UnknownErrorBuilder() << "Failed to write romdat to " << path;
+  }
+  return OkStatus();
+}
+
+// How often a running roman's peak RSS is sampled.
+constexpr absl::Duration kRssPollInterval = absl::Milliseconds(5);
+
+// The VmHWM of the live process `pid`, or 0 if it can't be read.
+long PeakRssKb(pid_t pid) {
+  std::ifstream status(absl::StrCat("/proc/", pid, "/status"));
+  std::string line;
+  while (std::getline(status, line)) {
+    std::string_view value = line;
+    if (!absl::ConsumePrefix(&value, "VmHWM:")) continue;
+    long kb = 0;
+    absl::SimpleAtoi(absl::StripSuffix(absl::StripAsciiWhitespace(value), "kB"),
+                     &kb);
+    return kb;
+  }
+  return 0;
+}
+
+StatusOr<Run> RunIndex(const std::vector<std::string> &args) {
+  std::vector<char *> argv;
+  for (const std::string &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+
+  absl::Time start = absl::Now();
+  pid_t pid;
+  int err = posix_spawn(&pid, argv[0], &actions, /*attrp=*/nullptr,
+                        argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    return UnknownErrorBuilder()
+        << "Failed to spawn " << argv[0] << ": " << std::strerror(err);
+  }
+
+  // wait4's ru_maxrss would also cover the children roman waits for, such as
+  // the fake rclone lsjson, so roman's own high water mark is sampled instead
+  // until it exits. Growth in its last poll interval may be missed.
+  Run run;
+  run.max_rss_kb = 0;
+  int wstatus;
+  while (true) {
+    run.max_rss_kb = std::max(run.max_rss_kb, PeakRssKb(pid));
+    pid_t waited = waitpid(pid, &wstatus, WNOHANG);
+    if (waited == -1) {
+      return UnknownErrorBuilder() << "waitpid: " << std::strerror(errno);
+    }
+    if (waited == pid) break;
+    absl::SleepFor(kRssPollInterval);
+  }
+  run.wall = absl::Now() - start;
+  run.ok = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0;
+  return run;
+}
+
+absl::Duration Percentile(std::vector<absl::Duration> values, double p) {
+  if (values.empty()) return absl::ZeroDuration();
+  std::sort(values.begin(), values.end());
+  std::size_t i = static_cast<std::size_t>(p * (values.size() - 1) + 0.5);
+  return values[i];
+}
+
+Status Main() {
+  FakeRClone::Options opts;
+  opts.num_files = absl::GetFlag(FLAGS_num_files);
+  opts.files_per_dir = absl::GetFlag(FLAGS_files_per_dir);
+  opts.file_size = absl::GetFlag(FLAGS_file_size);
+  opts.extra_files_per_dir = absl::GetFlag(FLAGS_extra_files_per_dir);
+  opts.latency = absl::GetFlag(FLAGS_latency);
+  opts.dir_latency = absl::GetFlag(FLAGS_dir_latency);
+  opts.error_rate = absl::GetFlag(FLAGS_error_rate);
+  opts.rate_limit = absl::GetFlag(FLAGS_rate_limit);
+  opts.hashes = absl::GetFlag(FLAGS_hashes);
+  opts.download_bandwidth = absl::GetFlag(FLAGS_download_bandwidth);
+  ASSIGN_OR_RETURN(std::unique_ptr<FakeRClone> server, FakeRClone::Start(opts));
+
+  char dat_path[] = "/tmp/index_benchmark.XXXXXX";
+  int dat_fd = mkstemp(dat_path);
+  if (dat_fd == -1) {
+    return UnknownErrorBuilder() << "mkstemp: " << std::strerror(errno);
+  }
+  close(dat_fd);
+  RETURN_IF_ERROR(
+      WriteDat(*server, absl::GetFlag(FLAGS_dat_coverage), dat_path));
+
+  // Each iteration starts without cached hashes, so that they all download
+  // the same files.
+  std::string hash_cache = absl::StrCat(dat_path, ".hashes");
+  FakeRClone::ExportOptions(opts);
+
+  for (const std::string &backend : absl::GetFlag(FLAGS_backends)) {
+    std::vector<std::string> args = {
+      absl::GetFlag(FLAGS_roman),
+      "index",
+      absl::StrCat("--rclone_url=", server->url()),
+      absl::StrCat("--rclone_listing=", backend),
+      absl::StrCat("--rclone_binary=", absl::GetFlag(FLAGS_rclone_cli)),
+      "--recursive",
+      "--binary",
+      absl::StrCat("--hash_cache=", hash_cache),
+    };
+    if (!opts.hashes) args.push_back("--download_unhashed");
+    for (const std::string &arg : absl::GetFlag(FLAGS_index_args)) {
+      args.push_back(arg);
+    }
+    args.push_back(dat_path);
+    args.push_back("fake:/");
+
+    std::vector<absl::Duration> walls;
+    std::vector<absl::Duration> request_latencies;
+    std::int64_t requests = 0, injected_errors = 0, throttled = 0;
+    std::int64_t bytes_downloaded = 0, bytes_sent = 0;
+    long max_rss_kb = 0;
+    int failures = 0;
+    int iterations = absl::GetFlag(FLAGS_iterations);
+    for (int i = 0; i < iterations; i++) {
+      server->ResetStats();
+      unlink(hash_cache.c_str());
+      ASSIGN_OR_RETURN(Run run, RunIndex(args));
+      FakeRClone::Stats stats = server->GetStats();
+      requests += stats.requests;
+      injected_errors += stats.injected_errors;
+      throttled += stats.throttled;
+      bytes_downloaded += stats.bytes_downloaded;
+      bytes_sent += stats.bytes_sent;
+      request_latencies.insert(request_latencies.end(),
+                               stats.latencies.begin(), stats.latencies.end());
+      if (!run.ok) {
+        failures++;
+        continue;
+      }
+      walls.push_back(run.wall);
+      max_rss_kb = std::max(max_rss_kb, run.max_rss_kb);
+    }
+
+    absl::PrintF("backend:           %s\n", backend);
+    absl::PrintF("files:             %d\n", opts.num_files);
+    absl::PrintF("iterations:        %d (%d failed)\n", iterations, failures);
+    absl::PrintF("rc requests:       %d (%d injected errors, %d throttled)\n",
+                 requests, injected_errors, throttled);
+    absl::PrintF("bytes downloaded:  %d\n", bytes_downloaded);
+    absl::PrintF("bytes sent:        %d\n", bytes_sent);
+    if (!walls.empty()) {
+      absl::Duration median = Percentile(walls, 0.5);
+      absl::PrintF("throughput:        %.0f files/s\n",
+                   opts.num_files / absl::ToDoubleSeconds(median));
+      absl::PrintF("wall p50/p90/p99:  %s / %s / %s\n",
+                   absl::FormatDuration(median),
+                   absl::FormatDuration(Percentile(walls, 0.9)),
+                   absl::FormatDuration(Percentile(walls, 0.99)));
+      absl::PrintF("peak rss:          %d KiB\n", max_rss_kb);
+    }
+    absl::PrintF("rc p50/p90/p99:    %s / %s / %s\n\n",
+                 absl::FormatDuration(Percentile(request_latencies, 0.5)),
+                 absl::FormatDuration(Percentile(request_latencies, 0.9)),
+                 absl::FormatDuration(Percentile(request_latencies, 0.99)));
+  }
+  unlink(dat_path);
+  unlink(hash_cache.c_str());
+
+  return OkStatus();
+}
+
+}  // namespace
+}  // namespace roman
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(
+      "Benchmark roman index against a local rclone stand-in.\n"
+      "Usage: index_benchmark [options]");
+  absl::ParseCommandLine(argc, argv);
+
+  if (auto err = roman::Main(); !err.ok()) {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
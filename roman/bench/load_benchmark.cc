@@ -0,0 +1,205 @@
+// Compares ways of loading a large datpb: parsing it from an ifstream onto the
+// heap, parsing it out of a memory map onto the heap, parsing it out of a
+// memory map into an arena, and parsing a chunked copy of it in parallel.
+// Reports the time to load and free the dat, and how many allocations that
+// takes.
+//
+// Example usage:
+//   bazel run -c opt //roman/bench:load_benchmark -- --num_games=100000
+//   bazel run -c opt //roman/bench:load_benchmark -- --datpb=$PWD/ps2.datpb
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/file.h"
+#include "rhutil/status.h"
+#include "roman/chunked_proto.h"
+#include "roman/proto_file.h"
+
+ABSL_FLAG(std::string, datpb, "",
+          "The datpb to load. Without it, a synthetic one is generated.");
+ABSL_FLAG(int, num_games, 50000, "Number of games in the synthetic datpb.");
+ABSL_FLAG(int, roms_per_game, 4, "Number of ROMs in each synthetic game.");
+ABSL_FLAG(int, iterations, 10, "Number of times to load the datpb each way.");
+ABSL_FLAG(int, games_per_chunk, 1024,
+          "Number of games in each chunk of the chunked copy of the datpb.");
+
+namespace {
+
+std::atomic<std::int64_t> allocations{0};
+
+}  // namespace
+
+// Counts every heap allocation, including the arena's blocks.
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace roman {
+namespace {
+
+using ::dat2pb::RomDat;
+using ::rhutil::OkStatus;
+using ::rhutil::OpenInputFile;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+Status WriteDat(int num_games, int roms_per_game, const std::string &path) {
+  RomDat dat;
+  for (int i = 0; i < num_games; i++) {
+    RomDat::Game *game = dat.add_game();
+    game->set_name(absl::StrFormat("Game %06d (USA) (Rev %d)", i, i % 3));
+    for (int j = 0; j < roms_per_game; j++) {
+      RomDat::Game::Rom *rom = game->add_rom();
+      rom->set_name(absl::StrFormat("%s (Track %02d).bin", game->name(), j));
+      rom->set_size(700000000 + i * 31 + j);
+      rom->set_crc(absl::StrFormat("%08x", i * 7919 + j));
+      rom->set_md5(absl::StrFormat("%032x", i * 104729 + j));
+      rom->set_sha1(absl::StrFormat("%040x", i * 1299709 + j));
+    }
+  }
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!dat.SerializeToOstream(&out)) {
+    return UnknownErrorBuilder() << "Failed to write romdat to " << path;
+  }
+  return OkStatus();
+}
+
+struct Result {
+  absl::Duration best = absl::InfiniteDuration();
+  absl::Duration total;
+  std::int64_t allocations = 0;
+};
+
+// Loads the dat `iterations` times with `load`, which returns how many games
+// it loaded after freeing them.
+StatusOr<Result> Measure(int iterations,
+                         const std::function<StatusOr<int>()> &load,
+                         int *games) {
+  Result result;
+  for (int i = 0; i < iterations; i++) {
+    std::int64_t allocations_before = allocations.load();
+    absl::Time start = absl::Now();
+    ASSIGN_OR_RETURN(*games, load());
+    absl::Duration elapsed = absl::Now() - start;
+    result.allocations += allocations.load() - allocations_before;
+    result.total += elapsed;
+    result.best = std::min(result.best, elapsed);
+  }
+  result.allocations /= iterations;
+  return result;
+}
+
+Status Main() {
+  std::string path = absl::GetFlag(FLAGS_datpb);
+  char tmp_path[] = "/tmp/load_benchmark.XXXXXX";
+  if (path.empty()) {
+    int fd = mkstemp(tmp_path);
+    if (fd == -1) {
+      return UnknownErrorBuilder() << "mkstemp: " << std::strerror(errno);
+    }
+    close(fd);
+    path = tmp_path;
+    RETURN_IF_ERROR(WriteDat(absl::GetFlag(FLAGS_num_games),
+                             absl::GetFlag(FLAGS_roms_per_game), path));
+  }
+
+  // The chunked copy is written from a dat loaded the plain way.
+  std::string chunked_path = absl::StrCat(path, ".chunked");
+  {
+    ASSIGN_OR_RETURN(ArenaMessage<RomDat> dat, LoadProtoFile<RomDat>(path));
+    std::ofstream out(chunked_path, std::ios::binary | std::ios::trunc);
+    RETURN_IF_ERROR(WriteChunkedProto(
+        dat.get(),
+        RomDat::descriptor()->FindFieldByNumber(RomDat::kGameFieldNumber),
+        absl::GetFlag(FLAGS_games_per_chunk), &out));
+    if (!out.flush()) {
+      return UnknownErrorBuilder() << "Failed to write " << chunked_path;
+    }
+  }
+
+  struct Method {
+    const char *name;
+    std::function<StatusOr<int>()> load;
+  };
+  std::vector<Method> methods = {
+    {"ifstream, heap", [&]() -> StatusOr<int> {
+       ASSIGN_OR_RETURN(std::ifstream in, OpenInputFile(path));
+       RomDat dat;
+       if (!dat.ParseFromIstream(&in)) {
+         return UnknownErrorBuilder() << "Failed to read romdat from " << path;
+       }
+       return dat.game_size();
+     }},
+    {"mmap, heap", [&]() -> StatusOr<int> {
+       RomDat dat;
+       RETURN_IF_ERROR(ReadProtoFile(path, &dat));
+       return dat.game_size();
+     }},
+    {"mmap, arena", [&]() -> StatusOr<int> {
+       ASSIGN_OR_RETURN(ArenaMessage<RomDat> dat, LoadProtoFile<RomDat>(path));
+       return dat->game_size();
+     }},
+    {"mmap, arena, chunked", [&]() -> StatusOr<int> {
+       ASSIGN_OR_RETURN(ArenaMessage<RomDat> dat,
+                        LoadProtoFile<RomDat>(chunked_path));
+       return dat->game_size();
+     }},
+  };
+
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  for (const Method &method : methods) {
+    int games = 0;
+    ASSIGN_OR_RETURN(Result result, Measure(iterations, method.load, &games));
+    absl::PrintF("method:            %s\n", method.name);
+    absl::PrintF("games:             %d\n", games);
+    absl::PrintF("load+free best:    %s\n", absl::FormatDuration(result.best));
+    absl::PrintF("load+free mean:    %s\n",
+                 absl::FormatDuration(result.total / iterations));
+    absl::PrintF("allocations:       %d\n\n", result.allocations);
+  }
+
+  unlink(chunked_path.c_str());
+  if (path == tmp_path) unlink(tmp_path);
+  return OkStatus();
+}
+
+}  // namespace
+}  // namespace roman
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(
+      "Benchmark the ways of loading a datpb.\n"
+      "Usage: load_benchmark [options]");
+  absl::ParseCommandLine(argc, argv);
+
+  if (auto err = roman::Main(); !err.ok()) {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
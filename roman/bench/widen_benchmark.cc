@@ -0,0 +1,104 @@
+// Compares ways of getting CD audio samples ready for libFLAC: widening each
+// sector as libmirage writes it into a freshly allocated array, the way the
+// FLAC filter used to, against widening second-long batches into a reused
+// buffer with each SIMD kernel the CPU supports. Reports samples per second.
+//
+// Example usage:
+//   bazel run -c opt //roman/bench:widen_benchmark -- --seconds=600
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "roman/cdmap/mirage/pcm.h"
+
+ABSL_FLAG(int, seconds, 600, "Seconds of CD audio to widen each time.");
+ABSL_FLAG(int, iterations, 10, "Number of times to widen the audio each way.");
+
+namespace roman {
+namespace {
+
+// Interleaved stereo samples per sector.
+constexpr std::size_t kSectorSamples = 588 * 2;
+constexpr std::size_t kBatchSamples = 44100 * 2;
+
+// Keeps the compiler from dropping the widened samples.
+std::int64_t checksum = 0;
+
+void Main() {
+  std::size_t size = static_cast<std::size_t>(absl::GetFlag(FLAGS_seconds)) *
+                     44100 * 2;
+  size -= size % kSectorSamples;
+  std::vector<std::int16_t> samples(size);
+  std::uint32_t state = 1;
+  for (std::int16_t &sample : samples) {
+    state = state * 1664525 + 1013904223;
+    sample = static_cast<std::int16_t>(state >> 16);
+  }
+
+  struct Method {
+    std::string name;
+    std::function<void()> widen;
+  };
+  std::vector<Method> methods = {
+    {"per sector, new array, scalar", [&] {
+       for (std::size_t i = 0; i < size; i += kSectorSamples) {
+         std::unique_ptr<std::int32_t[]> widened(
+             new std::int32_t[kSectorSamples]);
+         WidenSamples(SimdLevel::kNone, samples.data() + i, kSectorSamples,
+                      widened.get());
+         checksum += widened[kSectorSamples - 1];
+       }
+     }},
+  };
+  std::vector<std::int32_t> widened(kBatchSamples);
+  for (SimdLevel level : {SimdLevel::kNone, SimdLevel::kSse41,
+                          SimdLevel::kAvx2}) {
+    if (level > SupportedSimdLevel()) break;
+    methods.push_back({
+        absl::StrFormat("batched, reused buffer, %s", SimdLevelName(level)),
+        [&, level] {
+          for (std::size_t i = 0; i < size; i += kBatchSamples) {
+            std::size_t batch = std::min(kBatchSamples, size - i);
+            WidenSamples(level, samples.data() + i, batch, widened.data());
+            checksum += widened[batch - 1];
+          }
+        }});
+  }
+
+  int iterations = absl::GetFlag(FLAGS_iterations);
+  for (const Method &method : methods) {
+    absl::Duration best = absl::InfiniteDuration();
+    for (int i = 0; i < iterations; i++) {
+      absl::Time start = absl::Now();
+      method.widen();
+      best = std::min(best, absl::Now() - start);
+    }
+    absl::PrintF("method:            %s\n", method.name);
+    absl::PrintF("best:              %s\n", absl::FormatDuration(best));
+    absl::PrintF("samples/s:         %.3g\n\n",
+                 size / absl::ToDoubleSeconds(best));
+  }
+  absl::PrintF("checksum:          %d\n", checksum);
+}
+
+}  // namespace
+}  // namespace roman
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(
+      "Benchmark widening CD audio samples for libFLAC.\n"
+      "Usage: widen_benchmark [options]");
+  absl::ParseCommandLine(argc, argv);
+  roman::Main();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,422 @@
+#include "roman/cdmap/mirage/cdm_parser.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <glib.h>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "roman/util/errors.h"
+#include "roman/util/glib.h"
+#include "roman/cdmap/cdmap.pb.h"
+#include "roman/cdmap/mirage/cdm_track_stream.h"
+
+#include "mirage/contextual.h"
+#include "mirage/debug.h"
+#include "mirage/disc.h"
+#include "mirage/error.h"
+#include "mirage/fragment.h"
+#include "mirage/language.h"
+#include "mirage/parser.h"
+#include "mirage/session.h"
+#include "mirage/stream.h"
+#include "mirage/track.h"
+
+using namespace ::roman;
+
+namespace {
+
+// How a track's sectors are stored in its files. See
+// MirageWriterCdmPrivate::CreateFragment, which decides it.
+struct SectorFormat {
+  int size;
+  MirageMainDataFormat format;
+};
+
+SectorFormat FormatOf(MirageSectorType sector_type) {
+  if (sector_type == MIRAGE_SECTOR_AUDIO) {
+    return {2352, MIRAGE_MAIN_DATA_FORMAT_AUDIO};
+  }
+  return {2048, MIRAGE_MAIN_DATA_FORMAT_DATA};
+}
+
+}  // namespace
+
+struct MirageParserCdmPrivate {
+ public:
+  MirageParserCdmPrivate(MirageParserCdm *cdm)
+      : cdm_(cdm) {
+    mirage_parser_generate_info(MIRAGE_PARSER(cdm_), "PARSER-CDM",
+                                "CDMap Image Parser", 1, "CDMap images",
+                                "application/x-cdm");
+  }
+
+  void Dispose() {}
+
+  MirageDisc *LoadImage(MirageStream **streams, GError **error) {
+    const char *cdmap_filename = mirage_stream_get_filename(streams[0]);
+    if (!absl::EndsWith(cdmap_filename, ".cdm")) {
+      g_set_error(
+          error, MIRAGE_ERROR, MIRAGE_ERROR_CANNOT_HANDLE,
+          "%s is not a .cdm file.", cdmap_filename);
+      return nullptr;
+    }
+
+    CompactDiscMap map;
+    if (!ReadCDM(streams[0], &map, error)) return nullptr;
+    std::unique_ptr<gchar, GFree> dir(g_path_get_dirname(cdmap_filename));
+    dir_ = dir.get();
+
+    auto disc = NewGObject<MirageDisc>(MIRAGE_TYPE_DISC);
+    mirage_object_set_parent(MIRAGE_OBJECT(disc.Get()), cdm_);
+    mirage_disc_set_filename(disc.Get(), cdmap_filename);
+
+    if (!ReadMediumType(map, disc.Get(), error)) return nullptr;
+    if (!ReadSessions(map, disc.Get(), error)) return nullptr;
+
+    MIRAGE_DEBUG(cdm_, MIRAGE_DEBUG_PARSER, "Loaded a cdmap from %s",
+                 cdmap_filename);
+    return disc.Release();
+  }
+
+ private:
+  bool ReadCDM(MirageStream *stream, CompactDiscMap *map, GError **error) {
+    std::string map_buf;
+    char buf[4096];
+    while (true) {
+      gssize read = mirage_stream_read(stream, buf, sizeof(buf), error);
+      if (read < 0) return false;
+      if (read == 0) break;
+      map_buf.append(buf, read);
+    }
+
+    if (!map->ParseFromString(map_buf)) {
+      g_set_error(
+          error, MIRAGE_ERROR, MIRAGE_ERROR_PARSER_ERROR,
+          "Failed to parse CompactDiscMap from %s.",
+          mirage_stream_get_filename(stream));
+      return false;
+    }
+    return true;
+  }
+
+  bool ReadMediumType(const CompactDiscMap &map, MirageDisc *disc,
+                      GError **error) {
+    switch (map.medium()) {
+      case CompactDiscMap::MEDIUM_CD:
+        mirage_disc_set_medium_type(disc, MIRAGE_MEDIUM_CD);
+        break;
+      default:
+        g_set_error(
+            error, ROMAN_ERROR, roman::ERR_UNIMPL,
+            "Disc type %d not supported.", map.medium());
+        return false;
+    }
+    return true;
+  }
+
+  GObjectPtr<MirageLanguage> CreateLanguage(
+      const CompactDiscMap::Language &map_language, GError **error) {
+    using Language = ::roman::CompactDiscMap::Language;
+    static constexpr struct {
+      MirageLanguagePackType type;
+      const std::string &(Language::*data)() const;
+    } kPacks[] = {
+      {MIRAGE_LANGUAGE_PACK_TITLE, &Language::title},
+      {MIRAGE_LANGUAGE_PACK_PERFORMER, &Language::performer},
+      {MIRAGE_LANGUAGE_PACK_SONGWRITER, &Language::songwriter},
+      {MIRAGE_LANGUAGE_PACK_COMPOSER, &Language::composer},
+      {MIRAGE_LANGUAGE_PACK_ARRANGER, &Language::arranger},
+      {MIRAGE_LANGUAGE_PACK_MESSAGE, &Language::message},
+      {MIRAGE_LANGUAGE_PACK_DISC_ID, &Language::disc_id},
+      {MIRAGE_LANGUAGE_PACK_GENRE, &Language::genre},
+      {MIRAGE_LANGUAGE_PACK_TOC, &Language::toc},
+      {MIRAGE_LANGUAGE_PACK_TOC2, &Language::toc2},
+      {MIRAGE_LANGUAGE_PACK_RES_8A, &Language::reserved_8a},
+      {MIRAGE_LANGUAGE_PACK_RES_8B, &Language::reserved_8b},
+      {MIRAGE_LANGUAGE_PACK_RES_8C, &Language::reserved_8c},
+      {MIRAGE_LANGUAGE_PACK_CLOSED_INFO, &Language::closed_info},
+      {MIRAGE_LANGUAGE_PACK_UPC_ISRC, &Language::upc_isrc},
+      {MIRAGE_LANGUAGE_PACK_SIZE, &Language::size},
+    };
+
+    auto mirage_language = NewGObject<MirageLanguage>(MIRAGE_TYPE_LANGUAGE);
+    for (const auto &pack : kPacks) {
+      const std::string &data = (map_language.*pack.data)();
+      if (data.empty()) continue;
+      if (!mirage_language_set_pack_data(
+            mirage_language.Get(), pack.type,
+            reinterpret_cast<const guint8 *>(data.data()), data.size(),
+            error)) {
+        return nullptr;
+      }
+    }
+    return mirage_language;
+  }
+
+  bool ReadLanguages(const CompactDiscMap::Track &map_track,
+                     MirageTrack *mirage_track, GError **error) {
+    for (const CompactDiscMap::Language &map_language : map_track.language()) {
+      GObjectPtr<MirageLanguage> mirage_language =
+          CreateLanguage(map_language, error);
+      if (!mirage_language) return false;
+      if (!mirage_track_add_language(mirage_track, map_language.code(),
+                                     mirage_language.Get(), error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ReadLanguages(const CompactDiscMap::Session &map_session,
+                     MirageSession *mirage_session, GError **error) {
+    for (const CompactDiscMap::Language &map_language :
+         map_session.language()) {
+      GObjectPtr<MirageLanguage> mirage_language =
+          CreateLanguage(map_language, error);
+      if (!mirage_language) return false;
+      if (!mirage_session_add_language(mirage_session, map_language.code(),
+                                       mirage_language.Get(), error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void ReadFlags(const CompactDiscMap::Track &map_track,
+                 MirageTrack *mirage_track) {
+    int flags = 0;
+    for (int flag : map_track.flag()) {
+      switch (flag) {
+        case CompactDiscMap::Track::FLAG_4CH:
+          flags |= MIRAGE_TRACK_FLAG_FOURCHANNEL;
+          break;
+        case CompactDiscMap::Track::FLAG_DCP:
+          flags |= MIRAGE_TRACK_FLAG_COPYPERMITTED;
+          break;
+        case CompactDiscMap::Track::FLAG_PRE:
+          flags |= MIRAGE_TRACK_FLAG_PREEMPHASIS;
+          break;
+      }
+    }
+    mirage_track_set_flags(mirage_track, flags);
+  }
+
+  bool ReadTrackType(const CompactDiscMap::Track &map_track,
+                     MirageTrack *mirage_track, GError **error) {
+    MirageSectorType sector_type;
+    switch (map_track.type()) {
+      case CompactDiscMap::Track::TYPE_UNKNOWN:
+        sector_type = MIRAGE_SECTOR_MODE0;
+        break;
+      case CompactDiscMap::Track::TYPE_AUDIO:
+        sector_type = MIRAGE_SECTOR_AUDIO;
+        break;
+      case CompactDiscMap::Track::TYPE_MODE1_2048:
+        sector_type = MIRAGE_SECTOR_MODE1;
+        break;
+      case CompactDiscMap::Track::TYPE_MODE2_2048:
+        sector_type = MIRAGE_SECTOR_MODE2_FORM1;
+        break;
+      case CompactDiscMap::Track::TYPE_MODE2_2324:
+        sector_type = MIRAGE_SECTOR_MODE2_FORM2;
+        break;
+      case CompactDiscMap::Track::TYPE_MODE2_2336:
+        sector_type = MIRAGE_SECTOR_MODE2_MIXED;
+        break;
+      default:
+        g_set_error(
+            error, ROMAN_ERROR, roman::ERR_UNIMPL,
+            "Track type %d not supported.", map_track.type());
+        return false;
+    }
+    mirage_track_set_sector_type(mirage_track, sector_type);
+    return true;
+  }
+
+  // Creates a fragment of `sectors` sectors of `file`, which is not opened.
+  // Maps written before they recorded track lengths have `sectors` < 0, and
+  // have the file opened to measure it.
+  GObjectPtr<MirageFragment> CreateFragment(
+      const std::string &file, MirageSectorType sector_type, gint sectors,
+      const CompactDiscMap::Track::ZstdFrames &zstd_frames, GError **error) {
+    auto fragment = NewGObject<MirageFragment>(MIRAGE_TYPE_FRAGMENT);
+    SectorFormat format = FormatOf(sector_type);
+
+    std::unique_ptr<gchar, GFree> filename(
+        g_build_filename(dir_.c_str(), file.c_str(), nullptr));
+    auto stream =
+        NewGObject<MirageStreamCdmTrack>(MIRAGE_TYPE_STREAM_CDM_TRACK);
+    mirage_contextual_set_context(MIRAGE_CONTEXTUAL(stream.Get()), context());
+    mirage_stream_cdm_track_set_file(stream.Get(), filename.get(),
+                                     format.size);
+    if (zstd_frames.frame_sectors() > 0) {
+      mirage_stream_cdm_track_set_zstd_frames(
+          stream.Get(), zstd_frames.frame_sectors(),
+          zstd_frames.size().data(), zstd_frames.size_size());
+    }
+
+    if (sectors < 0) {
+      MIRAGE_DEBUG(cdm_, MIRAGE_DEBUG_PARSER,
+                   "Opening %s to find its length", filename.get());
+      if (!mirage_stream_seek(MIRAGE_STREAM(stream.Get()), 0, G_SEEK_END,
+                              error)) {
+        return nullptr;
+      }
+      sectors = mirage_stream_tell(MIRAGE_STREAM(stream.Get())) / format.size;
+    }
+
+    mirage_fragment_main_data_set_stream(fragment.Get(),
+                                         MIRAGE_STREAM(stream.Get()));
+    mirage_fragment_main_data_set_size(fragment.Get(), format.size);
+    mirage_fragment_main_data_set_format(fragment.Get(), format.format);
+    mirage_fragment_set_length(fragment.Get(), sectors);
+    return fragment;
+  }
+
+  bool ReadFile(const CompactDiscMap::Track &map_track,
+                MirageTrack *mirage_track, GError **error) {
+    MirageSectorType sector_type = mirage_track_get_sector_type(mirage_track);
+    // A track is never empty, so a map without its length predates them.
+    bool has_lengths = map_track.sectors() > 0;
+
+    GObjectPtr<MirageFragment> pregap_frag = CreateFragment(
+        map_track.pregap_file(), sector_type,
+        has_lengths ? map_track.pregap_sectors() : -1,
+        map_track.pregap_zstd_frames(), error);
+    if (!pregap_frag) return false;
+    GObjectPtr<MirageFragment> data_frag = CreateFragment(
+        map_track.file(), sector_type, has_lengths ? map_track.sectors() : -1,
+        map_track.zstd_frames(), error);
+    if (!data_frag) return false;
+
+    mirage_track_add_fragment(mirage_track, -1, pregap_frag.Get());
+    mirage_track_add_fragment(mirage_track, -1, data_frag.Get());
+    mirage_track_set_track_start(
+        mirage_track, mirage_fragment_get_length(pregap_frag.Get()));
+    return true;
+  }
+
+  bool ReadIndices(const CompactDiscMap::Track &map_track,
+                   MirageTrack *mirage_track, GError **error) {
+    // Indices 0 and 1 are the pregap and track start, which libmirage does
+    // not store as indices.
+    for (const CompactDiscMap::Track::Index &map_index : map_track.index()) {
+      if (map_index.number() < 2) continue;
+      if (!mirage_track_add_index(mirage_track, map_index.offset(), error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ReadTrack(const CompactDiscMap::Track &map_track,
+                 MirageSession *mirage_session, GError **error) {
+    auto mirage_track = NewGObject<MirageTrack>(MIRAGE_TYPE_TRACK);
+    mirage_session_add_track_by_index(mirage_session, -1, mirage_track.Get());
+
+    if (!map_track.isrc().empty()) {
+      mirage_track_set_isrc(mirage_track.Get(), map_track.isrc().c_str());
+    }
+
+    if (!ReadTrackType(map_track, mirage_track.Get(), error)) return false;
+    ReadFlags(map_track, mirage_track.Get());
+    if (!ReadFile(map_track, mirage_track.Get(), error)) return false;
+    if (!ReadIndices(map_track, mirage_track.Get(), error)) return false;
+    if (!ReadLanguages(map_track, mirage_track.Get(), error)) return false;
+    return true;
+  }
+
+  bool ReadSessionType(const CompactDiscMap::Session &map_session,
+                       MirageSession *mirage_session, GError **error) {
+    using Session = ::roman::CompactDiscMap::Session;
+    switch (map_session.type()) {
+      case Session::TYPE_CDDA:
+        mirage_session_set_session_type(mirage_session, MIRAGE_SESSION_CDDA);
+        break;
+      case Session::TYPE_CDROM:
+        mirage_session_set_session_type(mirage_session, MIRAGE_SESSION_CDROM);
+        break;
+      case Session::TYPE_CDI:
+        mirage_session_set_session_type(mirage_session, MIRAGE_SESSION_CDI);
+        break;
+      case Session::TYPE_CDROM_XA:
+        mirage_session_set_session_type(mirage_session,
+                                        MIRAGE_SESSION_CDROM_XA);
+        break;
+      default:
+        g_set_error(
+            error, ROMAN_ERROR, roman::ERR_UNIMPL,
+            "Session type %d not supported.", map_session.type());
+        return false;
+    }
+    return true;
+  }
+
+  bool ReadSessions(const CompactDiscMap &map, MirageDisc *disc,
+                    GError **error) {
+    for (const CompactDiscMap::Session &map_session : map.session()) {
+      auto mirage_session = NewGObject<MirageSession>(MIRAGE_TYPE_SESSION);
+      mirage_disc_add_session_by_index(disc, -1, mirage_session.Get());
+
+      if (!map_session.mcn().empty()) {
+        mirage_session_set_mcn(mirage_session.Get(),
+                               map_session.mcn().c_str());
+      }
+      if (!ReadSessionType(map_session, mirage_session.Get(), error)) {
+        return false;
+      }
+      for (const CompactDiscMap::Track &map_track : map_session.track()) {
+        if (!ReadTrack(map_track, mirage_session.Get(), error)) return false;
+      }
+      if (!ReadLanguages(map_session, mirage_session.Get(), error)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  MirageContext *context() {
+    return mirage_contextual_get_context(MIRAGE_CONTEXTUAL(cdm_));
+  }
+
+  MirageParserCdm *cdm_;
+  // The directory holding the .cdm, which track files are relative to.
+  std::string dir_;
+};
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED(
+    MirageParserCdm, mirage_parser_cdm, MIRAGE_TYPE_PARSER, 0,
+    G_ADD_PRIVATE_DYNAMIC(MirageParserCdm))
+
+void mirage_parser_cdm_type_register(GTypeModule *type_module) {
+  mirage_parser_cdm_register_type(type_module);
+}
+
+static void mirage_parser_cdm_init(MirageParserCdm *self) {
+  self->priv = static_cast<MirageParserCdmPrivate *>(mirage_parser_cdm_get_instance_private(self));
+  new (self->priv) MirageParserCdmPrivate(self);
+}
+
+static void mirage_parser_cdm_class_init(MirageParserCdmClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+  MirageParserClass *parser_class = MIRAGE_PARSER_CLASS(klass);
+
+  gobject_class->dispose = +[](GObject *gobject) {
+    MIRAGE_PARSER_CDM(gobject)->priv->Dispose();
+    return G_OBJECT_CLASS(mirage_parser_cdm_parent_class)->dispose(gobject);
+  };
+  gobject_class->finalize = +[](GObject *gobject) {
+    MIRAGE_PARSER_CDM(gobject)->priv->~MirageParserCdmPrivate();
+    return G_OBJECT_CLASS(mirage_parser_cdm_parent_class)->finalize(gobject);
+  };
+
+  parser_class->load_image = +[](MirageParser *self, MirageStream **streams,
+                                 GError **error) {
+    return MIRAGE_PARSER_CDM(self)->priv->LoadImage(streams, error);
+  };
+}
+
+static void mirage_parser_cdm_class_finalize(MirageParserCdmClass *klass) {}
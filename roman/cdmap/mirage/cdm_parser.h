@@ -0,0 +1,46 @@
+#ifndef ROMAN_CDMAP_MIRAGE_CDM_PARSER_H_
+#define ROMAN_CDMAP_MIRAGE_CDM_PARSER_H_
+
+#include <gmodule.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "mirage/object.h"
+#include "mirage/parser.h"
+
+G_BEGIN_DECLS
+
+#define MIRAGE_TYPE_PARSER_CDM (mirage_parser_cdm_get_type())
+#define MIRAGE_PARSER_CDM(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), MIRAGE_TYPE_PARSER_CDM, MirageParserCdm))
+#define MIRAGE_PARSER_CDM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+                           MIRAGE_TYPE_PARSER_CDM, MirageParserCdmClass))
+#define MIRAGE_IS_PARSER_CDM(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), MIRAGE_TYPE_PARSER_CDM))
+#define MIRAGE_IS_PARSER_CDM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), MIRAGE_TYPE_PARSER_CDM))
+#define MIRAGE_PARSER_CDM_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj), \
+                             MIRAGE_TYPE_PARSER_CDM, MirageParserCdmClass))
+
+typedef struct MirageParserCdmPrivate MirageParserCdmPrivate;
+
+// Loads the disc described by a .cdm file. Only the map is read at load time;
+// each track's files are opened when the track is first read.
+typedef struct MirageParserCdm {
+  MirageParser parent_instance;
+
+  MirageParserCdmPrivate *priv;
+} MirageParserCdm;
+
+typedef struct MirageParserCdmClass {
+  MirageParserClass parent_class;
+} MirageParserCdmClass;
+
+GType mirage_parser_cdm_get_type();
+void mirage_parser_cdm_type_register(GTypeModule *type_module);
+
+G_END_DECLS
+
+#endif  // ROMAN_CDMAP_MIRAGE_CDM_PARSER_H_
@@ -0,0 +1,331 @@
+#include "roman/cdmap/mirage/cdm_track_stream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+
+#include "zstd.h"
+
+#include "absl/strings/match.h"
+#include "roman/cdmap/mirage/flac_filter.h"
+#include "roman/cdmap/mirage/sector_cache.h"
+#include "roman/util/errors.h"
+#include "roman/util/glib.h"
+
+#include "mirage/contextual.h"
+#include "mirage/debug.h"
+#include "mirage/file-stream.h"
+#include "mirage/filter-stream.h"
+#include "mirage/stream.h"
+
+using namespace ::roman;
+
+namespace {
+
+// Sectors in each block of an uncompressed track read at once and cached, so
+// that reading sector after sector costs one file read per block.
+constexpr const int kBlockSectors = 8;
+
+}  // namespace
+
+struct MirageStreamCdmTrackPrivate {
+ public:
+  MirageStreamCdmTrackPrivate(MirageStreamCdmTrack *track)
+      : track_(track), cache_(SectorCache::Shared()),
+        cache_stream_(cache_->NewStream()) {}
+
+  void Dispose() { stream_.Reset(); }
+
+  void SetFile(const char *filename, int sector_size) {
+    filename_ = filename;
+    sector_size_ = sector_size;
+    block_size_ = kBlockSectors * sector_size;
+  }
+
+  // Each frame is read as a block of its own.
+  void SetZstdFrames(int frame_sectors, const guint32 *frame_sizes,
+                     int num_frames) {
+    block_size_ = frame_sectors * sector_size_;
+    frame_offsets_.assign(1, 0);
+    for (int i = 0; i < num_frames; i++) {
+      frame_offsets_.push_back(frame_offsets_.back() + frame_sizes[i]);
+    }
+  }
+
+  const char *GetFilename() const { return filename_.c_str(); }
+
+  gssize Read(char *buffer, std::size_t count, GError **error) {
+    if (IsFlac()) return ReadFlac(buffer, count, error);
+    std::size_t read = 0;
+    while (read < count) {
+      std::uint64_t block = position_ / block_size_;
+      SectorCache::Block data = cache_->Get(cache_stream_, block);
+      if (!data) {
+        data = ReadBlock(block, error);
+        if (!data) return -1;
+        cache_->Put(cache_stream_, block, data);
+      }
+      std::size_t offset = position_ - block * block_size_;
+      if (offset >= data->size()) break;
+      std::size_t size = std::min(count - read, data->size() - offset);
+      std::memcpy(buffer + read, data->data() + offset, size);
+      read += size;
+      position_ += size;
+    }
+    return read;
+  }
+
+  bool Seek(goffset offset, GSeekType type, GError **error) {
+    goffset position = offset;
+    if (type == G_SEEK_CUR) position += position_;
+    if (type == G_SEEK_END) {
+      goffset length = Length(error);
+      if (length < 0) return false;
+      position += length;
+    }
+    if (position < 0) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_USAGE,
+          "Seeking to %lld, before the start of %s",
+          static_cast<long long>(position), filename_.c_str());
+      return false;
+    }
+    position_ = position;
+    return true;
+  }
+
+  goffset Tell() const { return position_; }
+
+ private:
+  // Opens the track file, unless it is already open.
+  bool Open(GError **error) {
+    if (stream_) return true;
+    MIRAGE_DEBUG(track_, MIRAGE_DEBUG_STREAM, "Opening %s", filename_.c_str());
+
+    // A plain file stream, as the filters libmirage would otherwise try on
+    // it include one which decodes FLAC on its own.
+    auto file = NewGObject<MirageFileStream>(MIRAGE_TYPE_FILE_STREAM);
+    mirage_contextual_set_context(MIRAGE_CONTEXTUAL(file.Get()), context());
+    if (!mirage_file_stream_open(file.Get(), filename_.c_str(),
+                                 /*writable=*/false, error)) {
+      return false;
+    }
+    GObjectPtr<MirageStream> stream(MIRAGE_STREAM(file.Release()));
+
+    if (IsFlac()) {
+      auto flac = NewGObject<MirageFilterStreamFlacfile>(
+          MIRAGE_TYPE_FILTER_STREAM_FLACFILE);
+      mirage_contextual_set_context(MIRAGE_CONTEXTUAL(flac.Get()), context());
+      if (!mirage_filter_stream_open(MIRAGE_FILTER_STREAM(flac.Get()),
+                                     stream.Get(), /*writable=*/false,
+                                     error)) {
+        return false;
+      }
+      stream.Reset(MIRAGE_STREAM(flac.Release()));
+    }
+
+    stream_ = std::move(stream);
+    return true;
+  }
+
+  bool IsZstd() const { return !frame_offsets_.empty(); }
+  bool IsFlac() const { return absl::EndsWith(filename_, ".flac"); }
+
+  // The FLAC decoder keeps the frames it last decoded, so FLAC tracks are
+  // read straight from it rather than also through the SectorCache.
+  gssize ReadFlac(char *buffer, std::size_t count, GError **error) {
+    if (!Open(error)) return -1;
+    if (!mirage_stream_seek(stream_.Get(), position_, G_SEEK_SET, error)) {
+      return -1;
+    }
+    std::size_t read = 0;
+    while (read < count) {
+      gssize size = mirage_stream_read(
+          stream_.Get(), buffer + read, count - read, error);
+      if (size < 0) return -1;
+      if (size == 0) break;
+      read += size;
+    }
+    position_ += read;
+    return read;
+  }
+
+  goffset Length(GError **error) {
+    if (length_ >= 0) return length_;
+    if (IsZstd()) {
+      // Every frame but the last is full.
+      std::size_t num_frames = frame_offsets_.size() - 1;
+      if (num_frames == 0) return length_ = 0;
+      SectorCache::Block last = ReadBlock(num_frames - 1, error);
+      if (!last) return -1;
+      length_ = (num_frames - 1) * block_size_ + last->size();
+      return length_;
+    }
+    if (!Open(error)) return -1;
+    if (!mirage_stream_seek(stream_.Get(), 0, G_SEEK_END, error)) return -1;
+    length_ = mirage_stream_tell(stream_.Get());
+    return length_;
+  }
+
+  // Reads `block` of the track file, which is short if it is the last.
+  SectorCache::Block ReadBlock(std::uint64_t block, GError **error) {
+    if (IsZstd()) return ReadZstdFrame(block, error);
+    if (!Open(error)) return nullptr;
+    if (!mirage_stream_seek(stream_.Get(), block * block_size_, G_SEEK_SET,
+                            error)) {
+      return nullptr;
+    }
+    std::string data(block_size_, '\0');
+    std::size_t size = 0;
+    while (size < data.size()) {
+      gssize read = mirage_stream_read(
+          stream_.Get(), &data[size], data.size() - size, error);
+      if (read < 0) return nullptr;
+      if (read == 0) break;
+      size += read;
+    }
+    data.resize(size);
+    MIRAGE_DEBUG(track_, MIRAGE_DEBUG_STREAM, "Read block %llu of %s",
+                 static_cast<unsigned long long>(block), filename_.c_str());
+    return std::make_shared<const std::string>(std::move(data));
+  }
+
+  // Reads and decompresses `frame` of the track file. Past the last, the
+  // frame is empty.
+  SectorCache::Block ReadZstdFrame(std::uint64_t frame, GError **error) {
+    if (frame + 1 >= frame_offsets_.size()) {
+      return std::make_shared<const std::string>();
+    }
+    if (!Open(error)) return nullptr;
+    std::uint64_t offset = frame_offsets_[frame];
+    std::string compressed(frame_offsets_[frame + 1] - offset, '\0');
+    if (!mirage_stream_seek(stream_.Get(), offset, G_SEEK_SET, error)) {
+      return nullptr;
+    }
+    std::size_t size = 0;
+    while (size < compressed.size()) {
+      gssize read = mirage_stream_read(
+          stream_.Get(), &compressed[size], compressed.size() - size, error);
+      if (read < 0) return nullptr;
+      if (read == 0) {
+        g_set_error(
+            error, ROMAN_ERROR, roman::ERR_ZSTD,
+            "%s is truncated in frame %llu", filename_.c_str(),
+            static_cast<unsigned long long>(frame));
+        return nullptr;
+      }
+      size += read;
+    }
+
+    if (!dctx_) dctx_.reset(ZSTD_createDCtx());
+    std::string data(block_size_, '\0');
+    std::size_t decompressed = ZSTD_decompressDCtx(
+        dctx_.get(), &data[0], data.size(), compressed.data(),
+        compressed.size());
+    if (ZSTD_isError(decompressed)) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_ZSTD,
+          "Failed to decompress frame %llu of %s: %s",
+          static_cast<unsigned long long>(frame), filename_.c_str(),
+          ZSTD_getErrorName(decompressed));
+      return nullptr;
+    }
+    data.resize(decompressed);
+    MIRAGE_DEBUG(track_, MIRAGE_DEBUG_STREAM, "Decompressed frame %llu of %s",
+                 static_cast<unsigned long long>(frame), filename_.c_str());
+    return std::make_shared<const std::string>(std::move(data));
+  }
+
+  MirageContext *context() {
+    return mirage_contextual_get_context(MIRAGE_CONTEXTUAL(track_));
+  }
+
+  MirageStreamCdmTrack *track_;
+  SectorCache *const cache_;
+  const std::uint64_t cache_stream_;
+  std::string filename_;
+  std::size_t sector_size_ = 0;
+  std::size_t block_size_ = 0;
+  // Where each zstd frame starts, and where the last ends. Empty unless the
+  // file is zstd compressed.
+  std::vector<std::uint64_t> frame_offsets_;
+  std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx_{
+      nullptr, &ZSTD_freeDCtx};
+  // Null until first read.
+  GObjectPtr<MirageStream> stream_;
+  // Negative until known.
+  goffset length_ = -1;
+  goffset position_ = 0;
+};
+
+static void mirage_stream_cdm_track_stream_init(MirageStreamInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(
+    MirageStreamCdmTrack, mirage_stream_cdm_track, MIRAGE_TYPE_OBJECT,
+    G_ADD_PRIVATE(MirageStreamCdmTrack)
+    G_IMPLEMENT_INTERFACE(MIRAGE_TYPE_STREAM,
+                          mirage_stream_cdm_track_stream_init))
+
+static void mirage_stream_cdm_track_init(MirageStreamCdmTrack *self) {
+  self->priv = static_cast<MirageStreamCdmTrackPrivate *>(mirage_stream_cdm_track_get_instance_private(self));
+  new (self->priv) MirageStreamCdmTrackPrivate(self);
+}
+
+static void mirage_stream_cdm_track_class_init(MirageStreamCdmTrackClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = +[](GObject *gobject) {
+    MIRAGE_STREAM_CDM_TRACK(gobject)->priv->Dispose();
+    return G_OBJECT_CLASS(mirage_stream_cdm_track_parent_class)->dispose(gobject);
+  };
+  gobject_class->finalize = +[](GObject *gobject) {
+    MIRAGE_STREAM_CDM_TRACK(gobject)->priv->~MirageStreamCdmTrackPrivate();
+    return G_OBJECT_CLASS(mirage_stream_cdm_track_parent_class)->finalize(gobject);
+  };
+}
+
+static void mirage_stream_cdm_track_stream_init(MirageStreamInterface *iface) {
+  iface->get_filename = +[](MirageStream *self) -> const gchar * {
+    return MIRAGE_STREAM_CDM_TRACK(self)->priv->GetFilename();
+  };
+  iface->is_writable = +[](MirageStream *self) -> gboolean { return FALSE; };
+  iface->read = +[](MirageStream *self, void *buffer, gsize count, GError **error) -> gssize {
+    return MIRAGE_STREAM_CDM_TRACK(self)->priv->Read(
+        static_cast<char *>(buffer), count, error);
+  };
+  iface->write = +[](MirageStream *self, const void *buffer, gsize count, GError **error) -> gssize {
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_UNIMPL,
+        "Writing to a cdm track is unsupported.");
+    return -1;
+  };
+  iface->seek = +[](MirageStream *self, goffset offset, GSeekType type, GError **error) -> gboolean {
+    return MIRAGE_STREAM_CDM_TRACK(self)->priv->Seek(offset, type, error);
+  };
+  iface->tell = +[](MirageStream *self) -> goffset {
+    return MIRAGE_STREAM_CDM_TRACK(self)->priv->Tell();
+  };
+  iface->move_file = +[](MirageStream *self, const gchar *new_filename, GError **error) -> gboolean {
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_UNIMPL,
+        "Moving a cdm track is unsupported.");
+    return FALSE;
+  };
+}
+
+void mirage_stream_cdm_track_set_file(
+    MirageStreamCdmTrack *self, const gchar *filename, gint sector_size) {
+  self->priv->SetFile(filename, sector_size);
+}
+
+void mirage_stream_cdm_track_set_zstd_frames(
+    MirageStreamCdmTrack *self, gint frame_sectors, const guint32 *frame_sizes,
+    gint num_frames) {
+  self->priv->SetZstdFrames(frame_sectors, frame_sizes, num_frames);
+}
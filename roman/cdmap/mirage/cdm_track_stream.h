@@ -0,0 +1,62 @@
+#ifndef ROMAN_CDMAP_MIRAGE_CDM_TRACK_STREAM_H_
+#define ROMAN_CDMAP_MIRAGE_CDM_TRACK_STREAM_H_
+
+#include <gmodule.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "mirage/mirage.h"
+#include "mirage/object.h"
+#include "mirage/stream.h"
+
+G_BEGIN_DECLS
+
+#define MIRAGE_TYPE_STREAM_CDM_TRACK (mirage_stream_cdm_track_get_type())
+#define MIRAGE_STREAM_CDM_TRACK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), MIRAGE_TYPE_STREAM_CDM_TRACK, MirageStreamCdmTrack))
+#define MIRAGE_STREAM_CDM_TRACK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+                           MIRAGE_TYPE_STREAM_CDM_TRACK, MirageStreamCdmTrackClass))
+#define MIRAGE_IS_STREAM_CDM_TRACK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), MIRAGE_TYPE_STREAM_CDM_TRACK))
+#define MIRAGE_IS_STREAM_CDM_TRACK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), MIRAGE_TYPE_STREAM_CDM_TRACK))
+#define MIRAGE_STREAM_CDM_TRACK_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj), \
+                             MIRAGE_TYPE_STREAM_CDM_TRACK, MirageStreamCdmTrackClass))
+
+typedef struct MirageStreamCdmTrackPrivate MirageStreamCdmTrackPrivate;
+
+// A read-only stream of one of a cdm image's track files, decoding FLAC and
+// zstd compressed files. The file is not opened until the stream is first
+// read, so that loading an image does not touch its tracks. What is read of
+// uncompressed and zstd compressed files is kept in the SectorCache shared by
+// every track; the FLAC decoder keeps decoded frames of its own.
+typedef struct MirageStreamCdmTrack {
+  MirageObject parent_instance;
+
+  MirageStreamCdmTrackPrivate *priv;
+} MirageStreamCdmTrack;
+
+typedef struct MirageStreamCdmTrackClass {
+  MirageObjectClass parent_class;
+} MirageStreamCdmTrackClass;
+
+GType mirage_stream_cdm_track_get_type();
+
+// Sets the file the stream reads, which holds sectors of `sector_size` bytes.
+// Must be called before the stream is used.
+void mirage_stream_cdm_track_set_file(
+    MirageStreamCdmTrack *self, const gchar *filename, gint sector_size);
+
+// Declares the file zstd compressed, as frames of `frame_sectors` sectors
+// with the given compressed sizes (see MirageFilterStreamZstdfile). Reads then
+// decompress only the frames they need. Must be called before the stream is
+// used.
+void mirage_stream_cdm_track_set_zstd_frames(
+    MirageStreamCdmTrack *self, gint frame_sectors, const guint32 *frame_sizes,
+    gint num_frames);
+
+G_END_DECLS
+
+#endif  // ROMAN_CDMAP_MIRAGE_CDM_TRACK_STREAM_H_
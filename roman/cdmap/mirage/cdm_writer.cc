@@ -1,5 +1,6 @@
 #include "roman/cdmap/mirage/cdm_writer.h"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -21,6 +22,7 @@
 #include "roman/util/glib.h"
 #include "roman/cdmap/cdmap.pb.h"
 #include "roman/cdmap/mirage/flac_filter.h"
+#include "roman/cdmap/mirage/zstd_filter.h"
 
 #include "mirage/stream.h"
 #include "mirage/context.h"
@@ -40,6 +42,24 @@ using namespace ::roman;
 
 namespace {
 
+// Threads per FLAC encoded track. See
+// mirage_filter_stream_flacfile_set_encode_threads.
+constexpr const char kFlacThreadsParameter[] = "writer.flac_threads";
+// Threads per zstd compressed track. See
+// mirage_filter_stream_zstdfile_set_compression.
+constexpr const char kZstdThreadsParameter[] = "writer.zstd_threads";
+constexpr const char kZstdLevelParameter[] = "writer.zstd_level";
+
+// Sectors in each zstd frame of a data track, which is what a random read
+// decompresses. Larger frames compress better.
+constexpr const int kZstdFrameSectors = 32;
+
+// Frames are too small for the larger windows of the highest levels to find
+// much more. On 64 KiB frames, level 19 compresses about 15 times slower than
+// 9 for output only about 5% smaller: for a 4.7 GB DVD, over 20 minutes of
+// CPU time instead of under 2.
+constexpr const int kDefaultZstdLevel = 9;
+
 absl::string_view Basename(absl::string_view path) {
   std::vector<absl::string_view> file_parts = absl::StrSplit(path, "/");
   return file_parts[file_parts.size() - 1];
@@ -59,9 +79,19 @@ struct MirageWriterCdmPrivate {
       : cdm_(cdm) {
     mirage_writer_generate_info(MIRAGE_WRITER(cdm_), "WRITER-CDM",
                                 "CDMap Image Writer");
+    mirage_writer_add_parameter_int(
+        MIRAGE_WRITER(cdm_), kFlacThreadsParameter, "FLAC encoder threads",
+        "How many threads encode each audio track. With more than one, tracks "
+        "are split into segments which are encoded in parallel.", 0);
+    mirage_writer_add_parameter_int(
+        MIRAGE_WRITER(cdm_), kZstdThreadsParameter, "zstd threads",
+        "How many threads compress each data track. With 0, one per CPU.", 0);
+    mirage_writer_add_parameter_int(
+        MIRAGE_WRITER(cdm_), kZstdLevelParameter, "zstd level",
+        "The zstd compression level of data tracks.", kDefaultZstdLevel);
   }
 
-  void Dispose() {}
+  void Dispose() { zstd_streams_.clear(); }
 
   bool OpenImage(MirageDisc *disc, GError **error) {
     absl::Span<char *> filenames =
@@ -108,6 +138,7 @@ struct MirageWriterCdmPrivate {
         mirage_fragment_main_data_set_size(fragment.Get(), 2048);
         mirage_fragment_main_data_set_format(
             fragment.Get(), MIRAGE_MAIN_DATA_FORMAT_DATA);
+        file_suffix = "bin.zst";
         break;
       // TODO(eatnumber1): Check that this is the behavior that we want.
       case MIRAGE_SECTOR_MODE2:
@@ -115,6 +146,7 @@ struct MirageWriterCdmPrivate {
         mirage_fragment_main_data_set_size(fragment.Get(), 2048);
         mirage_fragment_main_data_set_format(
             fragment.Get(), MIRAGE_MAIN_DATA_FORMAT_DATA);
+        file_suffix = "bin.zst";
         break;
       default:
         g_set_error(
@@ -139,11 +171,35 @@ struct MirageWriterCdmPrivate {
         NewGObject<MirageFilterStreamFlacfile>(MIRAGE_TYPE_FILTER_STREAM_FLACFILE);
       mirage_contextual_set_context(
           MIRAGE_CONTEXTUAL(outer_stream.Get()), context());
+      mirage_filter_stream_flacfile_set_encode_threads(
+          outer_stream.Get(),
+          mirage_writer_get_parameter_int(
+              MIRAGE_WRITER(cdm_), kFlacThreadsParameter));
       if (!mirage_filter_stream_open(
             MIRAGE_FILTER_STREAM(outer_stream.Get()), stream.Get(), /*writable=*/true, error)) {
         return nullptr;
       }
       stream.Reset(MIRAGE_STREAM(outer_stream.Release()));
+    } else {
+      auto outer_stream =
+        NewGObject<MirageFilterStreamZstdfile>(MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE);
+      mirage_contextual_set_context(
+          MIRAGE_CONTEXTUAL(outer_stream.Get()), context());
+      mirage_filter_stream_zstdfile_set_compression(
+          outer_stream.Get(),
+          kZstdFrameSectors *
+              mirage_fragment_main_data_get_size(fragment.Get()),
+          mirage_writer_get_parameter_int(
+              MIRAGE_WRITER(cdm_), kZstdLevelParameter),
+          mirage_writer_get_parameter_int(
+              MIRAGE_WRITER(cdm_), kZstdThreadsParameter));
+      if (!mirage_filter_stream_open(
+            MIRAGE_FILTER_STREAM(outer_stream.Get()), stream.Get(), /*writable=*/true, error)) {
+        return nullptr;
+      }
+      // Finished, and its frames recorded, by WriteFile.
+      zstd_streams_.emplace(fragment.Get(), outer_stream);
+      stream.Reset(MIRAGE_STREAM(outer_stream.Release()));
     }
 
     mirage_fragment_main_data_set_stream(fragment.Get(), stream.Get());
@@ -516,6 +572,23 @@ struct MirageWriterCdmPrivate {
     return true;
   }
 
+  // Finishes compressing `fragment`'s file if it is zstd compressed, and
+  // describes its frames in `frames`.
+  bool FinishZstd(MirageFragment *fragment,
+                  CompactDiscMap::Track::ZstdFrames *frames, GError **error) {
+    auto it = zstd_streams_.find(fragment);
+    if (it == zstd_streams_.end()) return true;
+    if (!mirage_filter_stream_zstdfile_finish(it->second.Get(), error)) {
+      return false;
+    }
+    gint num_frames = 0;
+    const guint32 *sizes = mirage_filter_stream_zstdfile_get_frame_sizes(
+        it->second.Get(), &num_frames);
+    frames->set_frame_sectors(kZstdFrameSectors);
+    for (gint i = 0; i < num_frames; i++) frames->add_size(sizes[i]);
+    return true;
+  }
+
   bool WriteFile(MirageTrack *mirage_track,
                  CompactDiscMap::Track *map_track, GError **error) {
     int num_fragments = mirage_track_get_number_of_fragments(mirage_track);
@@ -537,6 +610,20 @@ struct MirageWriterCdmPrivate {
             mirage_fragment_main_data_get_filename(data_frag.Get()))));
     map_track->set_pregap_file(std::string(Basename(
             mirage_fragment_main_data_get_filename(pregap_frag.Get()))));
+    map_track->set_sectors(mirage_fragment_get_length(data_frag.Get()));
+    map_track->set_pregap_sectors(
+        mirage_fragment_get_length(pregap_frag.Get()));
+
+    CompactDiscMap::Track::ZstdFrames frames;
+    if (!FinishZstd(pregap_frag.Get(), &frames, error)) return false;
+    if (frames.frame_sectors() > 0) {
+      *map_track->mutable_pregap_zstd_frames() = std::move(frames);
+    }
+    frames.Clear();
+    if (!FinishZstd(data_frag.Get(), &frames, error)) return false;
+    if (frames.frame_sectors() > 0) {
+      *map_track->mutable_zstd_frames() = std::move(frames);
+    }
 
     return true;
   }
@@ -719,6 +806,9 @@ struct MirageWriterCdmPrivate {
 
   MirageWriterCdm *cdm_;
   std::string image_filename_;
+  // The stream of each zstd compressed fragment.
+  std::map<MirageFragment *, GObjectPtr<MirageFilterStreamZstdfile>>
+      zstd_streams_;
 };
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED(
@@ -1,14 +1,25 @@
 // TODO(eatnumber1): Add a param for padding.
 #include "roman/cdmap/mirage/flac_filter.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <glib.h>
 #include <glib/gprintf.h>
 
+#include <FLAC++/decoder.h>
 #include <FLAC++/encoder.h>
+#include <FLAC++/metadata.h>
+
+#include "openssl/md5.h"
 
 #include "absl/types/span.h"
 #include "absl/container/fixed_array.h"
@@ -19,6 +30,11 @@
 #include "absl/strings/str_split.h"
 #include "absl/types/span.h"
 #include "absl/types/optional.h"
+#include "absl/synchronization/mutex.h"
+#include "roman/cdmap/mirage/flac_frames.h"
+#include "roman/cdmap/mirage/ordered_writer.h"
+#include "roman/cdmap/mirage/pcm.h"
+#include "roman/util/bounded_queue.h"
 #include "roman/util/strings.h"
 #include "roman/util/errors.h"
 #include "roman/util/glib.h"
@@ -43,9 +59,70 @@ using namespace ::roman;
 
 namespace {
 
+constexpr const int kNumChannels = 2;
+constexpr const int kBitsPerSample = 16;
+constexpr const int kSampleRate = 44100;
+// Samples are handed to the encoder thread about a second of audio at a time,
+// rounded up to whole frames.
+constexpr const std::size_t kBatchSamples = kSampleRate * kNumChannels;
+
+// How much audio each segment of a track encoded in parallel holds, rounded
+// up to whole frames.
+constexpr const int kSegmentSeconds = 5;
+// Streams get a seek point every this many seconds, as flac(1) writes them,
+// as long as kMaxSeekPoints are enough.
+constexpr const int kSeekPointSeconds = 10;
+// Enough for 80 minutes of audio. Seek points are spaced further apart in
+// longer tracks.
+constexpr const int kMaxSeekPoints = 512;
+// How many decoded frames each stream read back keeps, for reads which don't
+// end on a frame boundary, and for going back over what was just read.
+constexpr const std::size_t kCachedFrames = 32;
+
+// Sets up `encoder` to encode CD audio. Returns false if libFLAC rejected
+// any setting.
+bool ConfigureForCdAudio(FLAC::Encoder::Stream *encoder) {
+  bool ok = true;
+  ok &= encoder->set_verify(true);
+  // TODO(eatnumber1): Make this configurable.
+  constexpr const int kMaxCompression = 8;
+  //ok &= encoder->set_compression_level(kMaxCompression);
+  ok &= encoder->set_compression_level(0);
+  ok &= encoder->set_channels(kNumChannels);
+  ok &= encoder->set_bits_per_sample(kBitsPerSample);
+  ok &= encoder->set_sample_rate(kSampleRate);
+  // TODO(eatnumber1): Write samples when done.
+  ok &= encoder->set_total_samples_estimate(0);
+  return ok;
+}
+
 class Encoder : public FLAC::Encoder::Stream {
  public:
-  Encoder(MirageStream *output) : output_(output) {}
+  Encoder(MirageStream *output) : output_(output) {
+    seek_table_.template_append_placeholders(kMaxSeekPoints);
+  }
+
+  // Has the stream start with a seek table, which FillSeekTable fills in.
+  // Must be called before init.
+  bool AddSeekTable() {
+    FLAC::Metadata::Prototype *metadata[] = {&seek_table_};
+    return set_metadata(metadata, 1);
+  }
+
+  // Points the seek table at the frames written so far. Must be called just
+  // before finish, which writes the seek table over its placeholder.
+  void FillSeekTable() {
+    std::vector<FlacSeekPoint> points = SpacedFlacSeekPoints(
+        frame_offsets_, get_blocksize(), samples_written_,
+        kSeekPointSeconds * kSampleRate, kMaxSeekPoints);
+    for (std::size_t i = 0; i < points.size(); i++) {
+      FLAC__StreamMetadata_SeekPoint point;
+      point.sample_number = points[i].sample;
+      point.stream_offset = points[i].offset;
+      point.frame_samples = points[i].frame_samples;
+      seek_table_.set_point(i, point);
+    }
+  }
 
   ~Encoder() {
     if (last_error_) g_error_free(last_error_);
@@ -94,12 +171,540 @@ class Encoder : public FLAC::Encoder::Stream {
     if (!mirage_stream_write(output_, buffer, bytes, &last_error_)) {
       return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
     }
+    // Metadata is written with no samples.
+    if (samples > 0) {
+      if (frame_offsets_.empty()) first_frame_offset_ = bytes_written_;
+      frame_offsets_.push_back(bytes_written_ - first_frame_offset_);
+      samples_written_ += samples;
+    }
+    bytes_written_ += bytes;
     return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
   }
 
  private:
   GError *last_error_ = nullptr;
   MirageStream *output_;
+  FLAC::Metadata::SeekTable seek_table_;
+  // Of each frame written, from the first.
+  std::vector<std::uint64_t> frame_offsets_;
+  std::uint64_t first_frame_offset_ = 0;
+  std::uint64_t bytes_written_ = 0;
+  std::uint64_t samples_written_ = 0;
+};
+
+// A frame decoded to interleaved 16-bit samples.
+struct DecodedFrame {
+  // Of the frame's first sample, counting one per channel.
+  std::uint64_t first_sample;
+  std::vector<int16_t> samples;
+
+  std::uint64_t end_sample() const {
+    return first_sample + samples.size() / kNumChannels;
+  }
+};
+
+// Decodes CD audio from a FLAC stream, a frame at a time, from wherever in the
+// stream it's asked to.
+//
+// Reading the frame after the last one decoded just decodes it. Anything else
+// is a seek, for which libFLAC uses the stream's seek table to find the
+// nearest frame, so a random read decodes a frame or so rather than the whole
+// stream up to it. Recently decoded frames are kept, so that reads which
+// don't line up with frames, or which go back a little, don't decode the same
+// frame twice.
+class Decoder : public FLAC::Decoder::Stream {
+ public:
+  explicit Decoder(MirageStream *input) : input_(input) {}
+
+  ~Decoder() {
+    if (last_error_) g_error_free(last_error_);
+  }
+
+  // Reads the stream's metadata.
+  bool Init(GError **error) {
+    if (!mirage_stream_seek(input_, 0, G_SEEK_END, error)) return false;
+    length_ = mirage_stream_tell(input_);
+    if (!mirage_stream_seek(input_, 0, G_SEEK_SET, error)) return false;
+
+    FLAC__StreamDecoderInitStatus status = init();
+    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "Error initializing FLAC library: %s",
+          FLAC__StreamDecoderInitStatusString[status]);
+      return false;
+    }
+    if (!process_until_end_of_metadata()) {
+      PropagateError(error, "Failed to read FLAC metadata");
+      return false;
+    }
+    if (!has_stream_info_) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC, "FLAC stream has no STREAMINFO");
+      return false;
+    }
+    if (stream_info_.channels != kNumChannels ||
+        stream_info_.bits_per_sample != kBitsPerSample) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "FLAC stream has %u channels of %u-bit samples, not CD audio",
+          stream_info_.channels, stream_info_.bits_per_sample);
+      return false;
+    }
+    return true;
+  }
+
+  // Counting one per channel.
+  std::uint64_t total_samples() const { return stream_info_.total_samples; }
+
+  // The frame holding `sample`, which must be less than total_samples. Valid
+  // until the next call.
+  const DecodedFrame *FrameAt(std::uint64_t sample, GError **error) {
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+      if (it->first_sample <= sample && sample < it->end_sample()) {
+        cache_.splice(cache_.begin(), cache_, it);
+        return &cache_.front();
+      }
+    }
+
+    decoded_ = false;
+    if (sample == next_sample_) {
+      if (!process_single()) {
+        PropagateError(error, "Failed to decode FLAC frame");
+        return nullptr;
+      }
+    } else {
+      // Seeking to the start of the frame decodes all of it.
+      std::uint64_t target = sample;
+      if (stream_info_.min_blocksize == stream_info_.max_blocksize) {
+        target -= sample % stream_info_.max_blocksize;
+      }
+      if (!seek_absolute(target)) {
+        PropagateError(error, "Failed to seek to FLAC sample %llu",
+                       static_cast<unsigned long long>(target));
+        // libFLAC needs a flush to recover from a failed seek.
+        flush();
+        return nullptr;
+      }
+    }
+    // Metadata may come before the frame.
+    while (!decoded_ &&
+           get_state() != FLAC__STREAM_DECODER_END_OF_STREAM) {
+      if (!process_single()) {
+        PropagateError(error, "Failed to decode FLAC frame");
+        return nullptr;
+      }
+    }
+    if (corrupt_) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "Corrupt FLAC stream near sample %llu: %s",
+          static_cast<unsigned long long>(sample),
+          FLAC__StreamDecoderErrorStatusString[*corrupt_]);
+      corrupt_ = absl::nullopt;
+      if (decoded_) cache_.pop_front();
+      // Whatever follows can't be trusted to continue where the frame ends.
+      next_sample_ = ~std::uint64_t{0};
+      return nullptr;
+    }
+    const DecodedFrame &frame = cache_.front();
+    if (!decoded_ || frame.first_sample > sample ||
+        sample >= frame.end_sample()) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "FLAC stream has no frame holding sample %llu",
+          static_cast<unsigned long long>(sample));
+      return nullptr;
+    }
+    return &frame;
+  }
+
+ protected:
+  FLAC__StreamDecoderReadStatus read_callback(
+      FLAC__byte buffer[], std::size_t *bytes) override {
+    gssize read = mirage_stream_read(input_, buffer, *bytes, &last_error_);
+    if (read < 0) return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+    *bytes = read;
+    if (read == 0) return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+    return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+  }
+
+  FLAC__StreamDecoderSeekStatus seek_callback(
+      FLAC__uint64 absolute_byte_offset) override {
+    if (!mirage_stream_seek(input_, absolute_byte_offset, G_SEEK_SET,
+                            &last_error_)) {
+      return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+    }
+    return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+  }
+
+  FLAC__StreamDecoderTellStatus tell_callback(
+      FLAC__uint64 *absolute_byte_offset) override {
+    *absolute_byte_offset = mirage_stream_tell(input_);
+    return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+  }
+
+  FLAC__StreamDecoderLengthStatus length_callback(
+      FLAC__uint64 *stream_length) override {
+    *stream_length = length_;
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+  }
+
+  bool eof_callback() override {
+    return static_cast<std::uint64_t>(mirage_stream_tell(input_)) >= length_;
+  }
+
+  FLAC__StreamDecoderWriteStatus write_callback(
+      const FLAC__Frame *frame, const FLAC__int32 *const buffer[]) override {
+    if (cache_.size() >= kCachedFrames) {
+      cache_.splice(cache_.begin(), cache_, std::prev(cache_.end()));
+    } else {
+      cache_.emplace_front();
+    }
+    DecodedFrame &decoded = cache_.front();
+    // libFLAC numbers every frame it hands out by its first sample.
+    decoded.first_sample = frame->header.number.sample_number;
+    decoded.samples.resize(frame->header.blocksize * kNumChannels);
+    for (unsigned i = 0; i < frame->header.blocksize; i++) {
+      for (int channel = 0; channel < kNumChannels; channel++) {
+        decoded.samples[i * kNumChannels + channel] = buffer[channel][i];
+      }
+    }
+    next_sample_ = decoded.end_sample();
+    decoded_ = true;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+  }
+
+  void metadata_callback(const FLAC__StreamMetadata *metadata) override {
+    if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) return;
+    stream_info_ = metadata->data.stream_info;
+    has_stream_info_ = true;
+  }
+
+  // libFLAC carries on past corruption, but a read of a corrupt frame fails.
+  // libFLAC doesn't report what it runs into while seeking.
+  void error_callback(FLAC__StreamDecoderErrorStatus status) override {
+    if (!corrupt_) corrupt_ = status;
+  }
+
+ private:
+  template <typename... Args>
+  void PropagateError(GError **error, const absl::FormatSpec<Args...> &fmt,
+                      Args... args) {
+    if (last_error_) {
+      g_propagate_error(error, last_error_);
+      last_error_ = nullptr;
+      return;
+    }
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_FLAC,
+        "%s: %s", absl::StrFormat(fmt, args...).c_str(),
+        get_state().as_cstring());
+  }
+
+  MirageStream *const input_;
+  GError *last_error_ = nullptr;
+  std::uint64_t length_ = 0;
+  FLAC__StreamMetadata_StreamInfo stream_info_ = {};
+  bool has_stream_info_ = false;
+  // Most recently used first.
+  std::list<DecodedFrame> cache_;
+  // Of the frame after the last one decoded.
+  std::uint64_t next_sample_ = 0;
+  // Whether the last call into libFLAC decoded a frame.
+  bool decoded_ = false;
+  absl::optional<FLAC__StreamDecoderErrorStatus> corrupt_;
+};
+
+// Feeds an Encoder from a thread of its own.
+//
+// libmirage writes every track of an image from one thread, one after the
+// other, so encoding on that thread would use a single core however many
+// tracks there are. Instead, each stream queues its samples for its own
+// worker, and the encoders of all tracks run concurrently. Each encoder still
+// sees the same samples in the same order, so its output is the same.
+class EncoderWorker {
+ public:
+  // `encoder` must be initialized, and is only used by the worker until
+  // Finish returns.
+  explicit EncoderWorker(Encoder *encoder)
+      : encoder_(encoder), thread_([this] { Run(); }) {}
+
+  ~EncoderWorker() {
+    queue_.Close();
+    if (thread_.joinable()) thread_.join();
+    absl::MutexLock lock(&mu_);
+    if (error_) g_error_free(error_);
+  }
+
+  // An empty buffer to fill for Write, reusing one the worker is done with if
+  // there is any.
+  std::vector<int16_t> TakeBuffer() {
+    absl::MutexLock lock(&mu_);
+    if (spare_.empty()) return {};
+    std::vector<int16_t> buffer = std::move(spare_.back());
+    spare_.pop_back();
+    return buffer;
+  }
+
+  // Queues interleaved 16-bit stereo samples for encoding, blocking while too
+  // many are queued already. Fails if encoding failed.
+  bool Write(std::vector<int16_t> samples, GError **error) {
+    std::int64_t bytes = OrderedWriter::QueuedBytes()->Acquire(
+        samples.size() * sizeof(int16_t));
+    if (queue_.Push({std::move(samples), bytes})) return true;
+    OrderedWriter::QueuedBytes()->Release(bytes);
+    // The queue is only closed early when encoding fails.
+    absl::MutexLock lock(&mu_);
+    g_propagate_error(error, g_error_copy(error_));
+    return false;
+  }
+
+  // Encodes whatever is still queued, and finishes the encoder.
+  bool Finish(GError **error) {
+    queue_.Close();
+    if (thread_.joinable()) thread_.join();
+    {
+      absl::MutexLock lock(&mu_);
+      if (error_) {
+        g_propagate_error(error, error_);
+        error_ = nullptr;
+        return false;
+      }
+    }
+    encoder_->FillSeekTable();
+    if (!encoder_->finish()) {
+      encoder_->PropagateError(error, "Failed to finalize FLAC encoder");
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  struct Batch {
+    std::vector<int16_t> samples;
+    // What was taken from QueuedBytes for the batch.
+    std::int64_t bytes;
+  };
+
+  void Run() {
+    while (std::optional<Batch> batch = queue_.Pop()) {
+      bool ok = Encode(batch->samples);
+      OrderedWriter::QueuedBytes()->Release(batch->bytes);
+      if (!ok) break;
+      batch->samples.clear();
+      absl::MutexLock lock(&mu_);
+      if (spare_.size() < kMaxSpareBuffers) {
+        spare_.push_back(std::move(batch->samples));
+      }
+    }
+    // Release what a failure left queued.
+    while (std::optional<Batch> batch = queue_.Pop()) {
+      OrderedWriter::QueuedBytes()->Release(batch->bytes);
+    }
+  }
+
+  bool Encode(const std::vector<int16_t> &samples) {
+    // Batches are all the same size but for the last, so this only allocates
+    // once.
+    if (widened_.size() < samples.size()) widened_.resize(samples.size());
+    WidenSamples(samples.data(), samples.size(), widened_.data());
+
+    std::size_t num_samples_in_one_channel = samples.size() / kNumChannels;
+    if (encoder_->process_interleaved(
+          widened_.data(), num_samples_in_one_channel)) {
+      return true;
+    }
+    GError *error = nullptr;
+    encoder_->PropagateError(
+        &error, "Failed to process %d samples", samples.size());
+    absl::MutexLock lock(&mu_);
+    error_ = error;
+    queue_.Close();
+    return false;
+  }
+
+  // Enough to refill one batch while another is encoded.
+  static constexpr std::size_t kMaxSpareBuffers = 2;
+
+  Encoder *const encoder_;
+  // Holds as many full batches as QueuedBytes allows.
+  BoundedQueue<Batch> queue_{OrderedWriter::QueuedBytes()->capacity() /
+                             (kBatchSamples * sizeof(int16_t))};
+  // Only used by the worker.
+  std::vector<int32_t> widened_;
+  absl::Mutex mu_;
+  GError *error_ GUARDED_BY(mu_) = nullptr;
+  std::vector<std::vector<int16_t>> spare_ GUARDED_BY(mu_);
+  std::thread thread_;
+};
+
+// Encodes one segment of a stream into memory, keeping only its frames.
+class SegmentEncoder : public FLAC::Encoder::Stream {
+ public:
+  std::vector<std::string> &frames() { return frames_; }
+
+ protected:
+  FLAC__StreamEncoderWriteStatus write_callback(
+      const FLAC__byte buffer[], std::size_t bytes, unsigned samples,
+      unsigned current_frame) override {
+    // Metadata is written with no samples. The stream's own is written by
+    // SegmentedEncoder.
+    if (samples == 0) return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    frames_.emplace_back(reinterpret_cast<const char *>(buffer), bytes);
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+  }
+
+ private:
+  std::vector<std::string> frames_;
+};
+
+// Encodes a single stream on several threads.
+//
+// FLAC frames are independent of each other, so a stream split into segments
+// of whole frames can be encoded a segment per thread, and the frames joined
+// back together. Each segment's frames are numbered from zero, so they are
+// renumbered as they are written out in order. STREAMINFO and the seek table
+// are written over placeholders once every frame is known. The result decodes
+// to the same samples as what a single encoder writes, but isn't the same
+// bytes.
+class SegmentedEncoder {
+ public:
+  SegmentedEncoder(MirageStream *output, int num_threads)
+      : output_(output),
+        writer_(output, num_threads,
+                [this](std::string *frame, GError **error) {
+                  return Renumber(frame, error);
+                }) {
+    SegmentEncoder encoder;
+    bool ok = ConfigureForCdAudio(&encoder);
+    g_assert(ok);
+    blocksize_ = encoder.get_blocksize();
+    std::size_t frames_per_segment =
+        (kSegmentSeconds * kSampleRate + blocksize_ - 1) / blocksize_;
+    segment_samples_ = frames_per_segment * blocksize_ * kNumChannels;
+    MD5_Init(&md5_);
+  }
+
+  // Writes placeholders for the metadata.
+  bool Init(GError **error) {
+    std::string header = FlacStreamHeader(StreamInfo(), {}, kMaxSeekPoints);
+    return OrderedWriter::WriteFully(output_, header, error);
+  }
+
+  // How many interleaved samples each segment holds. Every segment but the
+  // last must be this long.
+  std::size_t segment_samples() const { return segment_samples_; }
+
+  // Schedules the next segment for encoding, blocking while too many samples
+  // are queued already. Fails if encoding failed.
+  bool Write(std::vector<int16_t> samples, GError **error) {
+    // FLAC's MD5 is of the samples in little endian, as they are on the
+    // platforms libmirage runs on.
+    MD5_Update(&md5_, samples.data(), samples.size() * sizeof(int16_t));
+    total_samples_ += samples.size() / kNumChannels;
+    std::int64_t bytes = samples.size() * sizeof(int16_t);
+    return writer_.Write(
+        bytes,
+        [samples = std::move(samples)](std::vector<std::string> *frames,
+                                       GError **error) {
+          return Encode(samples, frames, error);
+        },
+        error);
+  }
+
+  // Waits for every segment to be written, and writes the metadata.
+  bool Finish(GError **error) {
+    if (!writer_.Finish(error)) return false;
+    FlacStreamInfo info = StreamInfo();
+    info.min_framesize = frame_offsets_.empty() ? 0 : min_framesize_;
+    info.max_framesize = max_framesize_;
+    info.total_samples = total_samples_;
+    MD5_Final(info.md5.data(), &md5_);
+    std::string header = FlacStreamHeader(
+        info,
+        SpacedFlacSeekPoints(frame_offsets_, blocksize_, total_samples_,
+                             kSeekPointSeconds * kSampleRate, kMaxSeekPoints),
+        kMaxSeekPoints);
+    return mirage_stream_seek(output_, 0, G_SEEK_SET, error) &&
+           OrderedWriter::WriteFully(output_, header, error) &&
+           mirage_stream_seek(output_, 0, G_SEEK_END, error);
+  }
+
+ private:
+  FlacStreamInfo StreamInfo() const {
+    FlacStreamInfo info;
+    info.min_blocksize = blocksize_;
+    info.max_blocksize = blocksize_;
+    info.sample_rate = kSampleRate;
+    info.channels = kNumChannels;
+    info.bits_per_sample = kBitsPerSample;
+    return info;
+  }
+
+  // Runs on the writer's pool.
+  static bool Encode(const std::vector<int16_t> &samples,
+                     std::vector<std::string> *frames, GError **error) {
+    SegmentEncoder encoder;
+    bool ok = ConfigureForCdAudio(&encoder);
+    g_assert(ok);
+    FLAC__StreamEncoderInitStatus status = encoder.init();
+    if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "Error initializing FLAC library: %s",
+          FLAC__StreamEncoderInitStatusString[status]);
+      return false;
+    }
+    absl::FixedArray<int32_t> widened(samples.size());
+    WidenSamples(samples.data(), samples.size(), widened.data());
+    if (!encoder.process_interleaved(widened.data(),
+                                     widened.size() / kNumChannels) ||
+        !encoder.finish()) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "Failed to encode %zu samples: %s", widened.size(),
+          FLAC__StreamEncoderStateString[encoder.get_state()]);
+      return false;
+    }
+    *frames = std::move(encoder.frames());
+    return true;
+  }
+
+  // Numbers the next frame written after those before it. Called by the
+  // writer one frame at a time, in order.
+  bool Renumber(std::string *frame, GError **error) {
+    std::string renumbered;
+    if (!RenumberFlacFrame(*frame, frame_offsets_.size(), &renumbered)) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_FLAC,
+          "libFLAC wrote a malformed frame");
+      return false;
+    }
+    *frame = std::move(renumbered);
+    frame_offsets_.push_back(frames_size_);
+    frames_size_ += frame->size();
+    min_framesize_ = std::min<unsigned>(min_framesize_, frame->size());
+    max_framesize_ = std::max<unsigned>(max_framesize_, frame->size());
+    return true;
+  }
+
+  MirageStream *const output_;
+  unsigned blocksize_;
+  std::size_t segment_samples_;
+  // Only used by the writing thread.
+  MD5_CTX md5_;
+  std::uint64_t total_samples_ = 0;
+
+  // Only used by Renumber, and once the writer has finished. Of each frame
+  // written, from the first.
+  std::vector<std::uint64_t> frame_offsets_;
+  std::uint64_t frames_size_ = 0;
+  unsigned min_framesize_ = ~0u;
+  unsigned max_framesize_ = 0;
+
+  // Last, so that its threads are stopped first.
+  OrderedWriter writer_;
 };
 
 }  // namespace
@@ -115,39 +720,37 @@ struct MirageFilterStreamFlacfilePrivate {
   }
 
   void Dispose() {
-    if (encoder_) {
-      if (!encoder_->finish()) {
-        GError *err = nullptr;
-        encoder_->PropagateError(&err, "Failed to finalize FLAC encoder");
+    if (IsOpen()) {
+      GError *err = nullptr;
+      bool ok = Flush(/*all=*/true, &err) &&
+          (segmented_ ? segmented_->Finish(&err) : worker_->Finish(&err));
+      if (!ok) {
         MIRAGE_DEBUG(
             flacfile_, MIRAGE_DEBUG_ERROR, "%s", err->message);
         g_error_free(err);
       }
-      encoder_ = absl::nullopt;
+      worker_.reset();
+      segmented_.reset();
     }
+    encoder_ = absl::nullopt;
+    decoder_.reset();
   }
 
+  void SetEncodeThreads(int num_threads) { encode_threads_ = num_threads; }
+
   bool Open(MirageStream *stream, bool writable, GError **error) {
     if (!writable) {
-      g_set_error(
-          error, ROMAN_ERROR, roman::ERR_UNIMPL,
-          "MirageFilterStreamFlacfile is write-only");
-      return false;
+      decoder_ = std::make_unique<Decoder>(stream);
+      return decoder_->Init(error);
     }
 
-    encoder_.emplace(stream);
+    if (encode_threads_ > 1) {
+      segmented_ = std::make_unique<SegmentedEncoder>(stream, encode_threads_);
+      return segmented_->Init(error);
+    }
 
-    bool ok = true;
-    ok &= encoder_->set_verify(true);
-    // TODO(eatnumber1): Make this configurable.
-    constexpr const int kMaxCompression = 8;
-    //ok &= encoder_->set_compression_level(kMaxCompression);
-    ok &= encoder_->set_compression_level(0);
-    ok &= encoder_->set_channels(2);
-    ok &= encoder_->set_bits_per_sample(16);
-    ok &= encoder_->set_sample_rate(44100);
-    // TODO(eatnumber1): Write samples when done.
-    ok &= encoder_->set_total_samples_estimate(0);
+    encoder_.emplace(stream);
+    bool ok = ConfigureForCdAudio(&*encoder_) && encoder_->AddSeekTable();
     g_assert(ok);
 
     FLAC__StreamEncoderInitStatus status = encoder_->init();
@@ -159,30 +762,51 @@ struct MirageFilterStreamFlacfilePrivate {
       return false;
     }
 
+    std::size_t frame_samples = encoder_->get_blocksize() * kNumChannels;
+    batch_samples_ =
+        (kBatchSamples + frame_samples - 1) / frame_samples * frame_samples;
+    pending_.reserve(batch_samples_);
+    worker_ = std::make_unique<EncoderWorker>(&*encoder_);
     return true;
   }
 
   ssize_t Read(absl::Span<int16_t> buffer, GError **error) {
-    g_assert(encoder_);
-    g_set_error(
-        error, ROMAN_ERROR, roman::ERR_UNIMPL,
-        "Reading from MirageFilterStreamFlacfile unsupported.");
-    return 0;
+    if (!decoder_) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_UNIMPL,
+          "Reading from a MirageFilterStreamFlacfile opened for writing "
+          "unsupported.");
+      return -1;
+    }
+    std::size_t read = 0;
+    while (read < buffer.size()) {
+      std::uint64_t position = current_position_ / sizeof(int16_t);
+      std::uint64_t sample = position / kNumChannels;
+      if (sample >= decoder_->total_samples()) break;
+      const DecodedFrame *frame = decoder_->FrameAt(sample, error);
+      if (!frame) return -1;
+      std::size_t offset = position - frame->first_sample * kNumChannels;
+      std::size_t size =
+          std::min(buffer.size() - read, frame->samples.size() - offset);
+      std::copy_n(frame->samples.begin() + offset, size,
+                  buffer.begin() + read);
+      read += size;
+      current_position_ += size * sizeof(int16_t);
+    }
+
+    MIRAGE_DEBUG(flacfile_, MIRAGE_DEBUG_STREAM, "Read %zu samples", read);
+    return read;
   }
 
   ssize_t Write(absl::Span<const int16_t> buffer, GError **error) {
     if (!md5_.Update(buffer.data(), error)) return 0;
 
-    g_assert(encoder_);
-    absl::FixedArray<int32_t> widened(buffer.size());
-    for (std::size_t i = 0; i < buffer.size(); i++) widened[i] = buffer[i];
-
-    constexpr const int kNumChannels = 2;
-    std::size_t num_samples_in_one_channel = widened.size() / kNumChannels;
-    if (!encoder_->process_interleaved(
-          widened.data(), num_samples_in_one_channel)) {
-      encoder_->PropagateError(
-          error, "Failed to process %d samples", buffer.size());
+    g_assert(IsOpen());
+    // libmirage writes a sector at a time, which is too little to be worth
+    // handing to the encoder thread on its own.
+    pending_.insert(pending_.end(), buffer.begin(), buffer.end());
+    if (pending_.size() >= BatchSamples() &&
+        !Flush(/*all=*/false, error)) {
       return 0;
     }
 
@@ -190,11 +814,31 @@ struct MirageFilterStreamFlacfilePrivate {
                  buffer.size());
 
     current_position_ += buffer.size() * sizeof(int16_t);
-    return widened.size();
+    return buffer.size();
   }
 
   bool Seek(goffset offset, GSeekType type, GError **error) {
-    g_assert(encoder_);
+    // Reads decode from wherever they start, so seeking only moves the
+    // position.
+    if (decoder_) {
+      goffset position = offset;
+      if (type == G_SEEK_CUR) position += current_position_;
+      if (type == G_SEEK_END) {
+        position +=
+            decoder_->total_samples() * kNumChannels * sizeof(int16_t);
+      }
+      if (position < 0) {
+        g_set_error(
+            error, ROMAN_ERROR, roman::ERR_USAGE,
+            "Seeking to %lld, before the start of the stream",
+            static_cast<long long>(position));
+        return false;
+      }
+      current_position_ = position;
+      return true;
+    }
+
+    g_assert(IsOpen());
     if (current_position_ == offset) return true;
     g_set_error(
         error, ROMAN_ERROR, roman::ERR_UNIMPL,
@@ -204,13 +848,50 @@ struct MirageFilterStreamFlacfilePrivate {
   }
 
   goffset Tell() {
-    g_assert(encoder_);
+    g_assert(IsOpen() || decoder_);
     return current_position_;
   }
 
  private:
+  bool IsOpen() const { return worker_ || segmented_; }
+
+  // How many samples the encoder is handed at a time. A segmented encoder
+  // must get exactly this many, but for the last.
+  std::size_t BatchSamples() const {
+    return segmented_ ? segmented_->segment_samples() : batch_samples_;
+  }
+
+  // Hands the pending samples to the encoder in batches, and with `all`, also
+  // what is left over.
+  bool Flush(bool all, GError **error) {
+    std::size_t batch_samples = BatchSamples();
+    std::size_t start = 0;
+    while (pending_.size() - start >= batch_samples ||
+           (all && start < pending_.size())) {
+      std::size_t size = std::min(batch_samples, pending_.size() - start);
+      std::vector<int16_t> batch =
+          worker_ ? worker_->TakeBuffer() : std::vector<int16_t>();
+      batch.assign(pending_.begin() + start, pending_.begin() + start + size);
+      start += size;
+      bool ok = segmented_ ? segmented_->Write(std::move(batch), error)
+                           : worker_->Write(std::move(batch), error);
+      if (!ok) return false;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + start);
+    return true;
+  }
+
   MirageFilterStreamFlacfile *flacfile_;
+  // With more than one, tracks are encoded by a SegmentedEncoder.
+  int encode_threads_ = 0;
+  std::size_t batch_samples_ = kBatchSamples;
   absl::optional<Encoder> encoder_;
+  // Destroyed before `encoder_`, which it uses.
+  std::unique_ptr<EncoderWorker> worker_;
+  std::unique_ptr<SegmentedEncoder> segmented_;
+  std::vector<int16_t> pending_;
+  // Only when opened for reading.
+  std::unique_ptr<Decoder> decoder_;
   std::size_t current_position_ = 0;
 };
 
@@ -264,3 +945,8 @@ static void mirage_filter_stream_flacfile_class_init(MirageFilterStreamFlacfileC
     return MIRAGE_FILTER_STREAM_FLACFILE(self)->priv->Tell();
   };
 }
+
+void mirage_filter_stream_flacfile_set_encode_threads(
+    MirageFilterStreamFlacfile *self, gint num_threads) {
+  self->priv->SetEncodeThreads(num_threads);
+}
@@ -27,6 +27,10 @@ G_BEGIN_DECLS
 
 typedef struct MirageFilterStreamFlacfilePrivate MirageFilterStreamFlacfilePrivate;
 
+// A filter stream of 16-bit stereo CD audio, stored as FLAC. Opened for
+// writing, it encodes what is written to it. Opened for reading, it decodes
+// only the frames holding what is read, finding them with the FLAC stream's
+// seek table.
 typedef struct MirageFilterStreamFlacfile {
   MirageFilterStream parent_instance;
 
@@ -39,6 +43,13 @@ typedef struct MirageFilterStreamFlacfileClass {
 
 GType mirage_filter_stream_flacfile_get_type();
 
+// Encodes the stream on up to `num_threads` threads, by splitting it into
+// segments encoded independently. With one or fewer, the stream is encoded on
+// a single thread, which writes exactly what libFLAC would on its own. Must
+// be called before the stream is opened.
+void mirage_filter_stream_flacfile_set_encode_threads(
+    MirageFilterStreamFlacfile *self, gint num_threads);
+
 G_END_DECLS
 
 #endif  // ROMAN_CDMAP_MIRAGE_FLAC_FILTER_H_
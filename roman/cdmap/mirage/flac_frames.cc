@@ -0,0 +1,195 @@
+#include "roman/cdmap/mirage/flac_frames.h"
+
+#include <algorithm>
+
+namespace roman {
+
+namespace {
+
+// See https://xiph.org/flac/format.html.
+constexpr const std::uint8_t kFixedBlocksizeSync[] = {0xFF, 0xF8};
+constexpr const int kMetadataStreamInfo = 0;
+constexpr const int kMetadataSeekTable = 3;
+constexpr const int kStreamInfoSize = 34;
+constexpr const int kSeekPointSize = 18;
+constexpr const std::uint64_t kPlaceholderSeekPoint = ~std::uint64_t{0};
+
+template <int kBits, std::uint32_t kPoly>
+class Crc {
+ public:
+  Crc() {
+    constexpr std::uint32_t kTop = std::uint32_t{1} << (kBits - 1);
+    constexpr std::uint32_t kMask = (std::uint64_t{1} << kBits) - 1;
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t crc = i << (kBits - 8);
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & kTop) ? (crc << 1) ^ kPoly : crc << 1;
+      }
+      table_[i] = crc & kMask;
+    }
+  }
+
+  std::uint32_t Compute(absl::string_view data) const {
+    constexpr std::uint32_t kMask = (std::uint64_t{1} << kBits) - 1;
+    std::uint32_t crc = 0;
+    for (char c : data) {
+      std::uint8_t index = (crc >> (kBits - 8)) ^ static_cast<std::uint8_t>(c);
+      crc = ((crc << 8) ^ table_[index]) & kMask;
+    }
+    return crc;
+  }
+
+ private:
+  std::uint32_t table_[256];
+};
+
+const Crc<8, 0x07> &Crc8() {
+  static const Crc<8, 0x07> *crc = new Crc<8, 0x07>();
+  return *crc;
+}
+
+const Crc<16, 0x8005> &Crc16() {
+  static const Crc<16, 0x8005> *crc = new Crc<16, 0x8005>();
+  return *crc;
+}
+
+// The length of the UTF-8-like coded number starting with `first`, or 0.
+int CodedNumberLength(std::uint8_t first) {
+  if (first < 0x80) return 1;
+  if (first < 0xC0) return 0;
+  if (first < 0xE0) return 2;
+  if (first < 0xF0) return 3;
+  if (first < 0xF8) return 4;
+  if (first < 0xFC) return 5;
+  if (first < 0xFE) return 6;
+  if (first == 0xFE) return 7;
+  return 0;
+}
+
+void AppendCodedNumber(std::uint64_t number, std::string *out) {
+  if (number < 0x80) {
+    out->push_back(static_cast<char>(number));
+    return;
+  }
+  int length = 2;
+  while (length < 7 && number >= std::uint64_t{1} << (5 * length + 1)) {
+    length++;
+  }
+  std::uint8_t first = 0xFF00 >> length;
+  out->push_back(
+      static_cast<char>(first | (number >> (6 * (length - 1)))));
+  for (int i = length - 2; i >= 0; i--) {
+    out->push_back(static_cast<char>(0x80 | ((number >> (6 * i)) & 0x3F)));
+  }
+}
+
+void AppendBigEndian(std::uint64_t value, int bytes, std::string *out) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void AppendBlockHeader(bool last, int type, std::uint32_t size,
+                       std::string *out) {
+  out->push_back(static_cast<char>((last ? 0x80 : 0) | type));
+  AppendBigEndian(size, 3, out);
+}
+
+}  // namespace
+
+bool RenumberFlacFrame(absl::string_view frame, std::uint64_t number,
+                       std::string *out) {
+  // Sync code, block size and sample rate, channels and sample size.
+  constexpr const int kFixedHeaderSize = 4;
+  if (frame.size() < kFixedHeaderSize + 1 + 1 + 2 ||
+      static_cast<std::uint8_t>(frame[0]) != kFixedBlocksizeSync[0] ||
+      static_cast<std::uint8_t>(frame[1]) != kFixedBlocksizeSync[1]) {
+    return false;
+  }
+  int coded_length = CodedNumberLength(frame[kFixedHeaderSize]);
+  if (coded_length == 0) return false;
+
+  // The block size and sample rate may be given after the frame number.
+  int extra = 0;
+  int blocksize_code = static_cast<std::uint8_t>(frame[2]) >> 4;
+  if (blocksize_code == 6) extra += 1;
+  if (blocksize_code == 7) extra += 2;
+  int sample_rate_code = frame[2] & 0x0F;
+  if (sample_rate_code == 12) extra += 1;
+  if (sample_rate_code == 13 || sample_rate_code == 14) extra += 2;
+
+  std::size_t header_size = kFixedHeaderSize + coded_length + extra;
+  if (frame.size() < header_size + 1 + 2) return false;
+  if (Crc8().Compute(frame.substr(0, header_size)) !=
+      static_cast<std::uint8_t>(frame[header_size])) {
+    return false;
+  }
+
+  out->clear();
+  out->reserve(frame.size() + 6);
+  out->append(frame.data(), kFixedHeaderSize);
+  AppendCodedNumber(number, out);
+  out->append(frame.data() + kFixedHeaderSize + coded_length, extra);
+  out->push_back(static_cast<char>(Crc8().Compute(*out)));
+  // Everything but the header and the CRC-16 which ends the frame.
+  out->append(frame.data() + header_size + 1,
+              frame.size() - header_size - 1 - 2);
+  AppendBigEndian(Crc16().Compute(*out), 2, out);
+  return true;
+}
+
+std::string FlacStreamHeader(const FlacStreamInfo &info,
+                             absl::Span<const FlacSeekPoint> points,
+                             int num_seek_points) {
+  std::string header = "fLaC";
+  AppendBlockHeader(/*last=*/num_seek_points == 0, kMetadataStreamInfo,
+                    kStreamInfoSize, &header);
+  AppendBigEndian(info.min_blocksize, 2, &header);
+  AppendBigEndian(info.max_blocksize, 2, &header);
+  AppendBigEndian(info.min_framesize, 3, &header);
+  AppendBigEndian(info.max_framesize, 3, &header);
+  // Sample rate (20 bits), channels - 1 (3 bits), bits per sample - 1
+  // (5 bits) and total samples (36 bits).
+  std::uint64_t packed = std::uint64_t{info.sample_rate} << 44 |
+      std::uint64_t{info.channels - 1} << 41 |
+      std::uint64_t{info.bits_per_sample - 1} << 36 |
+      (info.total_samples & ((std::uint64_t{1} << 36) - 1));
+  AppendBigEndian(packed, 8, &header);
+  header.append(reinterpret_cast<const char *>(info.md5.data()),
+                info.md5.size());
+
+  if (num_seek_points == 0) return header;
+  AppendBlockHeader(/*last=*/true, kMetadataSeekTable,
+                    num_seek_points * kSeekPointSize, &header);
+  for (int i = 0; i < num_seek_points; i++) {
+    if (static_cast<std::size_t>(i) < points.size()) {
+      AppendBigEndian(points[i].sample, 8, &header);
+      AppendBigEndian(points[i].offset, 8, &header);
+      AppendBigEndian(points[i].frame_samples, 2, &header);
+    } else {
+      AppendBigEndian(kPlaceholderSeekPoint, 8, &header);
+      AppendBigEndian(0, 8, &header);
+      AppendBigEndian(0, 2, &header);
+    }
+  }
+  return header;
+}
+
+std::vector<FlacSeekPoint> SpacedFlacSeekPoints(
+    absl::Span<const std::uint64_t> frame_offsets, unsigned blocksize,
+    std::uint64_t total_samples, std::uint64_t interval, int max_points) {
+  std::vector<FlacSeekPoint> points;
+  std::uint64_t frames = frame_offsets.size();
+  if (frames == 0 || max_points == 0) return points;
+  std::uint64_t frames_per_point = std::max<std::uint64_t>(
+      {1, interval / blocksize, (frames + max_points - 1) / max_points});
+  for (std::uint64_t frame = 0; frame < frames; frame += frames_per_point) {
+    std::uint64_t sample = frame * blocksize;
+    points.push_back({sample, frame_offsets[frame],
+                      static_cast<unsigned>(std::min<std::uint64_t>(
+                          blocksize, total_samples - sample))});
+  }
+  return points;
+}
+
+}  // namespace roman
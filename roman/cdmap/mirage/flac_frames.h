@@ -0,0 +1,59 @@
+#ifndef ROMAN_CDMAP_MIRAGE_FLAC_FRAMES_H_
+#define ROMAN_CDMAP_MIRAGE_FLAC_FRAMES_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace roman {
+
+// What the STREAMINFO block of a FLAC stream says about it.
+struct FlacStreamInfo {
+  unsigned min_blocksize = 0;
+  unsigned max_blocksize = 0;
+  unsigned min_framesize = 0;
+  unsigned max_framesize = 0;
+  unsigned sample_rate = 0;
+  unsigned channels = 0;
+  unsigned bits_per_sample = 0;
+  std::uint64_t total_samples = 0;
+  // Of the decoded samples, as FLAC defines it.
+  std::array<std::uint8_t, 16> md5 = {};
+};
+
+struct FlacSeekPoint {
+  // Of the first sample of the target frame.
+  std::uint64_t sample;
+  // Of the target frame's header, from the first frame's.
+  std::uint64_t offset;
+  unsigned frame_samples;
+};
+
+// Copies the fixed-blocksize FLAC `frame` to `out`, with `number` as its
+// frame number, and its CRCs updated to match. Frames encoded separately can
+// then be joined into one stream. Returns false if `frame` isn't such a frame.
+bool RenumberFlacFrame(absl::string_view frame, std::uint64_t number,
+                       std::string *out);
+
+// The "fLaC" marker, followed by a STREAMINFO block, and a SEEKTABLE block of
+// `num_seek_points` points: `points`, then placeholders. The size only depends
+// on `num_seek_points`, so that a header written ahead of the frames can be
+// overwritten in place once they are known.
+std::string FlacStreamHeader(const FlacStreamInfo &info,
+                             absl::Span<const FlacSeekPoint> points,
+                             int num_seek_points);
+
+// Seek points for a fixed-blocksize stream, one for the first frame at or
+// after every `interval` samples, or further apart if there would be more than
+// `max_points`. `frame_offsets` holds the offset of every frame of the stream.
+std::vector<FlacSeekPoint> SpacedFlacSeekPoints(
+    absl::Span<const std::uint64_t> frame_offsets, unsigned blocksize,
+    std::uint64_t total_samples, std::uint64_t interval, int max_points);
+
+}  // namespace roman
+
+#endif  // ROMAN_CDMAP_MIRAGE_FLAC_FRAMES_H_
@@ -0,0 +1,111 @@
+#include "roman/cdmap/mirage/ordered_writer.h"
+
+#include <utility>
+
+#include "roman/util/errors.h"
+
+namespace roman {
+
+namespace {
+
+// Enough to keep every track of a CD encoding while libmirage moves on to the
+// next, without holding the whole disc in memory.
+constexpr const std::int64_t kMaxQueuedBytes = std::int64_t{256} << 20;
+
+}  // namespace
+
+OrderedWriter::OrderedWriter(MirageStream *output, int num_threads,
+                             ChunkCallback on_chunk)
+    : output_(output), on_chunk_(std::move(on_chunk)), pool_(num_threads) {}
+
+OrderedWriter::~OrderedWriter() {
+  pool_.Wait();
+  absl::MutexLock lock(&mu_);
+  if (error_) g_error_free(error_);
+}
+
+WeightedSemaphore *OrderedWriter::QueuedBytes() {
+  static WeightedSemaphore *queued = new WeightedSemaphore(kMaxQueuedBytes);
+  return queued;
+}
+
+bool OrderedWriter::Write(std::int64_t bytes, Job job, GError **error) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (error_) {
+      g_propagate_error(error, g_error_copy(error_));
+      return false;
+    }
+  }
+  auto entry = std::make_unique<Entry>();
+  entry->bytes = QueuedBytes()->Acquire(bytes);
+  entry->job = std::move(job);
+  Entry *scheduled = entry.get();
+  {
+    absl::MutexLock lock(&mu_);
+    entries_.push_back(std::move(entry));
+  }
+  pool_.Schedule([this, scheduled] { Run(scheduled); });
+  return true;
+}
+
+bool OrderedWriter::Finish(GError **error) {
+  pool_.Wait();
+  absl::MutexLock lock(&mu_);
+  g_assert(entries_.empty());
+  if (error_) {
+    g_propagate_error(error, error_);
+    error_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool OrderedWriter::WriteFully(
+    MirageStream *stream, const std::string &data, GError **error) {
+  gssize written =
+      mirage_stream_write(stream, data.data(), data.size(), error);
+  if (written == static_cast<gssize>(data.size())) return true;
+  if (written >= 0) {
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_UNKNOWN,
+        "Short write of %zd of %zu bytes", written, data.size());
+  }
+  return false;
+}
+
+void OrderedWriter::Run(Entry *entry) {
+  std::vector<std::string> chunks;
+  GError *error = nullptr;
+  entry->job(&chunks, &error);
+  // Frees the job's input before waiting on earlier jobs.
+  entry->job = nullptr;
+
+  absl::MutexLock lock(&mu_);
+  entry->chunks = std::move(chunks);
+  entry->error = error;
+  entry->done = true;
+  WriteDone();
+}
+
+void OrderedWriter::WriteDone() {
+  while (!entries_.empty() && entries_.front()->done) {
+    std::unique_ptr<Entry> entry = std::move(entries_.front());
+    entries_.pop_front();
+    QueuedBytes()->Release(entry->bytes);
+    if (error_) {
+      if (entry->error) g_error_free(entry->error);
+      continue;
+    }
+    if (entry->error) {
+      error_ = entry->error;
+      continue;
+    }
+    for (std::string &chunk : entry->chunks) {
+      if (on_chunk_ && !on_chunk_(&chunk, &error_)) break;
+      if (!WriteFully(output_, chunk, &error_)) break;
+    }
+  }
+}
+
+}  // namespace roman
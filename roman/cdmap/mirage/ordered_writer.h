@@ -0,0 +1,98 @@
+#ifndef ROMAN_CDMAP_MIRAGE_ORDERED_WRITER_H_
+#define ROMAN_CDMAP_MIRAGE_ORDERED_WRITER_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+
+#include "absl/synchronization/mutex.h"
+#include "roman/util/thread_pool.h"
+#include "roman/util/weighted_semaphore.h"
+
+#include "mirage/stream.h"
+
+namespace roman {
+
+// Runs jobs on a pool of threads, and writes what they produce to a stream in
+// the order they were scheduled in, as soon as every earlier job's output is
+// written.
+//
+// This is how the filter streams of an image being written (e.g. FLAC and
+// zstd) spread encoding a track over several cores. Every job holds on to
+// some of QueuedBytes until its output is written, so that however many
+// streams are being written at once, they together hold no more than its
+// capacity in memory.
+class OrderedWriter {
+ public:
+  // Fills `chunks` with what to write, in order. Runs on the pool. Returns
+  // false and sets `error` on failure.
+  using Job =
+      std::function<bool(std::vector<std::string> *chunks, GError **error)>;
+  // Called with each chunk just before it is written, one at a time and in
+  // order, and may change it. Returns false and sets `error` to fail the
+  // stream instead.
+  using ChunkCallback = std::function<bool(std::string *chunk, GError **error)>;
+
+  // `output` must outlive the OrderedWriter.
+  explicit OrderedWriter(MirageStream *output, int num_threads,
+                         ChunkCallback on_chunk = nullptr);
+
+  // Waits for every scheduled job, dropping whatever they produce.
+  ~OrderedWriter();
+
+  OrderedWriter(const OrderedWriter &) = delete;
+  OrderedWriter &operator=(const OrderedWriter &) = delete;
+
+  // The budget shared by every OrderedWriter, and by any filter stream which
+  // queues its input elsewhere.
+  static WeightedSemaphore *QueuedBytes();
+
+  // Schedules `job` to write after every job scheduled before it, blocking
+  // until `bytes` (what the job holds until it has run, e.g. its input) can
+  // be taken from QueuedBytes. Fails if an earlier job or write failed.
+  bool Write(std::int64_t bytes, Job job, GError **error);
+
+  // Waits for every job to be written. Once this returns, what the chunk
+  // callback recorded may be read without further locking.
+  bool Finish(GError **error);
+
+  // Writes all of `data` to `stream` right away, failing on a short write.
+  static bool WriteFully(
+      MirageStream *stream, const std::string &data, GError **error);
+
+ private:
+  struct Entry {
+    Job job;
+    // What was taken from QueuedBytes for the job.
+    std::int64_t bytes = 0;
+    std::vector<std::string> chunks;
+    GError *error = nullptr;
+    bool done = false;
+  };
+
+  // Runs on the pool.
+  void Run(Entry *entry);
+
+  // Writes out the entries at the front of the queue which are done.
+  void WriteDone() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  MirageStream *const output_;
+  const ChunkCallback on_chunk_;
+
+  absl::Mutex mu_;
+  // The entries not written yet, in order.
+  std::deque<std::unique_ptr<Entry>> entries_ GUARDED_BY(mu_);
+  GError *error_ GUARDED_BY(mu_) = nullptr;
+
+  // Last, so that its threads are stopped first.
+  ThreadPool pool_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_CDMAP_MIRAGE_ORDERED_WRITER_H_
@@ -0,0 +1,100 @@
+#include "roman/cdmap/mirage/pcm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROMAN_PCM_X86 1
+#endif
+
+namespace roman {
+namespace {
+
+void WidenScalar(const std::int16_t *samples, std::size_t size,
+                 std::int32_t *widened) {
+  for (std::size_t i = 0; i < size; i++) widened[i] = samples[i];
+}
+
+#ifdef ROMAN_PCM_X86
+// The kernels are compiled for their instruction set whatever the target, and
+// only called once the CPU is known to support it.
+
+__attribute__((target("sse4.1")))
+void WidenSse41(const std::int16_t *samples, std::size_t size,
+                std::int32_t *widened) {
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(widened + i),
+                     _mm_cvtepi16_epi32(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(widened + i + 4),
+                     _mm_cvtepi16_epi32(_mm_srli_si128(in, 8)));
+  }
+  WidenScalar(samples + i, size - i, widened + i);
+}
+
+__attribute__((target("avx2")))
+void WidenAvx2(const std::int16_t *samples, std::size_t size,
+               std::int32_t *widened) {
+  std::size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i lo =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+    __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i + 8));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(widened + i),
+                        _mm256_cvtepi16_epi32(lo));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(widened + i + 8),
+                        _mm256_cvtepi16_epi32(hi));
+  }
+  WidenScalar(samples + i, size - i, widened + i);
+}
+#endif  // ROMAN_PCM_X86
+
+}  // namespace
+
+SimdLevel SupportedSimdLevel() {
+#ifdef ROMAN_PCM_X86
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::kAvx2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::kSse41;
+    return SimdLevel::kNone;
+  }();
+  return level;
+#else
+  return SimdLevel::kNone;
+#endif
+}
+
+const char *SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kNone: return "scalar";
+    case SimdLevel::kSse41: return "sse4.1";
+    case SimdLevel::kAvx2: return "avx2";
+  }
+  return "unknown";
+}
+
+void WidenSamples(const std::int16_t *samples, std::size_t size,
+                  std::int32_t *widened) {
+  WidenSamples(SupportedSimdLevel(), samples, size, widened);
+}
+
+void WidenSamples(SimdLevel level, const std::int16_t *samples,
+                  std::size_t size, std::int32_t *widened) {
+  switch (level) {
+#ifdef ROMAN_PCM_X86
+    case SimdLevel::kAvx2:
+      WidenAvx2(samples, size, widened);
+      return;
+    case SimdLevel::kSse41:
+      WidenSse41(samples, size, widened);
+      return;
+#endif
+    default:
+      WidenScalar(samples, size, widened);
+      return;
+  }
+}
+
+}  // namespace roman
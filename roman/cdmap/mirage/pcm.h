@@ -0,0 +1,32 @@
+#ifndef ROMAN_CDMAP_MIRAGE_PCM_H_
+#define ROMAN_CDMAP_MIRAGE_PCM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace roman {
+
+// The instruction sets WidenSamples can use.
+enum class SimdLevel {
+  kNone,
+  kSse41,
+  kAvx2,
+};
+
+// The best SimdLevel this CPU supports.
+SimdLevel SupportedSimdLevel();
+
+const char *SimdLevelName(SimdLevel level);
+
+// Widens `size` 16-bit samples to the 32-bit ones libFLAC takes, using the
+// best instructions this CPU supports.
+void WidenSamples(const std::int16_t *samples, std::size_t size,
+                  std::int32_t *widened);
+
+// The same, using `level`, which must be supported. For benchmarks.
+void WidenSamples(SimdLevel level, const std::int16_t *samples,
+                  std::size_t size, std::int32_t *widened);
+
+}  // namespace roman
+
+#endif  // ROMAN_CDMAP_MIRAGE_PCM_H_
@@ -0,0 +1,68 @@
+#include "roman/cdmap/mirage/sector_cache.h"
+
+namespace roman {
+
+namespace {
+
+// About seven minutes of CD audio.
+constexpr const std::size_t kSharedCacheBytes = std::size_t{64} << 20;
+
+}  // namespace
+
+SectorCache::SectorCache(std::size_t max_bytes) : max_bytes_(max_bytes) {}
+
+SectorCache *SectorCache::Shared() {
+  static SectorCache *cache = new SectorCache(kSharedCacheBytes);
+  return cache;
+}
+
+std::uint64_t SectorCache::NewStream() {
+  absl::MutexLock lock(&mu_);
+  return next_stream_++;
+}
+
+SectorCache::Block SectorCache::Get(std::uint64_t stream,
+                                    std::uint64_t block) {
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(Key(stream, block));
+  if (it == entries_.end()) {
+    stats_.misses++;
+    return nullptr;
+  }
+  stats_.hits++;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->data;
+}
+
+void SectorCache::Put(std::uint64_t stream, std::uint64_t block, Block data) {
+  absl::MutexLock lock(&mu_);
+  Key key(stream, block);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    stats_.bytes -= it->second->data->size();
+    lru_.erase(it->second);
+    entries_.erase(it);
+  }
+  stats_.bytes += data->size();
+  lru_.push_front({key, std::move(data)});
+  entries_.emplace(key, lru_.begin());
+  Evict();
+}
+
+SectorCache::Stats SectorCache::stats() const {
+  absl::MutexLock lock(&mu_);
+  return stats_;
+}
+
+void SectorCache::Evict() {
+  // The block just put is kept even if it alone is over the bound.
+  while (stats_.bytes > max_bytes_ && lru_.size() > 1) {
+    Entry &entry = lru_.back();
+    stats_.bytes -= entry.data->size();
+    stats_.evictions++;
+    entries_.erase(entry.key);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace roman
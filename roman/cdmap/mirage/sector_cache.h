@@ -0,0 +1,75 @@
+#ifndef ROMAN_CDMAP_MIRAGE_SECTOR_CACHE_H_
+#define ROMAN_CDMAP_MIRAGE_SECTOR_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace roman {
+
+// A size-bounded cache of blocks of decoded track data, shared by every
+// track of every image read, which evicts the least recently used blocks
+// first.
+//
+// Decompressing is what makes reading zstd compressed tracks slow, so a disc
+// read back and forth over a few areas (as emulators do) only decompresses
+// each block once. Sharing the bound between tracks lets whichever tracks are
+// being read use it all. FLAC tracks are cached by their decoder instead.
+class SectorCache {
+ public:
+  using Block = std::shared_ptr<const std::string>;
+
+  struct Stats {
+    std::int64_t hits = 0;
+    std::int64_t misses = 0;
+    std::int64_t evictions = 0;
+    std::size_t bytes = 0;
+  };
+
+  explicit SectorCache(std::size_t max_bytes);
+
+  SectorCache(const SectorCache &) = delete;
+  SectorCache &operator=(const SectorCache &) = delete;
+
+  // The cache every track shares.
+  static SectorCache *Shared();
+
+  // A key space for blocks of a stream of its own.
+  std::uint64_t NewStream();
+
+  // The block cached as `block` of `stream`, or null.
+  Block Get(std::uint64_t stream, std::uint64_t block);
+
+  // Caches `data` as `block` of `stream`, replacing what was there.
+  void Put(std::uint64_t stream, std::uint64_t block, Block data);
+
+  Stats stats() const;
+
+ private:
+  using Key = std::pair<std::uint64_t, std::uint64_t>;
+  struct Entry {
+    Key key;
+    Block data;
+  };
+
+  void Evict() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::size_t max_bytes_;
+  mutable absl::Mutex mu_;
+  std::uint64_t next_stream_ GUARDED_BY(mu_) = 0;
+  // Most recently used first.
+  std::list<Entry> lru_ GUARDED_BY(mu_);
+  absl::flat_hash_map<Key, std::list<Entry>::iterator> entries_
+      GUARDED_BY(mu_);
+  Stats stats_ GUARDED_BY(mu_);
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_CDMAP_MIRAGE_SECTOR_CACHE_H_
@@ -0,0 +1,230 @@
+#include "roman/cdmap/mirage/zstd_filter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+
+#include "zstd.h"
+
+#include "roman/cdmap/mirage/ordered_writer.h"
+#include "roman/util/errors.h"
+
+#include "mirage/debug.h"
+#include "mirage/filter-stream.h"
+#include "mirage/stream.h"
+
+using namespace ::roman;
+
+namespace {
+
+// Compresses `data` into a single frame of `compressed`.
+bool CompressFrame(const std::string &data, int level, std::string *compressed,
+                   GError **error) {
+  // One per thread, as setting a context up for the higher levels costs more
+  // than compressing a frame.
+  thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(
+      ZSTD_createCCtx(), &ZSTD_freeCCtx);
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, level);
+  ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 1);
+
+  compressed->resize(ZSTD_compressBound(data.size()));
+  std::size_t size = ZSTD_compress2(
+      cctx.get(), &(*compressed)[0], compressed->size(), data.data(),
+      data.size());
+  if (ZSTD_isError(size)) {
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_ZSTD,
+        "Failed to compress %zu bytes: %s", data.size(),
+        ZSTD_getErrorName(size));
+    return false;
+  }
+  compressed->resize(size);
+  return true;
+}
+
+}  // namespace
+
+struct MirageFilterStreamZstdfilePrivate {
+ public:
+  MirageFilterStreamZstdfilePrivate(MirageFilterStreamZstdfile *zstdfile)
+      : zstdfile_(zstdfile) {
+    mirage_filter_stream_generate_info(
+        MIRAGE_FILTER_STREAM(zstdfile_), "FILTER-ZSTD",
+        "Zstandard File Filter", /*writable=*/true, /*num_types=*/1,
+        "Zstandard compressed files (*.zst)", "application/zstd");
+  }
+
+  void Dispose() {
+    if (writer_ && !finished_) {
+      GError *err = nullptr;
+      if (!Finish(&err)) {
+        MIRAGE_DEBUG(
+            zstdfile_, MIRAGE_DEBUG_ERROR, "%s", err->message);
+        g_error_free(err);
+      }
+    }
+    writer_.reset();
+  }
+
+  void SetCompression(int frame_size, int level, int num_threads) {
+    frame_size_ = frame_size;
+    level_ = level;
+    num_threads_ = num_threads;
+  }
+
+  bool Open(MirageStream *stream, bool writable, GError **error) {
+    if (!writable) {
+      g_set_error(
+          error, ROMAN_ERROR, roman::ERR_UNIMPL,
+          "Reading MirageFilterStreamZstdfile unsupported; its frame sizes "
+          "are needed to read it.");
+      return false;
+    }
+    int num_threads = num_threads_;
+    if (num_threads <= 0) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Only called by the writer's threads one at a time, and read once it
+    // has finished.
+    writer_ = std::make_unique<OrderedWriter>(
+        stream, num_threads, [this](std::string *frame, GError **error) {
+          frame_sizes_.push_back(frame->size());
+          return true;
+        });
+    pending_.reserve(frame_size_);
+    return true;
+  }
+
+  gssize Write(const char *buffer, std::size_t count, GError **error) {
+    g_assert(writer_ && !finished_);
+    pending_.append(buffer, count);
+    if (pending_.size() >= frame_size_ && !Flush(/*all=*/false, error)) {
+      return -1;
+    }
+
+    MIRAGE_DEBUG(zstdfile_, MIRAGE_DEBUG_STREAM, "Wrote %zu bytes", count);
+
+    current_position_ += count;
+    return count;
+  }
+
+  bool Seek(goffset offset, GSeekType type, GError **error) {
+    g_assert(writer_);
+    if (current_position_ == offset) return true;
+    g_set_error(
+        error, ROMAN_ERROR, roman::ERR_UNIMPL,
+        "Seeking to %llx within MirageFilterStreamZstdfile unsupported.",
+        offset);
+    return false;
+  }
+
+  goffset Tell() {
+    g_assert(writer_);
+    return current_position_;
+  }
+
+  bool Finish(GError **error) {
+    g_assert(writer_);
+    if (finished_) return true;
+    finished_ = true;
+    return Flush(/*all=*/true, error) && writer_->Finish(error);
+  }
+
+  const std::vector<guint32> &FrameSizes() const {
+    g_assert(finished_);
+    return frame_sizes_;
+  }
+
+ private:
+  // Hands the pending bytes to the writer to compress a frame at a time, and
+  // with `all`, also what is left over.
+  bool Flush(bool all, GError **error) {
+    std::size_t start = 0;
+    while (pending_.size() - start >= frame_size_ ||
+           (all && start < pending_.size())) {
+      std::size_t size = std::min(frame_size_, pending_.size() - start);
+      auto compress = [data = pending_.substr(start, size), level = level_](
+                          std::vector<std::string> *frames, GError **error) {
+        frames->emplace_back();
+        return CompressFrame(data, level, &frames->back(), error);
+      };
+      if (!writer_->Write(size, std::move(compress), error)) return false;
+      start += size;
+    }
+    pending_.erase(0, start);
+    return true;
+  }
+
+  MirageFilterStreamZstdfile *zstdfile_;
+  std::size_t frame_size_ = 64 << 10;
+  int level_ = 9;
+  int num_threads_ = 0;
+  std::unique_ptr<OrderedWriter> writer_;
+  bool finished_ = false;
+  // Of each frame written, from the first.
+  std::vector<guint32> frame_sizes_;
+  std::string pending_;
+  std::size_t current_position_ = 0;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(
+    MirageFilterStreamZstdfile, mirage_filter_stream_zstdfile,
+    MIRAGE_TYPE_FILTER_STREAM)
+
+static void mirage_filter_stream_zstdfile_init(MirageFilterStreamZstdfile *self) {
+  self->priv = static_cast<MirageFilterStreamZstdfilePrivate *>(mirage_filter_stream_zstdfile_get_instance_private(self));
+  new (self->priv) MirageFilterStreamZstdfilePrivate(self);
+}
+
+static void mirage_filter_stream_zstdfile_class_init(MirageFilterStreamZstdfileClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+  MirageFilterStreamClass *filter_stream_class = MIRAGE_FILTER_STREAM_CLASS(klass);
+
+  gobject_class->dispose = +[](GObject *gobject) {
+    MIRAGE_FILTER_STREAM_ZSTDFILE(gobject)->priv->Dispose();
+    return G_OBJECT_CLASS(mirage_filter_stream_zstdfile_parent_class)->dispose(gobject);
+  };
+  gobject_class->finalize = +[](GObject *gobject) {
+    MIRAGE_FILTER_STREAM_ZSTDFILE(gobject)->priv->~MirageFilterStreamZstdfilePrivate();
+    return G_OBJECT_CLASS(mirage_filter_stream_zstdfile_parent_class)->finalize(gobject);
+  };
+
+  filter_stream_class->open = +[](MirageFilterStream *self, MirageStream *stream, gboolean writable, GError **error) -> gboolean {
+    return MIRAGE_FILTER_STREAM_ZSTDFILE(self)->priv->Open(stream, writable, error);
+  };
+  filter_stream_class->write = +[](MirageFilterStream *self, const void *buffer, gsize count, GError **error) -> gssize {
+    return MIRAGE_FILTER_STREAM_ZSTDFILE(self)->priv->Write(
+        static_cast<const char *>(buffer), count, error);
+  };
+  filter_stream_class->seek = +[](MirageFilterStream *self, goffset offset, GSeekType type, GError **error) -> gboolean {
+    return MIRAGE_FILTER_STREAM_ZSTDFILE(self)->priv->Seek(offset, type, error);
+  };
+  filter_stream_class->tell = +[](MirageFilterStream *self) -> goffset {
+    return MIRAGE_FILTER_STREAM_ZSTDFILE(self)->priv->Tell();
+  };
+}
+
+void mirage_filter_stream_zstdfile_set_compression(
+    MirageFilterStreamZstdfile *self, gint frame_size, gint level,
+    gint num_threads) {
+  g_return_if_fail(frame_size > 0);
+  self->priv->SetCompression(frame_size, level, num_threads);
+}
+
+gboolean mirage_filter_stream_zstdfile_finish(
+    MirageFilterStreamZstdfile *self, GError **error) {
+  return self->priv->Finish(error);
+}
+
+const guint32 *mirage_filter_stream_zstdfile_get_frame_sizes(
+    MirageFilterStreamZstdfile *self, gint *num_frames) {
+  const std::vector<guint32> &sizes = self->priv->FrameSizes();
+  *num_frames = sizes.size();
+  return sizes.data();
+}
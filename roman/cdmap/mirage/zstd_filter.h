@@ -0,0 +1,68 @@
+#ifndef ROMAN_CDMAP_MIRAGE_ZSTD_FILTER_H_
+#define ROMAN_CDMAP_MIRAGE_ZSTD_FILTER_H_
+
+#include <gmodule.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "mirage/mirage.h"
+#include "mirage/object.h"
+#include "mirage/filter-stream.h"
+
+G_BEGIN_DECLS
+
+#define MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE (mirage_filter_stream_zstdfile_get_type())
+#define MIRAGE_FILTER_STREAM_ZSTDFILE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE, MirageFilterStreamZstdfile))
+#define MIRAGE_FILTER_STREAM_ZSTDFILE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+                           MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE, MirageFilterStreamZstdfileClass))
+#define MIRAGE_IS_FILTER_STREAM_ZSTDFILE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE))
+#define MIRAGE_IS_FILTER_STREAM_ZSTDFILE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE))
+#define MIRAGE_FILTER_STREAM_ZSTDFILE_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj), \
+                             MIRAGE_TYPE_FILTER_STREAM_ZSTDFILE, MirageFilterStreamZstdfileClass))
+
+typedef struct MirageFilterStreamZstdfilePrivate MirageFilterStreamZstdfilePrivate;
+
+// A write-only filter stream which zstd compresses what is written to it as
+// a series of independent frames, each of the same number of bytes before
+// compression but for the last. The frames are compressed in parallel. Given
+// the compressed size of each frame, a reader can decompress just the frames
+// holding what it reads; MirageStreamCdmTrack does so. Concatenated, the
+// frames are also an ordinary zstd stream.
+typedef struct MirageFilterStreamZstdfile {
+  MirageFilterStream parent_instance;
+
+  MirageFilterStreamZstdfilePrivate *priv;
+} MirageFilterStreamZstdfile;
+
+typedef struct MirageFilterStreamZstdfileClass {
+  MirageFilterStreamClass parent_class;
+} MirageFilterStreamZstdfileClass;
+
+GType mirage_filter_stream_zstdfile_get_type();
+
+// Cuts the stream into frames of `frame_size` bytes before compression, which
+// must be positive, and compresses them at zstd `level` on up to
+// `num_threads` threads, or one per CPU with zero. Must be called before the
+// stream is opened.
+void mirage_filter_stream_zstdfile_set_compression(
+    MirageFilterStreamZstdfile *self, gint frame_size, gint level,
+    gint num_threads);
+
+// Compresses what is left of the stream and waits for every frame to be
+// written. Nothing may be written after. Called on dispose if not before.
+gboolean mirage_filter_stream_zstdfile_finish(
+    MirageFilterStreamZstdfile *self, GError **error);
+
+// The compressed size of each frame written, in order. Only valid after
+// mirage_filter_stream_zstdfile_finish.
+const guint32 *mirage_filter_stream_zstdfile_get_frame_sizes(
+    MirageFilterStreamZstdfile *self, gint *num_frames);
+
+G_END_DECLS
+
+#endif  // ROMAN_CDMAP_MIRAGE_ZSTD_FILTER_H_
@@ -0,0 +1,190 @@
+#include "roman/chunked_proto.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "roman/chunked_proto_header.pb.h"
+#include "roman/proto_stream.h"
+#include "roman/util/thread_pool.h"
+
+namespace roman {
+namespace {
+
+using ::google::protobuf::FieldDescriptor;
+using ::google::protobuf::Message;
+using ::google::protobuf::Reflection;
+using ::google::protobuf::io::ArrayInputStream;
+using ::google::protobuf::io::CodedInputStream;
+using ::google::protobuf::io::CodedOutputStream;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::UnknownError;
+using ::rhutil::UnknownErrorBuilder;
+
+constexpr char kChunkedProtoMagic[] = {'\0', 'R', 'C', 'H', 'U', 'N', 'K', '1'};
+constexpr std::size_t kHeaderSizeBytes = 4;
+
+// Parses the `elements.size()` elements of `field` in `chunk` into
+// `elements`.
+Status ParseChunk(std::string_view chunk, const FieldDescriptor *field,
+                  absl::Span<Message *const> elements) {
+  ArrayInputStream in(chunk.data(), chunk.size());
+  RepeatedFieldReader reader(&in, field);
+  for (Message *element : elements) {
+    ASSIGN_OR_RETURN(bool more, reader.Read(element));
+    if (!more) {
+      return UnknownErrorBuilder()
+          << "Chunk holds fewer than " << elements.size() << " elements";
+    }
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+bool IsChunkedProto(std::string_view data) {
+  return data.size() >= sizeof(kChunkedProtoMagic) &&
+         std::memcmp(data.data(), kChunkedProtoMagic,
+                     sizeof(kChunkedProtoMagic)) == 0;
+}
+
+Status WriteChunkedProto(Message *message, const FieldDescriptor *field,
+                         int elements_per_chunk, std::ostream *out) {
+  const Reflection *reflection = message->GetReflection();
+  if (!field->is_repeated() ||
+      field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+    return InvalidArgumentErrorBuilder()
+        << field->full_name() << " is not a repeated message field";
+  }
+  elements_per_chunk = std::max(1, elements_per_chunk);
+
+  // The rest of the message is serialized with the field moved aside, which
+  // only swaps pointers.
+  ChunkedProtoHeader header;
+  header.set_field_number(field->number());
+  {
+    Message *elements = message->New(message->GetArena());
+    std::unique_ptr<Message> owned(
+        message->GetArena() == nullptr ? elements : nullptr);
+    reflection->SwapFields(message, elements, {field});
+    bool serialized = message->SerializeToString(header.mutable_rest());
+    reflection->SwapFields(message, elements, {field});
+    if (!serialized) {
+      return UnknownErrorBuilder()
+          << "Failed to serialize " << message->GetTypeName();
+    }
+  }
+
+  std::ostringstream chunks;
+  int size = reflection->FieldSize(*message, field);
+  for (int start = 0; start < size; start += elements_per_chunk) {
+    int end = std::min(size, start + elements_per_chunk);
+    std::int64_t offset = chunks.tellp();
+    RepeatedFieldWriter writer(&chunks, field, /*binary=*/true);
+    for (int i = start; i < end; i++) {
+      RETURN_IF_ERROR(
+          writer.Write(reflection->GetRepeatedMessage(*message, field, i)));
+    }
+    ChunkedProtoHeader::Chunk *chunk = header.add_chunk();
+    chunk->set_offset(offset);
+    chunk->set_size(static_cast<std::int64_t>(chunks.tellp()) - offset);
+    chunk->set_elements(end - start);
+  }
+
+  std::string header_bytes = header.SerializeAsString();
+  std::uint8_t header_size[kHeaderSizeBytes];
+  CodedOutputStream::WriteLittleEndian32ToArray(header_bytes.size(),
+                                                header_size);
+  out->write(kChunkedProtoMagic, sizeof(kChunkedProtoMagic));
+  out->write(reinterpret_cast<const char *>(header_size), sizeof(header_size));
+  out->write(header_bytes.data(), header_bytes.size());
+  std::string chunk_bytes = chunks.str();
+  if (!out->write(chunk_bytes.data(), chunk_bytes.size())) {
+    return UnknownError("Failed to write chunked proto");
+  }
+  return OkStatus();
+}
+
+Status ParseChunkedProto(std::string_view data, Message *message,
+                         int threads) {
+  if (!IsChunkedProto(data)) {
+    return InvalidArgumentErrorBuilder() << "Not a chunked proto";
+  }
+  data.remove_prefix(sizeof(kChunkedProtoMagic));
+  if (data.size() < kHeaderSizeBytes) {
+    return UnknownError("Truncated chunked proto header");
+  }
+  std::uint32_t header_size;
+  CodedInputStream::ReadLittleEndian32FromArray(
+      reinterpret_cast<const std::uint8_t *>(data.data()), &header_size);
+  data.remove_prefix(kHeaderSizeBytes);
+  ChunkedProtoHeader header;
+  if (data.size() < header_size ||
+      !header.ParseFromArray(data.data(), header_size)) {
+    return UnknownError("Failed to parse chunked proto header");
+  }
+  std::string_view body = data.substr(header_size);
+
+  const FieldDescriptor *field =
+      message->GetDescriptor()->FindFieldByNumber(header.field_number());
+  if (field == nullptr || !field->is_repeated() ||
+      field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+    return UnknownErrorBuilder()
+        << "Chunked field " << header.field_number() << " is not a repeated "
+        << "message field of " << message->GetTypeName();
+  }
+  if (!message->ParseFromString(header.rest())) {
+    return UnknownErrorBuilder()
+        << "Failed to parse " << message->GetTypeName();
+  }
+
+  // Elements are added up front, since a repeated field can't be added to
+  // from several threads. Each chunk then parses into its own range of them.
+  std::int64_t num_elements = 0;
+  for (const ChunkedProtoHeader::Chunk &chunk : header.chunk()) {
+    if (chunk.offset() > body.size() ||
+        chunk.size() > body.size() - chunk.offset() || chunk.elements() < 0) {
+      return UnknownError("Chunked proto chunk is out of bounds");
+    }
+    num_elements += chunk.elements();
+  }
+  const Reflection *reflection = message->GetReflection();
+  std::vector<Message *> elements;
+  elements.reserve(num_elements);
+  for (std::int64_t i = 0; i < num_elements; i++) {
+    elements.push_back(reflection->AddMessage(message, field));
+  }
+
+  std::vector<Status> statuses(header.chunk_size());
+  {
+    ThreadPool pool(std::min(threads, header.chunk_size()));
+    Message *const *next = elements.data();
+    for (int i = 0; i < header.chunk_size(); i++) {
+      const ChunkedProtoHeader::Chunk &chunk = header.chunk(i);
+      absl::Span<Message *const> chunk_elements(next, chunk.elements());
+      next += chunk.elements();
+      pool.Schedule([&, i, chunk_elements] {
+        statuses[i] = ParseChunk(body.substr(chunk.offset(), chunk.size()),
+                                 field, chunk_elements);
+      });
+    }
+  }
+  for (int i = 0; i < header.chunk_size(); i++) {
+    if (!statuses[i].ok()) {
+      return UnknownErrorBuilder()
+          << "Failed to parse chunk " << i << ": " << statuses[i];
+    }
+  }
+  return OkStatus();
+}
+
+}  // namespace roman
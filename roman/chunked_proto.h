@@ -0,0 +1,46 @@
+#ifndef ROMAN_CHUNKED_PROTO_H_
+#define ROMAN_CHUNKED_PROTO_H_
+
+#include <ostream>
+#include <string_view>
+
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "rhutil/status.h"
+
+namespace roman {
+
+// A chunked proto file holds a message whose bulk is a single repeated message
+// field, such as RomDat.game, split into runs of elements which can be parsed
+// independently of each other, and so in parallel. It is laid out as:
+//
+//   8 bytes   kChunkedProtoMagic
+//   4 bytes   the size of the header, little endian
+//   header    a ChunkedProtoHeader, holding the rest of the message and the
+//             offset of each chunk
+//   chunks    each the binary encoding of the message holding only a run of
+//             elements of the field
+//
+// The magic begins with a zero byte, which no binary protobuf message can
+// begin with, so chunked files are told apart from plain ones by their first
+// bytes.
+
+// Whether `data` begins like a chunked proto file.
+bool IsChunkedProto(std::string_view data);
+
+// Writes `message` as a chunked proto file, with `elements_per_chunk`
+// elements of `field` in each chunk. `message` is left as it was.
+rhutil::Status WriteChunkedProto(google::protobuf::Message *message,
+                                 const google::protobuf::FieldDescriptor *field,
+                                 int elements_per_chunk, std::ostream *out);
+
+// Parses the chunked proto file `data` into `message`, parsing up to
+// `threads` chunks at once. The elements of the field are allocated on the
+// message's arena, if it has one.
+rhutil::Status ParseChunkedProto(std::string_view data,
+                                 google::protobuf::Message *message,
+                                 int threads);
+
+}  // namespace roman
+
+#endif  // ROMAN_CHUNKED_PROTO_H_
@@ -1,3 +1,6 @@
 #include "roman/common_flags.h"
 
 ABSL_FLAG(bool, verbose, false, "Verbose output");
+ABSL_FLAG(std::string, output_dir, "",
+          "Where commands converting several inputs write each datpb, as "
+          "<name>.datpb.");
@@ -1,3 +1,6 @@
+#include <string>
+
 #include "absl/flags/flag.h"
 
 ABSL_DECLARE_FLAG(bool, verbose);
+ABSL_DECLARE_FLAG(std::string, output_dir);
@@ -0,0 +1,387 @@
+#include "roman/convert/dat_converter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "dat2pb/parser.h"
+#include "roman/convert/convert_manifest.pb.h"
+#include "roman/hash.h"
+#include "roman/hash/content_hasher.h"
+#include "roman/util/dirs.h"
+#include "roman/util/thread_pool.h"
+#include "roman/util/zip_archive.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::rhutil::InvalidArgumentError;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+// Where the manifest is kept, in the output directory.
+constexpr char kManifestName[] = ".roman_convert";
+
+// The first bytes of a zip's first local file header.
+constexpr char kZipMagic[] = {'P', 'K', '\x03', '\x04'};
+
+// Reads memory in place, without copying it into a buffer of its own.
+class MemoryStreambuf : public std::streambuf {
+ public:
+  explicit MemoryStreambuf(std::string_view data) {
+    char *begin = const_cast<char *>(data.data());
+    setg(begin, begin, begin + data.size());
+  }
+};
+
+bool IsZip(std::string_view data) {
+  return absl::StartsWith(data, std::string_view(kZipMagic, sizeof(kZipMagic)));
+}
+
+bool IsDatName(std::string_view name) {
+  return absl::EndsWithIgnoreCase(name, ".dat") ||
+         absl::EndsWithIgnoreCase(name, ".xml");
+}
+
+// `path` without its directory and extension.
+std::string_view Stem(std::string_view path) {
+  path = path.substr(path.rfind('/') + 1);
+  size_t dot = path.rfind('.');
+  if (dot == std::string_view::npos || dot == 0) return path;
+  return path.substr(0, dot);
+}
+
+std::string_view Dirname(std::string_view path) {
+  size_t slash = path.rfind('/');
+  if (slash == std::string_view::npos) return "";
+  return path.substr(0, slash);
+}
+
+bool Exists(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+StatusOr<std::string> ReadFile(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1) {
+    return UnknownErrorBuilder()
+        << "stat " << path << ": " << std::strerror(errno);
+  }
+  if (!S_ISREG(st.st_mode)) {
+    return InvalidArgumentErrorBuilder() << path << " is not a file";
+  }
+  std::ifstream in(path, std::ios::binary);
+  std::string data(st.st_size, '\0');
+  if (!in || !in.read(data.data(), data.size())) {
+    return UnknownErrorBuilder() << "Failed to read " << path;
+  }
+  return data;
+}
+
+Status Rename(const std::string &from, const std::string &to) {
+  if (std::rename(from.c_str(), to.c_str()) == -1) {
+    return UnknownErrorBuilder() << "rename " << from << " to " << to << ": "
+                                 << std::strerror(errno);
+  }
+  return OkStatus();
+}
+
+StatusOr<RomDat> ParseDat(std::string_view xml) {
+  MemoryStreambuf buf(xml);
+  std::istream in(&buf);
+  return dat2pb::ParseRomDat(&in);
+}
+
+// The names of the entries of `archive` which are dats.
+std::vector<std::string> ListZippedDats(zip_t *archive) {
+  std::vector<std::string> names;
+  zip_int64_t entries = zip_get_num_entries(archive, /*flags=*/0);
+  for (zip_int64_t i = 0; i < entries; i++) {
+    const char *name = zip_get_name(archive, i, /*flags=*/0);
+    if (name != nullptr && IsDatName(name)) names.emplace_back(name);
+  }
+  return names;
+}
+
+StatusOr<RomDat> ParseZippedDat(zip_t *archive, const std::string &name) {
+  ZipFilePtr file(zip_fopen(archive, name.c_str(), /*flags=*/0));
+  if (file == nullptr) {
+    return UnknownErrorBuilder()
+        << "Failed to open zipped " << name << ": " << zip_strerror(archive);
+  }
+  ZipFileStreambuf buf(archive, file.get());
+  std::istream in(&buf);
+  StatusOr<RomDat> dat = dat2pb::ParseRomDat(&in);
+  RETURN_IF_ERROR(buf.status());
+  return dat;
+}
+
+// A zip whose dats are being converted, each on a thread of its own.
+struct ZippedSource {
+  std::string data;
+  std::string sha1;
+
+  absl::Mutex mu;
+  int remaining GUARDED_BY(mu) = 0;
+  bool failed GUARDED_BY(mu) = false;
+  std::vector<std::string> datpbs GUARDED_BY(mu);
+};
+
+}  // namespace
+
+Status ParseDatFile(
+    const std::string &path,
+    const std::function<Status(std::string_view name, RomDat dat)> &callback) {
+  ASSIGN_OR_RETURN(std::string data, ReadFile(path));
+  if (!IsZip(data)) {
+    ASSIGN_OR_RETURN(RomDat dat, ParseDat(data));
+    return callback(Stem(path), std::move(dat));
+  }
+  ASSIGN_OR_RETURN(ZipPtr archive, OpenZipBuffer(data));
+  for (const std::string &name : ListZippedDats(archive.get())) {
+    ASSIGN_OR_RETURN(RomDat dat, ParseZippedDat(archive.get(), name));
+    RETURN_IF_ERROR(callback(Stem(name), std::move(dat)));
+  }
+  return OkStatus();
+}
+
+struct DatConverter::Source {
+  std::string path;
+  // Where its datpbs go, relative to the output directory.
+  std::string dir;
+};
+
+struct DatConverter::Run {
+  // Reserves <dir>/<name>.datpb for a dat of `source`, so that two dats of
+  // the same name don't overwrite each other.
+  StatusOr<std::string> Claim(const Source &source, std::string_view name) {
+    std::string datpb = source.dir.empty()
+        ? absl::StrCat(name, ".datpb")
+        : absl::StrCat(source.dir, "/", name, ".datpb");
+    absl::MutexLock lock(&mu);
+    if (!datpbs.insert(datpb).second) {
+      return InvalidArgumentErrorBuilder()
+          << "Another dat was already converted to " << datpb;
+    }
+    return datpb;
+  }
+
+  void Converted(const std::string &datpb, const RomDat &dat) {
+    absl::MutexLock lock(&mu);
+    stats.converted++;
+    std::cerr << "Wrote " << dat.game_size() << " games to " << datpb
+              << std::endl;
+  }
+
+  void Fail(std::string_view what, const Status &status) {
+    absl::MutexLock lock(&mu);
+    stats.failed++;
+    std::cerr << what << ": " << status << std::endl;
+  }
+
+  // Records that `path`, whose SHA-1 is `sha1`, was converted to `written`.
+  void Record(const std::string &path, std::string sha1,
+              const std::vector<std::string> &written) {
+    ConvertManifest::Input input;
+    input.set_sha1(std::move(sha1));
+    for (const std::string &datpb : written) input.add_datpb(datpb);
+    absl::MutexLock lock(&mu);
+    // Whatever was converted to the same datpbs before has been overwritten.
+    auto *inputs = manifest.mutable_input();
+    for (auto it = inputs->begin(); it != inputs->end();) {
+      bool overwritten = it->first != path &&
+          absl::c_any_of(it->second.datpb(), [&](const std::string &datpb) {
+            return absl::c_linear_search(written, datpb);
+          });
+      it = overwritten ? inputs->erase(it) : std::next(it);
+    }
+    (*inputs)[path] = std::move(input);
+  }
+
+  ThreadPool *pool = nullptr;
+
+  absl::Mutex mu;
+  ConvertManifest manifest GUARDED_BY(mu);
+  absl::flat_hash_set<std::string> datpbs GUARDED_BY(mu);
+  Stats stats GUARDED_BY(mu);
+};
+
+StatusOr<DatConverter::Stats> DatConverter::Convert(
+    absl::Span<const std::string> inputs) {
+  std::vector<Source> sources;
+  for (const std::string &input : inputs) {
+    struct stat st;
+    if (stat(input.c_str(), &st) == -1) {
+      return UnknownErrorBuilder()
+          << "stat " << input << ": " << std::strerror(errno);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+      sources.push_back({input, ""});
+      continue;
+    }
+    std::string_view root = absl::StripSuffix(input, "/");
+    ASSIGN_OR_RETURN(std::vector<std::string> files, ListFiles(root));
+    for (const std::string &file : files) {
+      if (!IsDatName(file) && !absl::EndsWithIgnoreCase(file, ".zip")) {
+        continue;
+      }
+      sources.push_back(
+          {absl::StrCat(root, "/", file), std::string(Dirname(file))});
+    }
+  }
+
+  Run run;
+  std::string manifest_path = OutputPath(kManifestName);
+  RETURN_IF_ERROR(MakeParentDirs(manifest_path));
+  {
+    absl::MutexLock lock(&run.mu);
+    std::ifstream in(manifest_path, std::ios::binary);
+    if (in && !run.manifest.ParseFromIstream(&in)) {
+      return UnknownErrorBuilder() << "Failed to read " << manifest_path;
+    }
+  }
+
+  {
+    ThreadPool pool(std::max(1, opts_.threads));
+    run.pool = &pool;
+    for (const Source &source : sources) {
+      pool.Schedule([this, &run, &source] { ConvertSource(&run, source); });
+    }
+    pool.Wait();
+  }
+
+  absl::MutexLock lock(&run.mu);
+  // Written even if some inputs failed, so that the others are skipped next
+  // time.
+  std::string tmp = absl::StrCat(manifest_path, ".tmp");
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!run.manifest.SerializeToOstream(&out) || !out.flush()) {
+      return UnknownErrorBuilder() << "Failed to write " << tmp;
+    }
+  }
+  RETURN_IF_ERROR(Rename(tmp, manifest_path));
+  return run.stats;
+}
+
+void DatConverter::ConvertSource(Run *run, const Source &source) const {
+  StatusOr<std::string> data = ReadFile(source.path);
+  if (!data.ok()) return run->Fail(source.path, data.status());
+  ContentHasher hasher({Hash::SHA1});
+  hasher.Update(*data);
+  std::string sha1 = hasher.Finalize()[0].GetValue();
+
+  if (!opts_.force) {
+    absl::MutexLock lock(&run->mu);
+    auto it = run->manifest.input().find(source.path);
+    if (it != run->manifest.input().end() && it->second.sha1() == sha1 &&
+        absl::c_all_of(it->second.datpb(), [this](const std::string &datpb) {
+          return Exists(OutputPath(datpb));
+        })) {
+      run->stats.unchanged++;
+      for (const std::string &datpb : it->second.datpb()) {
+        run->datpbs.insert(datpb);
+      }
+      return;
+    }
+  }
+
+  if (!IsZip(*data)) {
+    StatusOr<std::string> datpb =
+        ConvertDat(run, source, Stem(source.path), ParseDat(*data));
+    if (!datpb.ok()) return run->Fail(source.path, datpb.status());
+    return run->Record(source.path, std::move(sha1), {*datpb});
+  }
+
+  auto zipped = std::make_shared<ZippedSource>();
+  zipped->data = std::move(data).ValueOrDie();
+  zipped->sha1 = std::move(sha1);
+  std::vector<std::string> names;
+  {
+    StatusOr<ZipPtr> archive = OpenZipBuffer(zipped->data);
+    if (!archive.ok()) return run->Fail(source.path, archive.status());
+    names = ListZippedDats(archive->get());
+  }
+  if (names.empty()) {
+    return run->Fail(source.path, InvalidArgumentError("Found no dats in zip"));
+  }
+  {
+    absl::MutexLock lock(&zipped->mu);
+    zipped->remaining = names.size();
+  }
+  for (std::string &name : names) {
+    run->pool->Schedule([this, run, &source, zipped, name = std::move(name)] {
+      // A zip_t can't be shared between threads, but the data under it can.
+      StatusOr<std::string> datpb = [&]() -> StatusOr<std::string> {
+        ASSIGN_OR_RETURN(ZipPtr archive, OpenZipBuffer(zipped->data));
+        return ConvertDat(run, source, Stem(name),
+                          ParseZippedDat(archive.get(), name));
+      }();
+      if (!datpb.ok()) {
+        run->Fail(absl::StrCat(source.path, ": ", name), datpb.status());
+      }
+      absl::MutexLock lock(&zipped->mu);
+      if (datpb.ok()) {
+        zipped->datpbs.push_back(*datpb);
+      } else {
+        zipped->failed = true;
+      }
+      // Only a zip all of whose dats were converted may be skipped later.
+      if (--zipped->remaining == 0 && !zipped->failed) {
+        std::sort(zipped->datpbs.begin(), zipped->datpbs.end());
+        run->Record(source.path, zipped->sha1, zipped->datpbs);
+      }
+    });
+  }
+}
+
+StatusOr<std::string> DatConverter::ConvertDat(Run *run, const Source &source,
+                                               std::string_view name,
+                                               StatusOr<RomDat> dat) const {
+  RETURN_IF_ERROR(dat.status());
+  ASSIGN_OR_RETURN(std::string datpb, run->Claim(source, name));
+  RETURN_IF_ERROR(WriteDatPB(&dat.ValueOrDie(), datpb));
+  run->Converted(datpb, *dat);
+  return datpb;
+}
+
+Status DatConverter::WriteDatPB(RomDat *dat, const std::string &datpb) const {
+  std::string path = OutputPath(datpb);
+  std::string tmp = absl::StrCat(path, ".tmp");
+  RETURN_IF_ERROR(MakeParentDirs(path));
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    RETURN_IF_ERROR(opts_.write(dat, &out));
+    if (!out.flush()) {
+      return UnknownErrorBuilder() << "Failed to write " << tmp;
+    }
+  }
+  return Rename(tmp, path);
+}
+
+std::string DatConverter::OutputPath(std::string_view name) const {
+  return absl::StrCat(opts_.output_dir, "/", name);
+}
+
+}  // namespace roman
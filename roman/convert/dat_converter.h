@@ -0,0 +1,82 @@
+#ifndef ROMAN_CONVERT_DAT_CONVERTER_H_
+#define ROMAN_CONVERT_DAT_CONVERTER_H_
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "absl/types/span.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/status.h"
+
+namespace roman {
+
+// Parses the dats in the file at `path`, which is either a dat or a zip of
+// any number of them, and passes each to `callback` along with its name: the
+// file name of the dat without its extension.
+rhutil::Status ParseDatFile(
+    const std::string &path,
+    const std::function<rhutil::Status(std::string_view name,
+                                       dat2pb::RomDat dat)> &callback);
+
+// Converts batches of local dat files to datpbs.
+//
+// Inputs are read whole, hashed and parsed on a thread pool, and every dat of
+// a zip is parsed on a thread of its own. The SHA-1 of every input is recorded
+// in the output directory, and an input whose SHA-1 is unchanged since it was
+// last converted is skipped, as long as the datpbs written from it still
+// exist.
+class DatConverter {
+ public:
+  struct Options {
+    // Where the datpbs are written, as <name>.datpb.
+    std::string output_dir;
+    // How many dats are parsed at once.
+    int threads = 1;
+    // Convert every input, even unchanged ones.
+    bool force = false;
+    // Writes a datpb. Called concurrently.
+    std::function<rhutil::Status(dat2pb::RomDat *dat, std::ostream *out)>
+        write;
+  };
+
+  struct Stats {
+    int converted = 0;
+    int unchanged = 0;
+    int failed = 0;
+  };
+
+  explicit DatConverter(Options opts) : opts_(std::move(opts)) {}
+
+  // Converts `inputs`, each a dat, a zip of dats, or a directory which is
+  // searched recursively for files named *.dat, *.xml or *.zip. The datpbs of
+  // dats found in a directory keep their path relative to it. An input which
+  // fails is reported to stderr and counted, and doesn't stop the others.
+  rhutil::StatusOr<Stats> Convert(absl::Span<const std::string> inputs);
+
+ private:
+  struct Run;
+  struct Source;
+
+  void ConvertSource(Run *run, const Source &source) const;
+
+  // Writes `dat` to <name>.datpb in the output directory of `source`, and
+  // returns that path relative to the output directory.
+  rhutil::StatusOr<std::string> ConvertDat(
+      Run *run, const Source &source, std::string_view name,
+      rhutil::StatusOr<dat2pb::RomDat> dat) const;
+
+  // Writes `dat` to <output_dir>/<datpb>, through a temporary file so that a
+  // datpb is never left half written.
+  rhutil::Status WriteDatPB(dat2pb::RomDat *dat,
+                            const std::string &datpb) const;
+
+  std::string OutputPath(std::string_view name) const;
+
+  const Options opts_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_CONVERT_DAT_CONVERTER_H_
@@ -0,0 +1,163 @@
+#include "roman/game_writer.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::google::protobuf::Message;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+
+StatusOr<GameWriter::Format> GameWriter::ParseFormat(std::string_view name) {
+  if (name == "tsv") return Format::kTsv;
+  if (name == "jsonl") return Format::kJsonl;
+  return InvalidArgumentErrorBuilder()
+      << "Unknown output format " << name << ", expected tsv or jsonl";
+}
+
+void GameWriter::Write(const RomDat::Game &game) {
+  switch (format_) {
+    case Format::kTsv:
+      WriteTsvHeader();
+      for (const RomDat::Game::Rom &rom : game.rom()) {
+        WriteTsvRom(game.name(), rom, /*path=*/"");
+      }
+      break;
+    case Format::kJsonl:
+      out_.Append("{\"name\":");
+      AppendJson(game.name());
+      out_.Append(",\"roms\":[");
+      for (int i = 0; i < game.rom_size(); i++) {
+        if (i > 0) out_.Append(',');
+        WriteJsonlRom(game.rom(i), /*path=*/nullptr);
+      }
+      out_.Append("]}\n");
+      break;
+  }
+}
+
+void GameWriter::Write(const GameIndex::Game &game) {
+  switch (format_) {
+    case Format::kTsv:
+      WriteTsvHeader();
+      for (const GameIndex::Game::Rom &rom : game.rom()) {
+        WriteTsvRom(game.dat().name(), rom.dat(), rom.path());
+      }
+      break;
+    case Format::kJsonl:
+      out_.Append("{\"name\":");
+      AppendJson(game.dat().name());
+      out_.Append(game.rom_size() == game.dat().rom_size()
+                      ? ",\"complete\":true"
+                      : ",\"complete\":false");
+      out_.Append(",\"roms\":[");
+      for (int i = 0; i < game.rom_size(); i++) {
+        if (i > 0) out_.Append(',');
+        WriteJsonlRom(game.rom(i).dat(), &game.rom(i).path());
+      }
+      out_.Append("]}\n");
+      break;
+  }
+}
+
+Status GameWriter::WriteAll(const Message &message) {
+  if (const auto *dat = dynamic_cast<const RomDat *>(&message)) {
+    for (const RomDat::Game &game : dat->game()) Write(game);
+  } else if (const auto *index = dynamic_cast<const GameIndex *>(&message)) {
+    for (const GameIndex::Game &game : index->game()) Write(game);
+  } else {
+    return InvalidArgumentErrorBuilder()
+        << "Can't write a " << message.GetTypeName() << " as games";
+  }
+  return Flush();
+}
+
+void GameWriter::WriteTsvHeader() {
+  if (wrote_header_) return;
+  wrote_header_ = true;
+  out_.Append("game\trom\tsize\tcrc\tmd5\tsha1\tpath\n");
+}
+
+void GameWriter::WriteTsvRom(std::string_view game, const RomDat::Game::Rom &rom,
+                             std::string_view path) {
+  AppendTsv(game);
+  out_.Append('\t');
+  AppendTsv(rom.name());
+  out_.Append('\t');
+  out_.AppendInt(rom.size());
+  out_.Append('\t');
+  AppendTsv(rom.crc());
+  out_.Append('\t');
+  AppendTsv(rom.md5());
+  out_.Append('\t');
+  AppendTsv(rom.sha1());
+  out_.Append('\t');
+  AppendTsv(path);
+  out_.Append('\n');
+}
+
+void GameWriter::WriteJsonlRom(const RomDat::Game::Rom &rom,
+                               const std::string *path) {
+  out_.Append("{\"name\":");
+  AppendJson(rom.name());
+  out_.Append(",\"size\":");
+  out_.AppendInt(rom.size());
+  // Hashes the dat doesn't have are left out rather than empty.
+  for (const auto &[key, value] : {std::pair<const char *, const std::string *>(
+                                       ",\"crc\":", &rom.crc()),
+                                   {",\"md5\":", &rom.md5()},
+                                   {",\"sha1\":", &rom.sha1()}}) {
+    if (value->empty()) continue;
+    out_.Append(key);
+    AppendJson(*value);
+  }
+  if (path != nullptr) {
+    out_.Append(",\"path\":");
+    AppendJson(*path);
+  }
+  out_.Append('}');
+}
+
+void GameWriter::AppendTsv(std::string_view field) {
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < field.size(); i++) {
+    const char *escaped;
+    switch (field[i]) {
+      case '\t': escaped = "\\t"; break;
+      case '\n': escaped = "\\n"; break;
+      case '\\': escaped = "\\\\"; break;
+      default: continue;
+    }
+    out_.Append(field.substr(start, i - start));
+    out_.Append(escaped);
+    start = i + 1;
+  }
+  out_.Append(field.substr(start));
+}
+
+void GameWriter::AppendJson(std::string_view str) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out_.Append('"');
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < str.size(); i++) {
+    unsigned char c = str[i];
+    if (c >= 0x20 && c != '"' && c != '\\') continue;
+    out_.Append(str.substr(start, i - start));
+    start = i + 1;
+    switch (c) {
+      case '"': out_.Append("\\\""); break;
+      case '\\': out_.Append("\\\\"); break;
+      case '\n': out_.Append("\\n"); break;
+      case '\t': out_.Append("\\t"); break;
+      default:
+        out_.Append("\\u00");
+        out_.Append(kHex[c >> 4]);
+        out_.Append(kHex[c & 0xf]);
+        break;
+    }
+  }
+  out_.Append(str.substr(start));
+  out_.Append('"');
+}
+
+}  // namespace roman
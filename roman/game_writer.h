@@ -0,0 +1,59 @@
+#ifndef ROMAN_GAME_WRITER_H_
+#define ROMAN_GAME_WRITER_H_
+
+#include <string_view>
+
+#include "dat2pb/romdat.pb.h"
+#include "google/protobuf/message.h"
+#include "rhutil/status.h"
+#include "roman/index/game_index.pb.h"
+#include "roman/util/fd_writer.h"
+
+namespace roman {
+
+// Writes the games of a datpb or game index one at a time, in line oriented
+// formats which grep, awk and jq can consume while they are being written.
+//
+// kTsv writes a header line, then a line for each ROM holding the game's
+// name, the ROM's name, size, crc, md5 and sha1, and the path it was found at
+// (empty for datpbs). Tabs, newlines and backslashes within fields are
+// escaped as \t, \n and \\.
+//
+// kJsonl writes a line for each game, e.g.
+//   {"name":"Game","roms":[{"name":"Game.bin","size":1,"crc":"..."}]}
+// ROMs of a game index also have a "path", and its games a "complete" which
+// says whether every ROM of the game was found.
+class GameWriter {
+ public:
+  enum class Format { kTsv, kJsonl };
+
+  // Parses "tsv" or "jsonl".
+  static rhutil::StatusOr<Format> ParseFormat(std::string_view name);
+
+  GameWriter(int fd, Format format) : out_(fd), format_(format) {}
+
+  void Write(const dat2pb::RomDat::Game &game);
+  void Write(const GameIndex::Game &game);
+
+  // Writes the games of a RomDat or a GameIndex.
+  rhutil::Status WriteAll(const google::protobuf::Message &message);
+
+  rhutil::Status Flush() { return out_.Flush(); }
+
+ private:
+  void WriteTsvHeader();
+  void WriteTsvRom(std::string_view game, const dat2pb::RomDat::Game::Rom &rom,
+                   std::string_view path);
+  void WriteJsonlRom(const dat2pb::RomDat::Game::Rom &rom,
+                     const std::string *path);
+  void AppendTsv(std::string_view field);
+  void AppendJson(std::string_view str);
+
+  FdWriter out_;
+  const Format format_;
+  bool wrote_header_ = false;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_GAME_WRITER_H_
@@ -0,0 +1,84 @@
+#include "roman/hash/content_hasher.h"
+
+#include <algorithm>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_format.h"
+#include "zlib.h"
+
+namespace roman {
+
+namespace {
+
+std::string HexDigest(const unsigned char *digest, std::size_t size) {
+  return absl::BytesToHexString(
+      std::string_view(reinterpret_cast<const char *>(digest), size));
+}
+
+}  // namespace
+
+ContentHasher::ContentHasher(absl::Span<const Hash::Type> types)
+    : types_(types.begin(), types.end()) {
+  for (Hash::Type type : types_) {
+    switch (type) {
+      case Hash::MD5:
+        md5_ = true;
+        MD5_Init(&md5_ctx_);
+        break;
+      case Hash::SHA1:
+        sha1_ = true;
+        SHA1_Init(&sha1_ctx_);
+        break;
+      case Hash::CRC:
+        crc_ = true;
+        crc_value_ = crc32(0L, Z_NULL, 0);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void ContentHasher::Update(std::string_view data) {
+  size_ += data.size();
+  if (md5_) MD5_Update(&md5_ctx_, data.data(), data.size());
+  if (sha1_) SHA1_Update(&sha1_ctx_, data.data(), data.size());
+  if (crc_) {
+    // crc32 takes a uInt length, so feed it in pieces.
+    const auto *bytes = reinterpret_cast<const Bytef *>(data.data());
+    for (std::size_t off = 0; off < data.size();) {
+      uInt len = static_cast<uInt>(
+          std::min<std::size_t>(data.size() - off, 1u << 30));
+      crc_value_ = crc32(crc_value_, bytes + off, len);
+      off += len;
+    }
+  }
+}
+
+std::vector<Hash> ContentHasher::Finalize() {
+  std::vector<Hash> hashes;
+  for (Hash::Type type : types_) {
+    switch (type) {
+      case Hash::MD5: {
+        unsigned char digest[MD5_DIGEST_LENGTH];
+        MD5_Final(digest, &md5_ctx_);
+        hashes.emplace_back(type, HexDigest(digest, sizeof(digest)));
+        break;
+      }
+      case Hash::SHA1: {
+        unsigned char digest[SHA_DIGEST_LENGTH];
+        SHA1_Final(digest, &sha1_ctx_);
+        hashes.emplace_back(type, HexDigest(digest, sizeof(digest)));
+        break;
+      }
+      case Hash::CRC:
+        hashes.emplace_back(type, absl::StrFormat("%08x", crc_value_));
+        break;
+      default:
+        break;
+    }
+  }
+  return hashes;
+}
+
+}  // namespace roman
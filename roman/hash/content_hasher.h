@@ -0,0 +1,40 @@
+#ifndef ROMAN_HASH_CONTENT_HASHER_H_
+#define ROMAN_HASH_CONTENT_HASHER_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "openssl/md5.h"
+#include "openssl/sha.h"
+#include "roman/hash.h"
+
+namespace roman {
+
+// Incrementally computes several hashes of the same content in one pass.
+// Values are lowercase hex, as in dat files.
+class ContentHasher {
+ public:
+  explicit ContentHasher(absl::Span<const Hash::Type> types);
+
+  void Update(std::string_view data);
+
+  // The hashes of everything passed to Update, in the order of the types
+  // given to the constructor.
+  std::vector<Hash> Finalize();
+
+  std::int64_t size() const { return size_; }
+
+ private:
+  std::vector<Hash::Type> types_;
+  bool md5_ = false, sha1_ = false, crc_ = false;
+  MD5_CTX md5_ctx_;
+  SHA_CTX sha1_ctx_;
+  unsigned long crc_value_ = 0;
+  std::int64_t size_ = 0;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_HASH_CONTENT_HASHER_H_
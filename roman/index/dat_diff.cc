@@ -0,0 +1,221 @@
+#include "roman/index/dat_diff.h"
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/util/message_differencer.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::google::protobuf::RepeatedPtrField;
+using ::google::protobuf::util::MessageDifferencer;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+
+namespace {
+
+// The elements of `field` in order of name. Sorting is stable, so that
+// elements of the same name keep their order.
+template <typename T>
+std::vector<const T*> SortedByName(const RepeatedPtrField<T> &field) {
+  std::vector<const T*> sorted;
+  sorted.reserve(field.size());
+  for (const T &element : field) sorted.push_back(&element);
+  auto by_name = [](const T *a, const T *b) { return a->name() < b->name(); };
+  if (!std::is_sorted(sorted.begin(), sorted.end(), by_name)) {
+    std::stable_sort(sorted.begin(), sorted.end(), by_name);
+  }
+  return sorted;
+}
+
+StatusOr<std::vector<const RomDat::Game*>> GamesByName(
+    const RomDat &dat, std::string_view which) {
+  std::vector<const RomDat::Game*> games = SortedByName(dat.game());
+  auto it = std::adjacent_find(
+      games.begin(), games.end(),
+      [](const RomDat::Game *a, const RomDat::Game *b) {
+        return a->name() == b->name();
+      });
+  if (it != games.end()) {
+    return InvalidArgumentErrorBuilder()
+        << "The " << which << " dat has several games named "
+        << (*it)->name();
+  }
+  return games;
+}
+
+// Walks two sequences sorted by name side by side, calling `only_old` or
+// `only_new` with the elements of a name only one of them has, and `both`
+// with those of a name both have.
+template <typename T, typename OnlyOld, typename OnlyNew, typename Both>
+void MergeByName(const std::vector<const T*> &old_elements,
+                 const std::vector<const T*> &new_elements,
+                 OnlyOld only_old, OnlyNew only_new, Both both) {
+  size_t i = 0, j = 0;
+  while (i < old_elements.size() || j < new_elements.size()) {
+    if (j == new_elements.size() ||
+        (i < old_elements.size() &&
+         old_elements[i]->name() < new_elements[j]->name())) {
+      only_old(*old_elements[i++]);
+    } else if (i == old_elements.size() ||
+               new_elements[j]->name() < old_elements[i]->name()) {
+      only_new(*new_elements[j++]);
+    } else {
+      both(*old_elements[i++], *new_elements[j++]);
+    }
+  }
+}
+
+DatDiff::ChangedGame DiffGame(const RomDat::Game &old_game,
+                              const RomDat::Game &new_game) {
+  DatDiff::ChangedGame changed;
+  *changed.mutable_dat() = new_game;
+  MergeByName(
+      SortedByName(old_game.rom()), SortedByName(new_game.rom()),
+      [&](const RomDat::Game::Rom &rom) { *changed.add_removed_rom() = rom; },
+      [&](const RomDat::Game::Rom &rom) { *changed.add_added_rom() = rom; },
+      [&](const RomDat::Game::Rom &old_rom, const RomDat::Game::Rom &rom) {
+        if (!MessageDifferencer::Equals(old_rom, rom)) {
+          *changed.add_changed_rom() = rom;
+        }
+      });
+  return changed;
+}
+
+// The hashes `rom` has, strongest first.
+std::vector<Hash> RomHashes(const RomDat::Game::Rom &rom) {
+  std::vector<Hash> hashes;
+  if (!rom.sha1().empty()) hashes.emplace_back(Hash::SHA1, rom.sha1());
+  if (!rom.md5().empty()) hashes.emplace_back(Hash::MD5, rom.md5());
+  if (!rom.crc().empty()) hashes.emplace_back(Hash::CRC, rom.crc());
+  return hashes;
+}
+
+}  // namespace
+
+StatusOr<DatDiff> DiffDats(const RomDat &old_dat, const RomDat &new_dat) {
+  ASSIGN_OR_RETURN(std::vector<const RomDat::Game*> old_games,
+                   GamesByName(old_dat, "old"));
+  ASSIGN_OR_RETURN(std::vector<const RomDat::Game*> new_games,
+                   GamesByName(new_dat, "new"));
+  DatDiff diff;
+  MergeByName(
+      old_games, new_games,
+      [&](const RomDat::Game &game) { diff.add_removed(game.name()); },
+      [&](const RomDat::Game &game) { *diff.add_added() = game; },
+      [&](const RomDat::Game &old_game, const RomDat::Game &game) {
+        if (!MessageDifferencer::Equals(old_game, game)) {
+          *diff.add_changed() = DiffGame(old_game, game);
+        }
+      });
+  return diff;
+}
+
+IndexRetargeter::IndexRetargeter(const DatDiff &diff, GameCallback callback)
+    : diff_(diff), callback_(std::move(callback)) {
+  removed_.insert(diff.removed().begin(), diff.removed().end());
+  auto want = [this](const RomDat::Game::Rom &rom) {
+    for (Hash &hash : RomHashes(rom)) wanted_.emplace(std::move(hash), "");
+  };
+  for (const DatDiff::ChangedGame &changed : diff.changed()) {
+    changed_.emplace(changed.dat().name(), &changed);
+    for (const RomDat::Game::Rom &rom : changed.added_rom()) want(rom);
+    for (const RomDat::Game::Rom &rom : changed.changed_rom()) want(rom);
+  }
+  for (const RomDat::Game &game : diff.added()) {
+    for (const RomDat::Game::Rom &rom : game.rom()) want(rom);
+  }
+}
+
+Status IndexRetargeter::AddGame(GameIndex::Game game) {
+  for (const GameIndex::Game::Rom &rom : game.rom()) NoteFile(rom);
+
+  if (removed_.contains(game.dat().name())) {
+    stats_.removed++;
+    return OkStatus();
+  }
+  auto it = changed_.find(game.dat().name());
+  if (it == changed_.end()) {
+    stats_.kept++;
+    return callback_(std::move(game));
+  }
+
+  // The files of the ROMs which the new game has unchanged still match.
+  const DatDiff::ChangedGame &changed = *it->second;
+  absl::flat_hash_set<std::string_view> stale;
+  for (const RomDat::Game::Rom &rom : changed.removed_rom()) {
+    stale.insert(rom.name());
+  }
+  for (const RomDat::Game::Rom &rom : changed.changed_rom()) {
+    stale.insert(rom.name());
+  }
+  GameIndex::Game &kept = pending_[changed.dat().name()];
+  *kept.mutable_dat() = changed.dat();
+  for (GameIndex::Game::Rom &rom : *game.mutable_rom()) {
+    if (!stale.contains(rom.dat().name())) *kept.add_rom() = std::move(rom);
+  }
+  return OkStatus();
+}
+
+Status IndexRetargeter::Finish() {
+  if (finished_) return OkStatus();
+  finished_ = true;
+  for (const DatDiff::ChangedGame &changed : diff_.changed()) {
+    GameIndex::Game game;
+    if (auto it = pending_.find(changed.dat().name()); it != pending_.end()) {
+      game = std::move(it->second);
+    } else {
+      *game.mutable_dat() = changed.dat();
+    }
+    AddFoundRoms(changed.added_rom(), &game);
+    AddFoundRoms(changed.changed_rom(), &game);
+    if (game.rom_size() == 0) continue;
+    stats_.changed++;
+    RETURN_IF_ERROR(callback_(std::move(game)));
+  }
+  pending_.clear();
+  for (const RomDat::Game &added : diff_.added()) {
+    GameIndex::Game game;
+    *game.mutable_dat() = added;
+    AddFoundRoms(added.rom(), &game);
+    if (game.rom_size() == 0) continue;
+    stats_.added++;
+    RETURN_IF_ERROR(callback_(std::move(game)));
+  }
+  return OkStatus();
+}
+
+void IndexRetargeter::NoteFile(const GameIndex::Game::Rom &rom) {
+  for (const Hash &hash : RomHashes(rom.dat())) {
+    auto it = wanted_.find(hash);
+    if (it != wanted_.end() && it->second.empty()) it->second = rom.path();
+  }
+}
+
+const std::string *IndexRetargeter::FindFile(
+    const RomDat::Game::Rom &rom) const {
+  for (const Hash &hash : RomHashes(rom)) {
+    auto it = wanted_.find(hash);
+    if (it != wanted_.end() && !it->second.empty()) return &it->second;
+  }
+  return nullptr;
+}
+
+void IndexRetargeter::AddFoundRoms(
+    const RepeatedPtrField<RomDat::Game::Rom> &roms,
+    GameIndex::Game *game) const {
+  for (const RomDat::Game::Rom &rom : roms) {
+    const std::string *path = FindFile(rom);
+    if (path == nullptr) continue;
+    GameIndex::Game::Rom *irom = game->add_rom();
+    *irom->mutable_dat() = rom;
+    irom->set_path(*path);
+  }
+}
+
+}  // namespace roman
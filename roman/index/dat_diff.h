@@ -0,0 +1,87 @@
+#ifndef ROMAN_INDEX_DAT_DIFF_H_
+#define ROMAN_INDEX_DAT_DIFF_H_
+
+#include <functional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/status.h"
+#include "roman/hash.h"
+#include "roman/index/dat_diff.pb.h"
+#include "roman/index/game_index.pb.h"
+
+namespace roman {
+
+// Computes how `new_dat` differs from `old_dat`.
+//
+// Both dats are walked once, side by side, in order of game name, so that the
+// diff takes time linear in their size and needs no more memory than the
+// games which differ. Dats are normally sorted by name already; one which
+// isn't is sorted first. Fails if either dat has several games of the same
+// name, as those can't be told apart.
+rhutil::StatusOr<DatDiff> DiffDats(const dat2pb::RomDat &old_dat,
+                                   const dat2pb::RomDat &new_dat);
+
+// Turns an index built against the old dat of a DatDiff into one of the new
+// dat, without listing the remote again.
+//
+// Games the diff doesn't mention are passed through untouched. Removed games
+// are dropped. A changed game keeps the files of its unchanged ROMs, and its
+// other ROMs, like those of added games, are looked for among the files of
+// the whole index by hash. Files the old index didn't identify are never
+// seen, so an added game whose files are new to the remote needs a full roman
+// index to be found.
+class IndexRetargeter {
+ public:
+  using GameCallback = std::function<rhutil::Status(GameIndex::Game)>;
+
+  struct Stats {
+    int kept = 0;
+    int removed = 0;
+    int changed = 0;
+    int added = 0;
+  };
+
+  // `diff` must outlive the retargeter.
+  IndexRetargeter(const DatDiff &diff, GameCallback callback);
+
+  // Takes the next game of the old index. Games the diff doesn't touch are
+  // passed to the callback right away.
+  rhutil::Status AddGame(GameIndex::Game game);
+
+  // Passes the changed and added games of which any file was found to the
+  // callback.
+  rhutil::Status Finish();
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  // Notes the path of `rom` if Finish looks for a ROM of the same hash.
+  void NoteFile(const GameIndex::Game::Rom &rom);
+  // Where NoteFile found a file for `rom`, or nullptr.
+  const std::string *FindFile(const dat2pb::RomDat::Game::Rom &rom) const;
+  // Adds the ROMs of `roms` of which a file was found to `game`.
+  void AddFoundRoms(
+      const google::protobuf::RepeatedPtrField<dat2pb::RomDat::Game::Rom>
+          &roms,
+      GameIndex::Game *game) const;
+
+  const DatDiff &diff_;
+  GameCallback callback_;
+  Stats stats_;
+  bool finished_ = false;
+
+  absl::flat_hash_set<std::string> removed_;
+  absl::flat_hash_map<std::string, const DatDiff::ChangedGame*> changed_;
+  // The changed games of the old index by name, with the ROMs they keep.
+  absl::flat_hash_map<std::string, GameIndex::Game> pending_;
+  // Each hash of the ROMs Finish looks for, with the path of the first file of
+  // the old index which has it, or an empty path while none has.
+  absl::flat_hash_map<Hash, std::string> wanted_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_INDEX_DAT_DIFF_H_
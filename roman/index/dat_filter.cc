@@ -0,0 +1,90 @@
+#include "roman/index/dat_filter.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+
+namespace {
+
+// The extension of a file name, without the dot, or "" if it has none.
+std::string_view Extension(std::string_view name) {
+  std::string_view::size_type dot = name.rfind('.');
+  if (dot == std::string_view::npos || dot == 0) return "";
+  return name.substr(dot + 1);
+}
+
+// Adds name prefixes which together cover the ROMs of `game`: the game's name
+// when the ROMs are named after the game (e.g. "Game (USA) (Track 1).bin"),
+// and otherwise the ROM names up to their extension.
+void AddPrefixes(const RomDat::Game &game, std::set<std::string> *out) {
+  bool named_after_game = !game.name().empty();
+  for (const RomDat::Game::Rom &rom : game.rom()) {
+    if (!absl::StartsWithIgnoreCase(rom.name(), game.name())) {
+      named_after_game = false;
+    }
+  }
+  if (named_after_game) {
+    out->insert(game.name());
+    return;
+  }
+  for (const RomDat::Game::Rom &rom : game.rom()) {
+    std::string_view name = rom.name();
+    // ROMs may live in a subdirectory of the game; filter rules without a
+    // slash match the file name alone.
+    std::string_view::size_type slash = name.rfind('/');
+    if (slash != std::string_view::npos) name = name.substr(slash + 1);
+    std::string_view ext = Extension(name);
+    if (!ext.empty()) name.remove_suffix(ext.size() + 1);
+    out->emplace(name);
+  }
+}
+
+}  // namespace
+
+ListingFilter ListingFilterFromDat(const RomDat &dat,
+                                   const DatFilterOptions &opts) {
+  ListingFilter filter;
+  std::set<std::string> extensions;
+  std::set<std::string> prefixes;
+  bool all_have_extensions = true;
+  bool any_rom = false;
+  std::int64_t min_size = 0, max_size = 0;
+  for (const RomDat::Game &game : dat.game()) {
+    for (const RomDat::Game::Rom &rom : game.rom()) {
+      std::string_view ext = Extension(rom.name());
+      if (ext.empty()) {
+        all_have_extensions = false;
+      } else {
+        extensions.insert(absl::AsciiStrToLower(ext));
+      }
+      std::int64_t size = rom.size();
+      min_size = any_rom ? std::min(min_size, size) : size;
+      max_size = any_rom ? std::max(max_size, size) : size;
+      any_rom = true;
+    }
+    if (opts.prefixes) AddPrefixes(game, &prefixes);
+  }
+  if (!any_rom) return filter;
+
+  if (all_have_extensions) {
+    filter.extensions.assign(extensions.begin(), extensions.end());
+  }
+  if (opts.prefixes) {
+    filter.name_prefixes.assign(prefixes.begin(), prefixes.end());
+  }
+  if (opts.sizes) {
+    filter.min_size = min_size;
+    filter.max_size = max_size;
+  }
+  return filter;
+}
+
+}  // namespace roman
@@ -0,0 +1,25 @@
+#ifndef ROMAN_INDEX_DAT_FILTER_H_
+#define ROMAN_INDEX_DAT_FILTER_H_
+
+#include "dat2pb/romdat.pb.h"
+#include "roman/rclone/listing_filter.h"
+
+namespace roman {
+
+struct DatFilterOptions {
+  // Admit only files whose size is within those of the dat's ROMs.
+  bool sizes = false;
+  // Admit only files whose name starts like one of the dat's ROMs.
+  bool prefixes = false;
+};
+
+// A filter admitting every file which could be one of `dat`'s ROMs, so that
+// other files in the same folders (artwork, manuals, saves) can be left out
+// of remote listings. The filter always restricts file extensions, unless
+// some ROM has none.
+ListingFilter ListingFilterFromDat(const dat2pb::RomDat &dat,
+                                   const DatFilterOptions &opts);
+
+}  // namespace roman
+
+#endif  // ROMAN_INDEX_DAT_FILTER_H_
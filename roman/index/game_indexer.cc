@@ -12,6 +12,19 @@ using ::dat2pb::RomDat;
 
 namespace {
 
+std::string_view RomHash(Hash::Type type, const RomDat::Game::Rom &rom) {
+  switch (type) {
+    case Hash::MD5:
+      return rom.md5();
+    case Hash::SHA1:
+      return rom.sha1();
+    case Hash::CRC:
+      return rom.crc();
+    default:
+      CHECK(false);
+  }
+}
+
 absl::flat_hash_map<
   Hash, std::vector<std::pair<const RomDat::Game*, const RomDat::Game::Rom*>>>
 RomsByHash(Hash::Type type, const RomDat &dat) {
@@ -21,21 +34,8 @@ RomsByHash(Hash::Type type, const RomDat &dat) {
       roms_by_hash;
   for (const RomDat::Game &game : dat.game()) {
     for (const RomDat::Game::Rom &rom : game.rom()) {
-      std::string_view hval;
-      switch (type) {
-        case Hash::MD5:
-          hval = rom.md5();
-          break;
-        case Hash::SHA1:
-          hval = rom.sha1();
-          break;
-        case Hash::CRC:
-          hval = rom.crc();
-          break;
-        default:
-          CHECK(false);
-      }
-      roms_by_hash[Hash(type, hval)].emplace_back(std::make_pair(&game, &rom));
+      roms_by_hash[Hash(type, RomHash(type, rom))].emplace_back(
+          std::make_pair(&game, &rom));
     }
   }
 
@@ -44,8 +44,31 @@ RomsByHash(Hash::Type type, const RomDat &dat) {
 
 }  // namespace
 
+std::vector<Hash::Type> GameIndexer::UsableHashTypes(const RomDat &dat) {
+  std::vector<Hash::Type> types;
+  for (Hash::Type type : {Hash::MD5, Hash::SHA1, Hash::CRC}) {
+    bool usable = true;
+    for (const RomDat::Game &game : dat.game()) {
+      for (const RomDat::Game::Rom &rom : game.rom()) {
+        usable &= !RomHash(type, rom).empty();
+      }
+    }
+    if (usable) types.push_back(type);
+  }
+  return types;
+}
+
 GameIndexer::GameIndexer(Hash::Type hash_type, const RomDat &dat)
-  : hash_type_(hash_type), roms_by_hash_(RomsByHash(hash_type, dat))
+  : GameIndexer(hash_type, dat, [this](GameIndex::Game game) {
+      *index_.add_game() = std::move(game);
+      return OkStatus();
+    })
+{}
+
+GameIndexer::GameIndexer(Hash::Type hash_type, const RomDat &dat,
+                         GameCallback callback)
+  : hash_type_(hash_type), callback_(std::move(callback)),
+    roms_by_hash_(RomsByHash(hash_type, dat))
 {}
 
 Status GameIndexer::AddFile(absl::string_view path, const Hash &hash) {
@@ -71,34 +94,52 @@ Status GameIndexer::AddFile(absl::string_view path, const Hash &hash) {
   for (const auto &p : *games_and_roms) {
     const RomDat::Game *game = p.first;
     const RomDat::Game::Rom *rom = p.second;
+    if (complete_games_.contains(game)) continue;
+    if (!indexed_roms_.emplace(game, rom).second) continue;
 
     GameIndex::Game *igame;
-    if (auto it = indexed_games_.find(game); it == indexed_games_.end()) {
-      igame = index_.add_game();
+    if (auto it = partial_games_.find(game); it == partial_games_.end()) {
+      igame = &partial_games_[game];
       *igame->mutable_dat() = *game;
-      indexed_games_[game] = igame;
+      partial_order_.push_back(game);
     } else {
-      igame = it->second;
+      igame = &it->second;
     }
 
-    GameIndex::Game::Rom *irom;
-    auto key = std::make_pair(game, rom);
-    if (auto it = indexed_roms_.find(key); it == indexed_roms_.end()) {
-      GameIndex::Game::Rom *irom = igame->add_rom();
-      *irom->mutable_dat() = *rom;
-      irom->set_path(std::string(path));
-      indexed_roms_[key] = irom;
-    } else {
-      irom = it->second;
-    }
+    GameIndex::Game::Rom *irom = igame->add_rom();
+    *irom->mutable_dat() = *rom;
+    irom->set_path(std::string(path));
 
-    (void)irom;
+    if (igame->rom_size() == game->rom_size()) {
+      GameIndex::Game complete = std::move(*igame);
+      partial_games_.erase(game);
+      complete_games_.insert(game);
+      for (const RomDat::Game::Rom &r : game->rom()) {
+        indexed_roms_.erase(std::make_pair(game, &r));
+      }
+      RETURN_IF_ERROR(callback_(std::move(complete)));
+    }
   }
 
   return OkStatus();
 }
 
+Status GameIndexer::Finish() {
+  if (finished_) return OkStatus();
+  finished_ = true;
+  for (const RomDat::Game *game : partial_order_) {
+    auto it = partial_games_.find(game);
+    if (it == partial_games_.end()) continue;
+    RETURN_IF_ERROR(callback_(std::move(it->second)));
+    partial_games_.erase(it);
+  }
+  partial_order_.clear();
+  indexed_roms_.clear();
+  return OkStatus();
+}
+
 StatusOr<GameIndex> GameIndexer::GetIndex() {
+  RETURN_IF_ERROR(Finish());
   return std::move(index_);
 }
 
@@ -1,11 +1,13 @@
 #ifndef ROMAN_GAME_INDEXER_H_
 #define ROMAN_GAME_INDEXER_H_
 
+#include <functional>
 #include <vector>
 #include <string_view>
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "dat2pb/romdat.pb.h"
 #include "roman/index/game_index.pb.h"
 #include "roman/hash.h"
@@ -15,22 +17,42 @@ namespace roman {
 
 class GameIndexer {
  public:
+  using GameCallback = std::function<rhutil::Status(GameIndex::Game)>;
+
+  // Collects the index for GetIndex.
   GameIndexer(Hash::Type hash_type, const dat2pb::RomDat &dat);
+  // Passes each game to `callback` as soon as all of its ROMs have been
+  // found, and the games found only in part on Finish, so that only the
+  // latter are kept in memory.
+  GameIndexer(Hash::Type hash_type, const dat2pb::RomDat &dat,
+              GameCallback callback);
+
+  // The hash types which every rom in the dat carries, and so which an indexer
+  // for the dat can use, most preferred first.
+  static std::vector<Hash::Type> UsableHashTypes(const dat2pb::RomDat &dat);
 
   rhutil::Status AddFile(absl::string_view path, const Hash &hash);
 
+  // Passes the games found only in part to the callback, in the order they
+  // were first found.
+  rhutil::Status Finish();
+
+  // Finishes, and returns the games of an indexer without a callback.
   rhutil::StatusOr<GameIndex> GetIndex();
 
  private:
   Hash::Type hash_type_;
+  GameCallback callback_;
+  bool finished_ = false;
 
   GameIndex index_;
-  absl::flat_hash_map<const dat2pb::RomDat::Game*,
-                      GameIndex::Game*>
-      indexed_games_;
-  absl::flat_hash_map<std::pair<const dat2pb::RomDat::Game*,
-                                const dat2pb::RomDat::Game::Rom*>,
-                      GameIndex::Game::Rom*>
+  // Games some but not all of whose ROMs have been found.
+  absl::flat_hash_map<const dat2pb::RomDat::Game*, GameIndex::Game>
+      partial_games_;
+  std::vector<const dat2pb::RomDat::Game*> partial_order_;
+  absl::flat_hash_set<const dat2pb::RomDat::Game*> complete_games_;
+  absl::flat_hash_set<std::pair<const dat2pb::RomDat::Game*,
+                                const dat2pb::RomDat::Game::Rom*>>
       indexed_roms_;
 
   const absl::flat_hash_map<
@@ -0,0 +1,37 @@
+#include "roman/index/index_reader.h"
+
+#include <memory>
+#include <utility>
+
+#include "roman/proto_file.h"
+#include "roman/proto_stream.h"
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+Status ReadGameIndex(std::string_view path,
+                     const std::function<Status(GameIndex::Game)> &callback) {
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoInputFile> in,
+                   ProtoInputFile::Open(path));
+  RepeatedFieldReader reader(
+      in->stream(),
+      GameIndex::descriptor()->FindFieldByNumber(GameIndex::kGameFieldNumber));
+  GameIndex::Game game;
+  while (true) {
+    StatusOr<bool> more = reader.Read(&game);
+    if (!in->status().ok()) more = in->status();
+    if (!more.ok()) {
+      return UnknownErrorBuilder()
+          << "Failed to read game index from " << path << ": "
+          << more.status();
+    }
+    if (!more.value()) return OkStatus();
+    RETURN_IF_ERROR(callback(std::move(game)));
+  }
+}
+
+}  // namespace roman
@@ -0,0 +1,21 @@
+#ifndef ROMAN_INDEX_INDEX_READER_H_
+#define ROMAN_INDEX_INDEX_READER_H_
+
+#include <functional>
+#include <string_view>
+
+#include "rhutil/status.h"
+#include "roman/index/game_index.pb.h"
+
+namespace roman {
+
+// Calls `callback` with each game of the binary index at `path`, or on stdin
+// if `path` is "-", reading one game at a time. Compressed indexes are
+// decompressed as they are read.
+rhutil::Status ReadGameIndex(
+    std::string_view path,
+    const std::function<rhutil::Status(GameIndex::Game)> &callback);
+
+}  // namespace roman
+
+#endif  // ROMAN_INDEX_INDEX_READER_H_
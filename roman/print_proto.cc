@@ -1,22 +1,65 @@
 #include "roman/print_proto.h"
 
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+
 #include "rhutil/status.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
 #include "google/protobuf/text_format.h"
+#include "roman/chunked_proto.h"
+#include "roman/proto_file.h"
 
 ABSL_FLAG(bool, binary, false,
           "Output using the binary format instead of text");
+ABSL_FLAG(bool, chunked, false,
+          "With --binary, write a datpb as independently parseable chunks of "
+          "games, which readers parse in parallel.");
+ABSL_FLAG(int, chunk_size, 1024,
+          "How many games each chunk of a --chunked datpb holds.");
+ABSL_FLAG(std::string, output_format, "",
+          "Write games as tsv, with a line per ROM, or as jsonl, with a line "
+          "per game, instead of as a protobuf. Both are written as the games "
+          "are iterated, for grep, awk or jq to consume.");
 
 namespace roman {
 
+using ::dat2pb::RomDat;
+using ::rhutil::InvalidArgumentError;
 using ::rhutil::Status;
-using ::rhutil::OkStatus;
+using ::rhutil::StatusOr;
 using ::rhutil::UnknownError;
+using ::google::protobuf::FieldDescriptor;
 using ::google::protobuf::Message;
 using ::google::protobuf::io::OstreamOutputStream;
 using ::google::protobuf::TextFormat;
 
+StatusOr<std::optional<GameWriter::Format>> GameFormatFromFlags() {
+  std::string name = absl::GetFlag(FLAGS_output_format);
+  if (name.empty()) return std::nullopt;
+  if (absl::GetFlag(FLAGS_binary) || absl::GetFlag(FLAGS_compress)) {
+    return InvalidArgumentError(
+        "--output_format can't be combined with --binary or --compress");
+  }
+  ASSIGN_OR_RETURN(GameWriter::Format format, GameWriter::ParseFormat(name));
+  return format;
+}
+
 Status PrintProto(const Message &message, std::ostream *out) {
+  ASSIGN_OR_RETURN(std::optional<GameWriter::Format> format,
+                   GameFormatFromFlags());
+  if (format) {
+    if (out != &std::cout) {
+      return InvalidArgumentError("--output_format only writes to stdout");
+    }
+    std::cout.flush();
+    GameWriter writer(STDOUT_FILENO, *format);
+    return writer.WriteAll(message);
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoOutput> output,
+                   ProtoOutput::Create(out));
+  out = output->stream();
   if (absl::GetFlag(FLAGS_binary)) {
     if (!message.SerializeToOstream(out)) {
       return UnknownError("Failed to write romdat to stdout");
@@ -27,7 +70,26 @@ Status PrintProto(const Message &message, std::ostream *out) {
       return UnknownError("Failed to write romdat textproto to stdout");
     }
   }
-  return OkStatus();
+  return output->Finish();
+}
+
+Status PrintChunkedProto(Message *message, const FieldDescriptor *field,
+                         std::ostream *out) {
+  if (!absl::GetFlag(FLAGS_binary) || !absl::GetFlag(FLAGS_chunked)) {
+    return PrintProto(*message, out);
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoOutput> output,
+                   ProtoOutput::Create(out));
+  RETURN_IF_ERROR(WriteChunkedProto(message, field,
+                                    absl::GetFlag(FLAGS_chunk_size),
+                                    output->stream()));
+  return output->Finish();
+}
+
+Status PrintDatPB(RomDat *dat, std::ostream *out) {
+  return PrintChunkedProto(
+      dat, RomDat::descriptor()->FindFieldByNumber(RomDat::kGameFieldNumber),
+      out);
 }
 
 }  // namespace roman
@@ -1,19 +1,45 @@
 #ifndef ROMAN_PRINT_PROTO_H_
 #define ROMAN_PRINT_PROTO_H_
 
+#include <optional>
 #include <ostream>
+#include <string>
 
 #include "absl/flags/flag.h"
+#include "dat2pb/romdat.pb.h"
 #include "rhutil/status.h"
+#include "google/protobuf/descriptor.h"
 #include "google/protobuf/message.h"
+#include "roman/game_writer.h"
 
 ABSL_DECLARE_FLAG(bool, binary);
+ABSL_DECLARE_FLAG(bool, chunked);
+ABSL_DECLARE_FLAG(int, chunk_size);
+ABSL_DECLARE_FLAG(std::string, output_format);
 
 namespace roman {
 
+// The format --output_format selects for writing games, or nullopt to write
+// protobufs as --binary says.
+rhutil::StatusOr<std::optional<GameWriter::Format>> GameFormatFromFlags();
+
+// Writes `message` to `out` as text or, with --binary, as a binary protobuf.
+// With --output_format, writes the games of a RomDat or GameIndex with a
+// GameWriter instead, which only writes to std::cout.
 rhutil::Status PrintProto(const google::protobuf::Message &message,
                           std::ostream *out);
 
+// Like PrintProto, but with --binary and --chunked, writes a chunked proto
+// (see chunked_proto.h) in which `field` is split into chunks of
+// --chunk_size elements, for readers to parse in parallel. `message` is left
+// as it was.
+rhutil::Status PrintChunkedProto(google::protobuf::Message *message,
+                                 const google::protobuf::FieldDescriptor *field,
+                                 std::ostream *out);
+
+// PrintChunkedProto of a datpb, chunked by game.
+rhutil::Status PrintDatPB(dat2pb::RomDat *dat, std::ostream *out);
+
 }  // namespace roman
 
 #endif  // ROMAN_PRINT_PROTO_H_
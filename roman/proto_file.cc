@@ -0,0 +1,216 @@
+#include "roman/proto_file.h"
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "rhutil/file.h"
+#include "roman/chunked_proto.h"
+
+ABSL_FLAG(bool, compress, false,
+          "zstd compress the output. Compressed input is always detected and "
+          "decompressed.");
+ABSL_FLAG(int, compression_level, 19,
+          "The zstd compression level for --compress, from 1 to 22.");
+ABSL_FLAG(std::string, zstd_dictionary, "",
+          "A zstd dictionary, as written by roman traindict, for compressing "
+          "output with --compress and decompressing input compressed with "
+          "it.");
+ABSL_FLAG(int, parse_threads, 0,
+          "How many threads parse a chunked datpb, or the dats roman fetch "
+          "downloads. 0 means one per core.");
+
+namespace roman {
+namespace {
+
+using ::google::protobuf::Arena;
+using ::google::protobuf::ArenaOptions;
+using ::google::protobuf::Message;
+using ::google::protobuf::io::ArrayInputStream;
+using ::google::protobuf::io::IstreamInputStream;
+using ::rhutil::OkStatus;
+using ::rhutil::OpenInputFile;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+StatusOr<std::string> ReadZstdDictionary(std::string_view path) {
+  ASSIGN_OR_RETURN(std::ifstream in, OpenInputFile(path));
+  std::ostringstream contents;
+  if (!(contents << in.rdbuf())) {
+    return UnknownErrorBuilder()
+        << "Failed to read zstd dictionary from " << path;
+  }
+  return contents.str();
+}
+
+// The contents of --zstd_dictionary, read once.
+StatusOr<std::string_view> ZstdDictionaryFromFlags() {
+  static const StatusOr<std::string> *const dictionary = [] {
+    std::string path = absl::GetFlag(FLAGS_zstd_dictionary);
+    if (path.empty()) return new StatusOr<std::string>(std::string());
+    return new StatusOr<std::string>(ReadZstdDictionary(path));
+  }();
+  RETURN_IF_ERROR(dictionary->status());
+  return std::string_view(dictionary->value());
+}
+
+// Opens the file at `path`, or stdin if `path` is "-", decompressing it if it
+// is compressed.
+StatusOr<std::unique_ptr<ZstdInputStream>> OpenProtoInput(
+    std::string_view path) {
+  ASSIGN_OR_RETURN(std::string_view dictionary, ZstdDictionaryFromFlags());
+  if (path == "-") {
+    return std::make_unique<ZstdInputStream>(&std::cin, dictionary);
+  }
+  ASSIGN_OR_RETURN(std::ifstream file, OpenInputFile(path));
+  return std::make_unique<ZstdInputStream>(
+      std::make_unique<std::ifstream>(std::move(file)), dictionary);
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<ProtoOutput>> ProtoOutput::Create(std::ostream *out) {
+  std::unique_ptr<ProtoOutput> output(new ProtoOutput(out));
+  if (absl::GetFlag(FLAGS_compress)) {
+    ZstdOutputStream::Options opts;
+    opts.level = absl::GetFlag(FLAGS_compression_level);
+    ASSIGN_OR_RETURN(opts.dictionary, ZstdDictionaryFromFlags());
+    output->compressed_ = std::make_unique<ZstdOutputStream>(out, opts);
+  }
+  return output;
+}
+
+Status ProtoOutput::Finish() {
+  if (compressed_) return compressed_->Finish();
+  if (!out_->flush()) return UnknownErrorBuilder() << "Failed to write proto";
+  return OkStatus();
+}
+
+ProtoInputFile::~ProtoInputFile() {
+  // The stream may still refer to the mapping.
+  stream_.reset();
+  if (mapped_ != nullptr) munmap(mapped_, mapped_size_);
+}
+
+StatusOr<std::unique_ptr<ProtoInputFile>> ProtoInputFile::Open(
+    std::string_view path) {
+  std::unique_ptr<ProtoInputFile> file(new ProtoInputFile(path));
+  if (path != "-" && file->Map()) return file;
+  ASSIGN_OR_RETURN(file->decompressed_, OpenProtoInput(path));
+  file->stream_ =
+      std::make_unique<IstreamInputStream>(file->decompressed_.get());
+  return file;
+}
+
+bool ProtoInputFile::Map() {
+  // Anything unusual is left to the streaming path, which reports errors
+  // opening the file the same way as everywhere else.
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+      st.st_size > std::numeric_limits<int>::max()) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+  if (HasZstdMagic(std::string_view(static_cast<const char *>(addr), size))) {
+    munmap(addr, size);
+    return false;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  mapped_ = addr;
+  mapped_size_ = size;
+  stream_ = std::make_unique<ArrayInputStream>(mapped_, size);
+  return true;
+}
+
+bool ProtoInputFile::IsChunked() {
+  if (mapped()) {
+    return IsChunkedProto(
+        std::string_view(static_cast<const char *>(mapped_), mapped_size_));
+  }
+  const void *data;
+  int size;
+  if (!stream_->Next(&data, &size)) return false;
+  bool chunked =
+      IsChunkedProto(std::string_view(static_cast<const char *>(data), size));
+  stream_->BackUp(size);
+  return chunked;
+}
+
+Status ProtoInputFile::Parse(Message *message) {
+  if (IsChunked()) {
+    std::string_view data;
+    std::string buffer;
+    if (mapped()) {
+      data = std::string_view(static_cast<const char *>(mapped_),
+                              mapped_size_);
+    } else {
+      // Chunks are found by their offsets, so a stream is read whole first.
+      const void *next;
+      int size;
+      while (stream_->Next(&next, &size)) {
+        buffer.append(static_cast<const char *>(next), size);
+      }
+      RETURN_IF_ERROR(status());
+      data = buffer;
+    }
+    int threads = absl::GetFlag(FLAGS_parse_threads);
+    if (threads <= 0) threads = std::thread::hardware_concurrency();
+    Status status = ParseChunkedProto(data, message, threads);
+    if (!status.ok()) {
+      return UnknownErrorBuilder()
+          << "Failed to read " << message->GetTypeName() << " from " << path_
+          << ": " << status;
+    }
+    return OkStatus();
+  }
+
+  bool parsed = message->ParseFromZeroCopyStream(stream_.get());
+  RETURN_IF_ERROR(status());
+  if (!parsed) {
+    return UnknownErrorBuilder()
+        << "Failed to read " << message->GetTypeName() << " from " << path_;
+  }
+  return OkStatus();
+}
+
+Status ProtoInputFile::status() const {
+  if (decompressed_ == nullptr || decompressed_->status().ok()) {
+    return OkStatus();
+  }
+  return UnknownErrorBuilder()
+      << "Failed to read " << path_ << ": " << decompressed_->status();
+}
+
+std::unique_ptr<Arena> NewProtoFileArena() {
+  // The defaults start at 256 byte blocks and stop growing at 8KiB, which
+  // means thousands of blocks for a large dat.
+  ArenaOptions opts;
+  opts.start_block_size = 64 << 10;
+  opts.max_block_size = 1 << 20;
+  return std::make_unique<Arena>(opts);
+}
+
+Status ReadProtoFile(std::string_view path, Message *message) {
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoInputFile> in,
+                   ProtoInputFile::Open(path));
+  return in->Parse(message);
+}
+
+}  // namespace roman
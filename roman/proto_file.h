@@ -0,0 +1,133 @@
+#ifndef ROMAN_PROTO_FILE_H_
+#define ROMAN_PROTO_FILE_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/flags/flag.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+#include "rhutil/status.h"
+#include "roman/util/zstd_stream.h"
+
+ABSL_DECLARE_FLAG(bool, compress);
+ABSL_DECLARE_FLAG(int, compression_level);
+ABSL_DECLARE_FLAG(std::string, zstd_dictionary);
+ABSL_DECLARE_FLAG(int, parse_threads);
+
+namespace roman {
+
+// Where PrintProto and RepeatedFieldWriter write a proto to. With --compress,
+// everything written is zstd compressed, using --zstd_dictionary if given.
+class ProtoOutput {
+ public:
+  static rhutil::StatusOr<std::unique_ptr<ProtoOutput>> Create(
+      std::ostream *out);
+
+  std::ostream *stream() { return compressed_ ? compressed_.get() : out_; }
+
+  // Ends compression, and flushes the underlying stream.
+  rhutil::Status Finish();
+
+ private:
+  explicit ProtoOutput(std::ostream *out) : out_(out) {}
+
+  std::ostream *const out_;
+  std::unique_ptr<ZstdOutputStream> compressed_;
+};
+
+// A file holding a binary proto written by PrintProto, opened for parsing.
+//
+// Both plain binary protos and chunked ones (see chunked_proto.h) are
+// accepted. Uncompressed regular files are memory mapped, and parsed straight
+// out of the page cache without first being copied through an istream's
+// buffers. Compressed files and stdin are decompressed while they are read,
+// using --zstd_dictionary if given.
+class ProtoInputFile {
+ public:
+  // `path` is "-" for stdin.
+  static rhutil::StatusOr<std::unique_ptr<ProtoInputFile>> Open(
+      std::string_view path);
+  ~ProtoInputFile();
+
+  ProtoInputFile(const ProtoInputFile &) = delete;
+  ProtoInputFile &operator=(const ProtoInputFile &) = delete;
+
+  google::protobuf::io::ZeroCopyInputStream *stream() { return stream_.get(); }
+
+  // Parses the whole file into `message`. Chunked files (see
+  // chunked_proto.h) are parsed on up to --parse_threads threads.
+  rhutil::Status Parse(google::protobuf::Message *message);
+
+  // The error which ended a compressed file early, if any.
+  rhutil::Status status() const;
+
+  bool mapped() const { return mapped_ != nullptr; }
+
+ private:
+  explicit ProtoInputFile(std::string_view path) : path_(path) {}
+
+  // Maps the file if it is an uncompressed regular file. Returns false if it
+  // must be streamed instead.
+  bool Map();
+
+  // Whether the file is a chunked proto, without consuming any of it.
+  bool IsChunked();
+
+  const std::string path_;
+  void *mapped_ = nullptr;
+  size_t mapped_size_ = 0;
+  std::unique_ptr<ZstdInputStream> decompressed_;
+  std::unique_ptr<google::protobuf::io::ZeroCopyInputStream> stream_;
+};
+
+// A message allocated on an arena along with everything it holds, so that
+// parsing it costs a handful of large allocations instead of one per nested
+// message and string, and freeing it costs one per arena block.
+template <typename T>
+class ArenaMessage {
+ public:
+  ArenaMessage(std::unique_ptr<google::protobuf::Arena> arena, T *message)
+      : arena_(std::move(arena)), message_(message) {}
+
+  T &operator*() const { return *message_; }
+  T *operator->() const { return message_; }
+  T *get() const { return message_; }
+
+ private:
+  std::unique_ptr<google::protobuf::Arena> arena_;
+  T *message_;
+};
+
+// An arena with blocks sized for holding a whole parsed datpb or index.
+std::unique_ptr<google::protobuf::Arena> NewProtoFileArena();
+
+// Parses the binary proto at `path`, which may be compressed.
+rhutil::Status ReadProtoFile(std::string_view path,
+                             google::protobuf::Message *message);
+
+// Like ReadProtoFile, but parses into an arena. Nested messages and strings
+// only go on the arena if T's .proto enables arenas (cc_enable_arenas);
+// otherwise only T itself does.
+template <typename T>
+rhutil::StatusOr<ArenaMessage<T>> LoadProtoFile(std::string_view path) {
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoInputFile> in,
+                   ProtoInputFile::Open(path));
+  std::unique_ptr<google::protobuf::Arena> arena = NewProtoFileArena();
+  T *message;
+  if constexpr (google::protobuf::Arena::is_arena_constructable<T>::value) {
+    message = google::protobuf::Arena::CreateMessage<T>(arena.get());
+  } else {
+    message = google::protobuf::Arena::Create<T>(arena.get());
+  }
+  RETURN_IF_ERROR(in->Parse(message));
+  return ArenaMessage<T>(std::move(arena), message);
+}
+
+}  // namespace roman
+
+#endif  // ROMAN_PROTO_FILE_H_
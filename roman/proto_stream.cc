@@ -0,0 +1,94 @@
+#include "roman/proto_stream.h"
+
+#include <string>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/wire_format_lite.h"
+
+namespace roman {
+
+using ::google::protobuf::Message;
+using ::google::protobuf::TextFormat;
+using ::google::protobuf::internal::WireFormatLite;
+using ::google::protobuf::io::CodedInputStream;
+using ::google::protobuf::io::CodedOutputStream;
+using ::google::protobuf::io::StringOutputStream;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+std::uint32_t RecordTag(const google::protobuf::FieldDescriptor *field) {
+  return WireFormatLite::MakeTag(field->number(),
+                                 WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+}
+
+}  // namespace
+
+Status RepeatedFieldWriter::Write(const Message &element) {
+  std::string record;
+  if (binary_) {
+    StringOutputStream strm(&record);
+    CodedOutputStream coded(&strm);
+    coded.WriteTag(RecordTag(field_));
+    coded.WriteVarint32(static_cast<std::uint32_t>(element.ByteSizeLong()));
+    element.SerializeWithCachedSizes(&coded);
+    if (coded.HadError()) {
+      return UnknownErrorBuilder()
+          << "Failed to serialize " << element.GetTypeName();
+    }
+  } else {
+    TextFormat::Printer printer;
+    printer.SetInitialIndentLevel(1);
+    std::string text;
+    if (!printer.PrintToString(element, &text)) {
+      return UnknownErrorBuilder()
+          << "Failed to print " << element.GetTypeName() << " textproto";
+    }
+    record = field_->name() + " {\n" + text + "}\n";
+  }
+
+  out_->write(record.data(), record.size());
+  if (!*out_) {
+    return UnknownErrorBuilder()
+        << "Failed to write " << element.GetTypeName();
+  }
+  return OkStatus();
+}
+
+StatusOr<bool> RepeatedFieldReader::Read(Message *element) {
+  while (true) {
+    // A CodedInputStream hands back what it buffered but didn't consume when
+    // it is destroyed, so one per record reads the stream in order. It also
+    // keeps the per-stream byte limit from applying to the whole input.
+    CodedInputStream coded(stream_);
+    std::uint32_t tag = coded.ReadTag();
+    if (tag == 0) return false;
+    if (tag != RecordTag(field_)) {
+      if (!WireFormatLite::SkipField(&coded, tag)) {
+        return UnknownErrorBuilder() << "Failed to skip field with tag " << tag;
+      }
+      continue;
+    }
+
+    std::uint32_t length;
+    if (!coded.ReadVarint32(&length)) {
+      return UnknownErrorBuilder()
+          << "Truncated " << element->GetTypeName() << " record";
+    }
+    CodedInputStream::Limit limit = coded.PushLimit(length);
+    element->Clear();
+    if (!element->ParseFromCodedStream(&coded) ||
+        !coded.ConsumedEntireMessage()) {
+      return UnknownErrorBuilder()
+          << "Failed to parse " << element->GetTypeName() << " record";
+    }
+    coded.PopLimit(limit);
+    return true;
+  }
+}
+
+}  // namespace roman
@@ -0,0 +1,65 @@
+#ifndef ROMAN_PROTO_STREAM_H_
+#define ROMAN_PROTO_STREAM_H_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
+#include "rhutil/status.h"
+
+namespace roman {
+
+// Writes the elements of a repeated message field one at a time, so that the
+// message holding them never needs to be in memory at once.
+//
+// The output is exactly what PrintProto would print for a message holding
+// all the elements written, in either format: binary protobuf encodes each
+// element of a repeated field as its own tag and length prefixed record, and
+// text format prints each as its own "field { ... }" block. Readers of the
+// whole message keep working, and RepeatedFieldReader reads it back one
+// element at a time.
+class RepeatedFieldWriter {
+ public:
+  // `field` is the repeated message field whose elements are written.
+  RepeatedFieldWriter(std::ostream *out,
+                      const google::protobuf::FieldDescriptor *field,
+                      bool binary)
+      : out_(out), field_(field), binary_(binary) {}
+
+  rhutil::Status Write(const google::protobuf::Message &element);
+
+ private:
+  std::ostream *const out_;
+  const google::protobuf::FieldDescriptor *const field_;
+  const bool binary_;
+};
+
+// Reads the elements of a repeated message field from a binary message one at
+// a time. Other fields are skipped.
+class RepeatedFieldReader {
+ public:
+  RepeatedFieldReader(std::istream *in,
+                      const google::protobuf::FieldDescriptor *field)
+      : owned_stream_(
+            std::make_unique<google::protobuf::io::IstreamInputStream>(in)),
+        stream_(owned_stream_.get()), field_(field) {}
+  RepeatedFieldReader(google::protobuf::io::ZeroCopyInputStream *in,
+                      const google::protobuf::FieldDescriptor *field)
+      : stream_(in), field_(field) {}
+
+  // Reads the next element into `element`. Returns false at the end of the
+  // input.
+  rhutil::StatusOr<bool> Read(google::protobuf::Message *element);
+
+ private:
+  std::unique_ptr<google::protobuf::io::IstreamInputStream> owned_stream_;
+  google::protobuf::io::ZeroCopyInputStream *const stream_;
+  const google::protobuf::FieldDescriptor *const field_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_PROTO_STREAM_H_
@@ -0,0 +1,78 @@
+#include "roman/rclone/flags.h"
+
+#include "roman/common_flags.h"
+
+using ::rhutil::CurlURL;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::StatusOr;
+
+ABSL_FLAG(CurlURL, rclone_url, CurlURL::FromStringOrDie("http://url.invalid"),
+          "The URL used to connect to RClone. Authorization is required.");
+ABSL_FLAG(double, rclone_qps, 10,
+          "The initial rate of requests per second sent to RClone. The rate "
+          "adapts to how the remote responds.");
+ABSL_FLAG(double, rclone_max_qps, 100,
+          "The highest rate of requests per second sent to RClone.");
+ABSL_FLAG(int, rclone_concurrency, 4,
+          "The initial number of concurrent requests sent to RClone. The "
+          "limit adapts to how the remote responds.");
+ABSL_FLAG(int, rclone_max_concurrency, 32,
+          "The highest number of concurrent requests sent to RClone.");
+ABSL_FLAG(std::string, rclone_listing, "rc",
+          "How to list files. \"rc\" calls operations/list on the RClone "
+          "at --rclone_url. \"lsjson\" runs `rclone lsjson`, which needs no "
+          "running RClone and streams large listings in bounded memory.");
+ABSL_FLAG(std::string, rclone_binary, "rclone",
+          "The rclone binary run by --rclone_listing=lsjson.");
+ABSL_FLAG(std::vector<std::string>, rclone_args, {},
+          "Comma separated extra arguments for the rclone binary, e.g. "
+          "--rclone_args=--config,rclone.conf");
+
+namespace roman {
+
+RequestScheduler::Options RequestSchedulerOptionsFromFlags() {
+  RequestScheduler::Options opts;
+  opts.initial_rate = absl::GetFlag(FLAGS_rclone_qps);
+  opts.max_rate = absl::GetFlag(FLAGS_rclone_max_qps);
+  opts.initial_concurrency = absl::GetFlag(FLAGS_rclone_concurrency);
+  opts.max_concurrency = absl::GetFlag(FLAGS_rclone_max_concurrency);
+  opts.verbose = absl::GetFlag(FLAGS_verbose);
+  return opts;
+}
+
+RcClient::Options RcClientOptionsFromFlags(RequestScheduler *scheduler) {
+  RcClient::Options opts;
+  opts.url = absl::GetFlag(FLAGS_rclone_url);
+  opts.verbose = absl::GetFlag(FLAGS_verbose);
+  opts.scheduler = scheduler;
+  return opts;
+}
+
+StatusOr<RemoteHashReader::Options> RemoteHashReaderOptionsFromFlags(
+    RequestScheduler *scheduler) {
+  RemoteHashReader::Options opts;
+  std::string listing = absl::GetFlag(FLAGS_rclone_listing);
+  if (listing == "rc") {
+    opts.backend = RemoteHashReader::Backend::kRc;
+  } else if (listing == "lsjson") {
+    opts.backend = RemoteHashReader::Backend::kLsjson;
+  } else {
+    return InvalidArgumentErrorBuilder()
+        << "--rclone_listing must be rc or lsjson, not " << listing;
+  }
+  opts.rc = RcClientOptionsFromFlags(scheduler);
+  opts.rclone_binary = absl::GetFlag(FLAGS_rclone_binary);
+  opts.rclone_args = absl::GetFlag(FLAGS_rclone_args);
+  return opts;
+}
+
+RemoteFileReader::Options RemoteFileReaderOptionsFromFlags(
+    RequestScheduler *scheduler) {
+  RemoteFileReader::Options opts;
+  opts.url = absl::GetFlag(FLAGS_rclone_url);
+  opts.verbose = absl::GetFlag(FLAGS_verbose);
+  opts.scheduler = scheduler;
+  return opts;
+}
+
+}  // namespace roman
@@ -0,0 +1,43 @@
+#ifndef ROMAN_RCLONE_FLAGS_H_
+#define ROMAN_RCLONE_FLAGS_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "rhutil/status.h"
+#include "rhutil/curl/curl.h"
+#include "roman/rclone/rc_client.h"
+#include "roman/rclone/remote_file_reader.h"
+#include "roman/rclone/remote_hash_reader.h"
+#include "roman/rclone/request_scheduler.h"
+
+ABSL_DECLARE_FLAG(rhutil::CurlURL, rclone_url);
+ABSL_DECLARE_FLAG(double, rclone_qps);
+ABSL_DECLARE_FLAG(double, rclone_max_qps);
+ABSL_DECLARE_FLAG(int, rclone_concurrency);
+ABSL_DECLARE_FLAG(int, rclone_max_concurrency);
+ABSL_DECLARE_FLAG(std::string, rclone_listing);
+ABSL_DECLARE_FLAG(std::string, rclone_binary);
+ABSL_DECLARE_FLAG(std::vector<std::string>, rclone_args);
+
+namespace roman {
+
+RequestScheduler::Options RequestSchedulerOptionsFromFlags();
+
+// Options for an RcClient talking to the rclone given by --rclone_url, whose
+// calls are admitted through `scheduler`.
+RcClient::Options RcClientOptionsFromFlags(RequestScheduler *scheduler);
+
+// Options for listing files with the backend given by --rclone_listing.
+rhutil::StatusOr<RemoteHashReader::Options> RemoteHashReaderOptionsFromFlags(
+    RequestScheduler *scheduler);
+
+// Options for reading file contents from the rclone given by --rclone_url,
+// whose requests are admitted through `scheduler`.
+RemoteFileReader::Options RemoteFileReaderOptionsFromFlags(
+    RequestScheduler *scheduler);
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_FLAGS_H_
@@ -0,0 +1,80 @@
+#include "roman/rclone/folder_lister.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "roman/util/thread_pool.h"
+
+namespace roman {
+
+using ::rhutil::IsNotFound;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+
+Status FolderLister::Read(std::string_view path,
+                          absl::Span<const std::string> folders,
+                          const std::function<Status(RemoteFile)> &callback) {
+  std::string root(path);
+  if (!absl::EndsWith(root, "/")) root += "/";
+
+  absl::Mutex mu;
+  Status status = OkStatus();
+  auto serialized = [&](RemoteFile file) -> Status {
+    absl::MutexLock lock(&mu);
+    if (!status.ok()) return status;
+    status = callback(std::move(file));
+    return status;
+  };
+  // Lists `folder` on `pool`, and calls `done` with whether it exists.
+  auto schedule = [&](ThreadPool *pool, std::string folder, bool recurse,
+                      std::function<void(bool)> done) {
+    pool->Schedule([&, folder = std::move(folder), recurse,
+                    done = std::move(done)]() {
+      {
+        absl::MutexLock lock(&mu);
+        if (!status.ok()) return;
+      }
+      Status listed =
+          reader_->Read(absl::StrCat(root, folder), recurse, serialized);
+      absl::MutexLock lock(&mu);
+      if (IsNotFound(listed)) {
+        done(false);
+      } else if (listed.ok()) {
+        done(true);
+      } else if (status.ok()) {
+        status = listed;
+      }
+    });
+  };
+
+  int threads = std::max<int>(
+      1, std::min<std::size_t>(opts_.concurrency, folders.size()));
+  ThreadPool pool(threads);
+  for (const std::string &folder : folders) {
+    schedule(&pool, folder, /*recurse=*/true, [this](bool found) {
+      (found ? stats_.found : stats_.missing)++;
+    });
+  }
+  pool.Wait();
+  if (!status.ok()) return status;
+  if (stats_.missing == 0 || !opts_.fallback) return OkStatus();
+
+  absl::flat_hash_set<std::string_view> expected(folders.begin(),
+                                                 folders.end());
+  ASSIGN_OR_RETURN(std::vector<std::string> dirs, reader_->ListDirs(path));
+  RETURN_IF_ERROR(reader_->Read(path, /*recurse=*/false, serialized));
+  for (std::string &dir : dirs) {
+    if (expected.contains(dir)) continue;
+    stats_.walked++;
+    schedule(&pool, std::move(dir), /*recurse=*/true, [](bool) {});
+  }
+  pool.Wait();
+  return status;
+}
+
+}  // namespace roman
@@ -0,0 +1,60 @@
+#ifndef ROMAN_RCLONE_FOLDER_LISTER_H_
+#define ROMAN_RCLONE_FOLDER_LISTER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "absl/types/span.h"
+#include "rhutil/status.h"
+#include "roman/rclone/remote_hash_reader.h"
+
+namespace roman {
+
+// Lists a tree laid out as <path>/<folder>/... by looking up the folders
+// expected to hold files of interest (e.g. one per game in a dat) by name,
+// several at once, rather than walking the whole tree. The cost grows with the
+// number of expected folders instead of with the size of the tree.
+//
+// Files elsewhere are only found by the fallback: when some expected folder is
+// missing, perhaps because it was named differently, the files directly under
+// <path> are listed and the folders there which aren't expected are walked.
+class FolderLister {
+ public:
+  struct Options {
+    // How many folders to list at once.
+    int concurrency = 8;
+    bool fallback = true;
+  };
+
+  struct Stats {
+    // Expected folders which were, and weren't, found.
+    std::int64_t found = 0;
+    std::int64_t missing = 0;
+    // Unexpected folders walked by the fallback.
+    std::int64_t walked = 0;
+  };
+
+  // `reader` must outlive the FolderLister.
+  FolderLister(RemoteHashReader *reader, const Options &opts)
+      : reader_(reader), opts_(opts) {}
+
+  // Passes the files in `folders` under `path`, and those found by the
+  // fallback, to `callback`. Calls to `callback` are serialized; the first
+  // error it returns stops the listing.
+  rhutil::Status Read(std::string_view path,
+                      absl::Span<const std::string> folders,
+                      const std::function<rhutil::Status(RemoteFile)> &callback);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  RemoteHashReader *const reader_;
+  const Options opts_;
+  Stats stats_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_FOLDER_LISTER_H_
@@ -0,0 +1,124 @@
+#include "roman/rclone/hash_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "roman/util/dirs.h"
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+std::string *MutableEntryHash(Hash::Type type, CachedHashes::Entry *entry) {
+  switch (type) {
+    case Hash::MD5: return entry->mutable_md5();
+    case Hash::SHA1: return entry->mutable_sha1();
+    case Hash::CRC: return entry->mutable_crc();
+    default: return nullptr;
+  }
+}
+
+std::string_view EntryHash(Hash::Type type, const CachedHashes::Entry &entry) {
+  switch (type) {
+    case Hash::MD5: return entry.md5();
+    case Hash::SHA1: return entry.sha1();
+    case Hash::CRC: return entry.crc();
+    default: return {};
+  }
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<HashCache>> HashCache::Load(std::string_view path) {
+  std::unique_ptr<HashCache> cache(new HashCache(std::string(path)));
+  std::ifstream in(cache->path_, std::ios::binary);
+  if (!in) return cache;
+
+  CachedHashes stored;
+  if (!stored.ParseFromIstream(&in)) {
+    return UnknownErrorBuilder() << "Failed to read hash cache from " << path;
+  }
+  absl::MutexLock lock(&cache->mu_);
+  for (CachedHashes::Entry &entry : *stored.mutable_entry()) {
+    std::string key = entry.path();
+    cache->entries_[key] = std::move(entry);
+  }
+  return cache;
+}
+
+std::optional<Hash> HashCache::Lookup(std::string_view path,
+                                      std::int64_t size,
+                                      std::string_view mod_time,
+                                      Hash::Type type) const {
+  absl::MutexLock lock(&mu_);
+  auto it = entries_.find(path);
+  if (it == entries_.end()) return std::nullopt;
+  const CachedHashes::Entry &entry = it->second;
+  if (entry.size() != size || entry.mod_time() != mod_time) {
+    return std::nullopt;
+  }
+  std::string_view value = EntryHash(type, entry);
+  if (value.empty()) return std::nullopt;
+  return Hash(type, value);
+}
+
+void HashCache::Insert(std::string_view path, std::int64_t size,
+                       std::string_view mod_time, const Hash &hash) {
+  absl::MutexLock lock(&mu_);
+  CachedHashes::Entry &entry = entries_[path];
+  if (entry.size() != size || entry.mod_time() != mod_time) {
+    // The file changed, so every hash we had for it is stale.
+    entry.Clear();
+    entry.set_path(std::string(path));
+    entry.set_size(size);
+    entry.set_mod_time(std::string(mod_time));
+  }
+  std::string *value = MutableEntryHash(hash.GetType(), &entry);
+  if (value == nullptr) return;
+  *value = hash.GetValue();
+  generation_++;
+}
+
+Status HashCache::Save() {
+  CachedHashes stored;
+  std::int64_t generation;
+  {
+    absl::MutexLock lock(&mu_);
+    generation = generation_;
+    if (generation == saved_generation_) return OkStatus();
+    for (const auto &[path, entry] : entries_) *stored.add_entry() = entry;
+  }
+
+  // Write a sibling and rename it into place, so that an interrupted save
+  // never loses the previous cache.
+  RETURN_IF_ERROR(MakeParentDirs(path_));
+  std::string tmp = absl::StrCat(path_, ".tmp");
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out || !stored.SerializeToOstream(&out) || !out.flush()) {
+      return UnknownErrorBuilder() << "Failed to write hash cache to " << tmp;
+    }
+  }
+  if (std::rename(tmp.c_str(), path_.c_str()) == -1) {
+    return UnknownErrorBuilder() << "rename " << tmp << " to " << path_ << ": "
+                                 << std::strerror(errno);
+  }
+
+  absl::MutexLock lock(&mu_);
+  saved_generation_ = std::max(saved_generation_, generation);
+  return OkStatus();
+}
+
+std::string HashCache::DefaultPath() { return UserCachePath("hashes"); }
+
+}  // namespace roman
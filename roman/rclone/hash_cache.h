@@ -0,0 +1,55 @@
+#ifndef ROMAN_RCLONE_HASH_CACHE_H_
+#define ROMAN_RCLONE_HASH_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "rhutil/status.h"
+#include "roman/hash.h"
+#include "roman/rclone/hash_cache.pb.h"
+
+namespace roman {
+
+// A persistent, thread-safe record of hashes computed by downloading remote
+// files. Entries are keyed by path, and are only used while the file's size
+// and modification time are unchanged.
+class HashCache {
+ public:
+  // Loads the cache stored at `path`. A missing file is an empty cache.
+  static rhutil::StatusOr<std::unique_ptr<HashCache>> Load(
+      std::string_view path);
+
+  HashCache(const HashCache &) = delete;
+  HashCache &operator=(const HashCache &) = delete;
+
+  std::optional<Hash> Lookup(std::string_view path, std::int64_t size,
+                             std::string_view mod_time, Hash::Type type) const;
+  void Insert(std::string_view path, std::int64_t size,
+              std::string_view mod_time, const Hash &hash);
+
+  // Writes the cache back to where it was loaded from, if it has changed.
+  rhutil::Status Save();
+
+  // The default location, under $XDG_CACHE_HOME.
+  static std::string DefaultPath();
+
+ private:
+  explicit HashCache(std::string path) : path_(std::move(path)) {}
+
+  const std::string path_;
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<std::string, CachedHashes::Entry> entries_ GUARDED_BY(mu_);
+  // Incremented by every Insert, so that Save can tell whether there is
+  // anything new to write.
+  std::int64_t generation_ GUARDED_BY(mu_) = 0;
+  std::int64_t saved_generation_ GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_HASH_CACHE_H_
@@ -0,0 +1,87 @@
+#include "roman/rclone/listing_filter.h"
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+
+namespace roman {
+
+using json = ::nlohmann::json;
+
+namespace {
+
+// A glob matching any one of `literals`.
+std::string GlobAlternation(const std::vector<std::string> &literals) {
+  if (literals.size() == 1) return GlobEscape(literals.front());
+  return absl::StrCat(
+      "{",
+      absl::StrJoin(literals, ",",
+                    [](std::string *out, const std::string &literal) {
+                      out->append(GlobEscape(literal));
+                    }),
+      "}");
+}
+
+}  // namespace
+
+std::string GlobEscape(std::string_view literal) {
+  std::string escaped;
+  for (char c : literal) {
+    if (std::string_view("*?[]{},\\").find(c) != std::string_view::npos) {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+bool ListingFilter::empty() const {
+  return extensions.empty() && name_prefixes.empty() && min_size < 0 &&
+         max_size < 0;
+}
+
+std::vector<std::string> ListingFilter::IncludeRules() const {
+  if (extensions.empty() && name_prefixes.empty()) return {};
+  // A rule without a leading slash matches file names in any directory, and
+  // '*' doesn't cross directories.
+  std::string rule;
+  if (!name_prefixes.empty()) rule = GlobAlternation(name_prefixes);
+  rule += "*";
+  if (!extensions.empty()) {
+    absl::StrAppend(&rule, ".", GlobAlternation(extensions));
+  }
+  return {rule};
+}
+
+json ListingFilter::ToRc() const {
+  json filter = json::object();
+  std::vector<std::string> rules = IncludeRules();
+  if (!rules.empty()) {
+    filter["IncludeRule"] = rules;
+    filter["IgnoreCase"] = true;
+  }
+  if (min_size >= 0) filter["MinSize"] = min_size;
+  if (max_size >= 0) filter["MaxSize"] = max_size;
+  return filter;
+}
+
+std::vector<std::string> ListingFilter::ToArgs() const {
+  std::vector<std::string> args;
+  std::vector<std::string> rules = IncludeRules();
+  if (!rules.empty()) args.push_back("--ignore-case");
+  for (std::string &rule : rules) {
+    args.push_back("--include");
+    args.push_back(std::move(rule));
+  }
+  // Without a suffix, rclone reads sizes as KiB.
+  if (min_size >= 0) {
+    args.push_back("--min-size");
+    args.push_back(absl::StrCat(min_size, "B"));
+  }
+  if (max_size >= 0) {
+    args.push_back("--max-size");
+    args.push_back(absl::StrCat(max_size, "B"));
+  }
+  return args;
+}
+
+}  // namespace roman
@@ -0,0 +1,40 @@
+#ifndef ROMAN_RCLONE_LISTING_FILTER_H_
+#define ROMAN_RCLONE_LISTING_FILTER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace roman {
+
+// Escapes the characters rclone's filter rules treat as glob syntax.
+std::string GlobEscape(std::string_view literal);
+
+// Restricts an rclone listing to the files which could be of interest, so
+// that rclone doesn't list, hash or send the rest. Matching ignores case.
+struct ListingFilter {
+  // File name extensions, without the dot (e.g. "bin"). Empty means any.
+  std::vector<std::string> extensions;
+  // File name prefixes (e.g. "Game (USA)"). Empty means any.
+  std::vector<std::string> name_prefixes;
+  // Negative means unbounded.
+  std::int64_t min_size = -1;
+  std::int64_t max_size = -1;
+
+  bool empty() const;
+
+  // The rclone include rules implementing the filter.
+  std::vector<std::string> IncludeRules() const;
+
+  // The filter as the _filter parameter of an rc call.
+  nlohmann::json ToRc() const;
+  // The filter as rclone command line flags.
+  std::vector<std::string> ToArgs() const;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_LISTING_FILTER_H_
@@ -0,0 +1,190 @@
+#include "roman/rclone/rc_client.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+
+namespace roman {
+namespace {
+
+using ::rhutil::CurlEasyInit;
+using ::rhutil::CurlEasyPerform;
+using ::rhutil::CurlEasySetWriteCallback;
+using ::rhutil::CurlEasySetopt;
+using ::rhutil::CurlHandleDeleter;
+using ::rhutil::CurlURL;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::NotFoundErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+using json = ::nlohmann::json;
+
+class CurlSlistDeleter {
+ public:
+  void operator()(curl_slist *list) {
+    curl_slist_free_all(list);
+  }
+};
+
+// rclone passes backend errors through as HTTP 500s, so rate limiting also has
+// to be recognized from the message. These are the forms used by Google Drive
+// and by backends which surface the HTTP status.
+bool IsThrottled(long code, std::string_view message) {
+  if (code == 403 || code == 429) return true;
+  for (std::string_view needle :
+       {"rateLimitExceeded", "RateLimitExceeded", "Too Many Requests",
+        "Error 429", "Error 403: Rate Limit"}) {
+    if (absl::StrContains(message, needle)) return true;
+  }
+  return false;
+}
+
+// rclone reports failures as {"error": "...", "status": <http code>, ...}.
+Status ErrorFromResponse(std::string_view method, long code,
+                         const json &response) {
+  std::string message = response.is_object()
+      ? response.value("error", std::string())
+      : std::string();
+  if (message.empty()) message = absl::StrCat("HTTP status ", code);
+  switch (code) {
+    case 400:
+      return InvalidArgumentErrorBuilder()
+          << "rclone " << method << " failed: " << message;
+    case 404:
+      return NotFoundErrorBuilder()
+          << "rclone " << method << " failed: " << message;
+    default:
+      return UnknownErrorBuilder()
+          << "rclone " << method << " failed: " << message;
+  }
+}
+
+}  // namespace
+
+StatusOr<json> RcClient::Call(std::string_view method,
+                              const json &params) const {
+  return Schedule(/*report_latency=*/true, [&](bool *throttled) {
+    return Perform(method, params, throttled);
+  });
+}
+
+StatusOr<json> RcClient::CallAsync(std::string_view method,
+                                   const json &params) const {
+  // The job occupies the remote for its whole duration, so it holds its
+  // scheduler slot until it finishes. How long it takes depends on the size of
+  // the job rather than on congestion though, so its latency is not reported.
+  return Schedule(/*report_latency=*/false, [&](bool *throttled) {
+    return PerformAsync(method, params, throttled);
+  });
+}
+
+StatusOr<json> RcClient::Schedule(
+    bool report_latency,
+    const std::function<StatusOr<json>(bool *)> &attempt) const {
+  for (int i = 1;; i++) {
+    if (opts_.scheduler) opts_.scheduler->Acquire();
+    absl::Time start = absl::Now();
+    bool throttled = false;
+    StatusOr<json> result = attempt(&throttled);
+    if (opts_.scheduler) {
+      using Outcome = RequestScheduler::Outcome;
+      opts_.scheduler->Release(
+          result.ok() ? Outcome::kSuccess
+                      : throttled ? Outcome::kThrottled : Outcome::kError,
+          report_latency ? absl::Now() - start : absl::ZeroDuration());
+    }
+    if (!throttled || i >= opts_.max_attempts) return result;
+  }
+}
+
+StatusOr<json> RcClient::Perform(std::string_view method, const json &params,
+                                 bool *throttled) const {
+  std::unique_ptr<CURL, CurlHandleDeleter> curl = CurlEasyInit();
+  if (opts_.verbose) {
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_VERBOSE, true));
+  }
+
+  CurlURL url = opts_.url;
+  url.SetPath(absl::StrCat("/", method));
+  RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_CURLU, url.GetCURLU()));
+
+  std::string body = params.dump();
+  std::unique_ptr<curl_slist, CurlSlistDeleter> headers(
+      curl_slist_append(nullptr, "Content-Type: application/json"));
+  RETURN_IF_ERROR(
+      CurlEasySetopt(curl.get(), CURLOPT_HTTPHEADER, headers.get()));
+  RETURN_IF_ERROR(
+      CurlEasySetopt(curl.get(), CURLOPT_POSTFIELDSIZE,
+                     static_cast<long>(body.size())));
+  RETURN_IF_ERROR(
+      CurlEasySetopt(curl.get(), CURLOPT_POSTFIELDS, body.c_str()));
+
+  std::string response;
+  RETURN_IF_ERROR(CurlEasySetWriteCallback(
+        curl.get(),
+        [&response](std::string_view data, size_t*) -> Status {
+          response.append(data);
+          return OkStatus();
+        }));
+  RETURN_IF_ERROR(CurlEasyPerform(curl.get()));
+
+  long code = 0;
+  curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &code);
+  json output = json::parse(response, /*cb=*/nullptr,
+                            /*allow_exceptions=*/false);
+  if (code != 200) {
+    Status err = ErrorFromResponse(method, code, output);
+    *throttled = IsThrottled(code, response);
+    return err;
+  }
+  if (output.is_discarded()) {
+    return UnknownErrorBuilder()
+        << "rclone " << method << " returned invalid JSON: " << response;
+  }
+  return output;
+}
+
+StatusOr<json> RcClient::PerformAsync(std::string_view method,
+                                      const json &params,
+                                      bool *throttled) const {
+  json async_params = params;
+  async_params["_async"] = true;
+  ASSIGN_OR_RETURN(json job, Perform(method, async_params, throttled));
+  if (!job.contains("jobid")) {
+    return UnknownErrorBuilder()
+        << "rclone " << method << " did not start a job: " << job.dump();
+  }
+
+  json status_params = {{"jobid", job["jobid"]}};
+  absl::Duration wait = absl::Milliseconds(10);
+  while (true) {
+    ASSIGN_OR_RETURN(json status,
+                     Perform("job/status", status_params, throttled));
+    if (!status.value("finished", false)) {
+      absl::SleepFor(wait);
+      wait = std::min(wait * 2, opts_.poll_interval);
+      continue;
+    }
+    if (!status.value("success", false)) {
+      std::string error = status.value("error", std::string());
+      *throttled = IsThrottled(/*code=*/0, error);
+      // Synchronous calls report this as a 404, jobs only by message.
+      if (absl::StrContains(error, "directory not found")) {
+        return NotFoundErrorBuilder()
+            << "rclone " << method << " failed: " << error;
+      }
+      return UnknownErrorBuilder()
+          << "rclone " << method << " failed: " << error;
+    }
+    return std::move(status["output"]);
+  }
+}
+
+}  // namespace roman
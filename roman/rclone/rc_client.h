@@ -0,0 +1,74 @@
+#ifndef ROMAN_RCLONE_RC_CLIENT_H_
+#define ROMAN_RCLONE_RC_CLIENT_H_
+
+#include <functional>
+#include <string_view>
+
+#include "absl/time/time.h"
+#include "nlohmann/json.hpp"
+#include "rhutil/curl/curl.h"
+#include "rhutil/status.h"
+#include "roman/rclone/request_scheduler.h"
+
+namespace roman {
+
+// A client for the rclone remote control API. See https://rclone.org/rc/.
+//
+// Every call uses its own curl handle, so an RcClient may be shared between
+// threads.
+class RcClient {
+ public:
+  struct Options {
+    // Where to reach rclone, including the credentials used for
+    // authenticated calls.
+    rhutil::CurlURL url;
+    bool verbose = false;
+    // The longest wait between polls of job/status while waiting for an async
+    // call. Polling starts faster, so that short jobs return promptly.
+    absl::Duration poll_interval = absl::Milliseconds(100);
+
+    // If set, every call is admitted through this scheduler, which is
+    // typically shared by all clients talking to the same remote. Not owned.
+    RequestScheduler *scheduler = nullptr;
+    // How many times to try a call which the remote throttles.
+    int max_attempts = 5;
+  };
+
+  RcClient() = default;
+  explicit RcClient(const Options &opts) : opts_(opts) {}
+
+  // Calls the rc method (e.g. "operations/list") and returns its output.
+  // Errors reported by rclone are mapped onto a Status carrying rclone's
+  // error message. Calls the remote throttles are retried.
+  rhutil::StatusOr<nlohmann::json> Call(std::string_view method,
+                                        const nlohmann::json &params) const;
+
+  // Like Call, but runs the method as an rclone job and polls job/status until
+  // it finishes. Long running calls should use this, as rclone holds the HTTP
+  // connection open for the duration of a synchronous call.
+  rhutil::StatusOr<nlohmann::json> CallAsync(
+      std::string_view method, const nlohmann::json &params) const;
+
+ private:
+  // Makes a single attempt at an rc call, without scheduling. Sets *throttled
+  // if the failure was the remote asking us to slow down.
+  rhutil::StatusOr<nlohmann::json> Perform(std::string_view method,
+                                           const nlohmann::json &params,
+                                           bool *throttled) const;
+  rhutil::StatusOr<nlohmann::json> PerformAsync(std::string_view method,
+                                                const nlohmann::json &params,
+                                                bool *throttled) const;
+
+  // Runs `attempt` through the scheduler until it succeeds, fails for a reason
+  // other than throttling, or runs out of attempts.
+  rhutil::StatusOr<nlohmann::json> Schedule(
+      bool report_latency,
+      const std::function<rhutil::StatusOr<nlohmann::json>(bool *)> &attempt)
+      const;
+
+  Options opts_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_RC_CLIENT_H_
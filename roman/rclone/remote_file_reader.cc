@@ -0,0 +1,137 @@
+#include "roman/rclone/remote_file_reader.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+
+namespace roman {
+namespace {
+
+using ::rhutil::CurlEasyInit;
+using ::rhutil::CurlEasyPerform;
+using ::rhutil::CurlEasySetWriteCallback;
+using ::rhutil::CurlEasySetopt;
+using ::rhutil::CurlHandleDeleter;
+using ::rhutil::CurlURL;
+using ::rhutil::NotFoundErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+std::string PercentEncodePath(std::string_view path) {
+  std::string out;
+  for (char c : path) {
+    if (absl::ascii_isalnum(c) || c == '-' || c == '.' || c == '_' ||
+        c == '~' || c == '/') {
+      out.push_back(c);
+    } else {
+      absl::StrAppendFormat(&out, "%%%02X", static_cast<unsigned char>(c));
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+Status RemoteFileReader::Read(
+    std::string_view fs, std::string_view path,
+    const std::function<Status(std::string chunk)> &callback) const {
+  for (std::int64_t offset = 0;;) {
+    ASSIGN_OR_RETURN(std::string chunk,
+                     ReadRange(fs, path, offset, opts_.chunk_size));
+    bool eof = static_cast<std::int64_t>(chunk.size()) < opts_.chunk_size;
+    offset += chunk.size();
+    if (!chunk.empty()) RETURN_IF_ERROR(callback(std::move(chunk)));
+    if (eof) return OkStatus();
+  }
+}
+
+StatusOr<std::string> RemoteFileReader::ReadRange(std::string_view fs,
+                                                  std::string_view path,
+                                                  std::int64_t offset,
+                                                  std::int64_t length) const {
+  for (int i = 1;; i++) {
+    if (opts_.scheduler) opts_.scheduler->Acquire();
+    bool throttled = false;
+    StatusOr<std::string> chunk =
+        ReadRangeOnce(fs, path, offset, length, &throttled);
+    if (opts_.scheduler) {
+      // How long a chunk takes depends on its size and the bandwidth rather
+      // than on congestion, so its latency is not reported.
+      using Outcome = RequestScheduler::Outcome;
+      opts_.scheduler->Release(
+          chunk.ok() ? Outcome::kSuccess
+                     : throttled ? Outcome::kThrottled : Outcome::kError,
+          absl::ZeroDuration());
+    }
+    if (chunk.ok()) {
+      // Only what was read, which is less than `length` at the end of the
+      // file.
+      if (opts_.bandwidth != nullptr) {
+        opts_.bandwidth->Take(chunk.ValueOrDie().size());
+      }
+      return chunk;
+    }
+    if (rhutil::IsNotFound(chunk.status()) || i >= opts_.max_attempts) {
+      return chunk;
+    }
+  }
+}
+
+StatusOr<std::string> RemoteFileReader::ReadRangeOnce(
+    std::string_view fs, std::string_view path, std::int64_t offset,
+    std::int64_t length, bool *throttled) const {
+  std::unique_ptr<CURL, CurlHandleDeleter> curl = CurlEasyInit();
+  if (opts_.verbose) {
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_VERBOSE, true));
+  }
+
+  CurlURL url = opts_.url;
+  url.SetPath(absl::StrCat("/", PercentEncodePath(absl::StrCat("[", fs, "]")),
+                           "/", PercentEncodePath(path)));
+  RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_CURLU, url.GetCURLU()));
+  std::string range = absl::StrCat(offset, "-", offset + length - 1);
+  RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_RANGE, range.c_str()));
+
+  std::string data;
+  RETURN_IF_ERROR(CurlEasySetWriteCallback(
+        curl.get(),
+        [&data](std::string_view chunk, size_t*) -> Status {
+          data.append(chunk);
+          return OkStatus();
+        }));
+  RETURN_IF_ERROR(CurlEasyPerform(curl.get()));
+
+  long code = 0;
+  curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &code);
+  switch (code) {
+    case 206:
+      return data;
+    case 200:
+      // The server ignored the range and sent the whole file.
+      if (offset >= static_cast<std::int64_t>(data.size())) return "";
+      return data.substr(offset, length);
+    case 416:
+      // Reading at or past the end of the file.
+      return "";
+    case 404:
+      return NotFoundErrorBuilder() << "rclone has no file " << fs << path;
+    case 403:
+    case 429:
+      *throttled = true;
+      return UnknownErrorBuilder()
+          << "rclone read of " << fs << path << " at " << offset
+          << " was throttled with HTTP status " << code << ": " << data;
+    default:
+      return UnknownErrorBuilder()
+          << "rclone read of " << fs << path << " at " << offset
+          << " failed with HTTP status " << code << ": " << data;
+  }
+}
+
+}  // namespace roman
@@ -0,0 +1,68 @@
+#ifndef ROMAN_RCLONE_REMOTE_FILE_READER_H_
+#define ROMAN_RCLONE_REMOTE_FILE_READER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "rhutil/curl/curl.h"
+#include "rhutil/status.h"
+#include "roman/rclone/request_scheduler.h"
+#include "roman/rclone/token_bucket.h"
+
+namespace roman {
+
+// Streams the contents of remote files through rclone's rc file server, which
+// `rclone rcd` provides when started with --rc-serve. Files are read with
+// ranged requests of Options::chunk_size bytes, so that a failed request only
+// costs one chunk.
+class RemoteFileReader {
+ public:
+  struct Options {
+    rhutil::CurlURL url;
+    bool verbose = false;
+    std::int64_t chunk_size = std::int64_t{8} << 20;
+    // How many times to try each chunk.
+    int max_attempts = 3;
+    // If set, every chunk request is admitted through this scheduler, which is
+    // typically shared by all clients talking to the same remote. Not owned.
+    RequestScheduler *scheduler = nullptr;
+    // If set, one token is taken per byte of each chunk read, which limits
+    // bandwidth to the bucket's rate. Typically shared by every reader. Not
+    // owned.
+    TokenBucket *bandwidth = nullptr;
+  };
+
+  RemoteFileReader() = default;
+  explicit RemoteFileReader(const Options &opts) : opts_(opts) {}
+
+  // Reads the file at `path` relative to `fs` (e.g. "gdrive:"), calling
+  // `callback` with successive chunks of its contents until the end of the
+  // file or the first error.
+  rhutil::Status Read(
+      std::string_view fs, std::string_view path,
+      const std::function<rhutil::Status(std::string chunk)> &callback) const;
+
+  // Reads up to `length` bytes at `offset`. Returns fewer bytes only at the
+  // end of the file.
+  rhutil::StatusOr<std::string> ReadRange(std::string_view fs,
+                                          std::string_view path,
+                                          std::int64_t offset,
+                                          std::int64_t length) const;
+
+ private:
+  // Makes a single attempt at reading a range, without scheduling. Sets
+  // *throttled if the failure was the remote asking us to slow down.
+  rhutil::StatusOr<std::string> ReadRangeOnce(std::string_view fs,
+                                              std::string_view path,
+                                              std::int64_t offset,
+                                              std::int64_t length,
+                                              bool *throttled) const;
+
+  Options opts_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_REMOTE_FILE_READER_H_
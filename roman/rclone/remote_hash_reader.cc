@@ -0,0 +1,286 @@
+#include "roman/rclone/remote_hash_reader.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace roman {
+
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::NotFoundErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+using json = ::nlohmann::json;
+
+StatusOr<std::pair<std::string, std::string>> SplitRemotePath(
+    std::string_view path) {
+  std::pair<std::string, std::string> p =
+      absl::StrSplit(path, absl::MaxSplits(':', 1));
+  auto &[fs, remote] = p;
+  if (fs.empty() || remote.empty()) {
+    return InvalidArgumentErrorBuilder() << "Invalid remote " << path;
+  }
+  fs += ":";
+  return p;
+}
+
+Hash::Type HashTypeFromRClone(std::string_view name) {
+  // Older versions of rclone name hashes "MD5", "SHA-1" and "CRC-32", newer
+  // ones "md5", "sha1" and "crc32".
+  std::string normalized =
+      absl::StrReplaceAll(absl::AsciiStrToLower(name), {{"-", ""}});
+  if (normalized == "md5") return Hash::MD5;
+  if (normalized == "sha1") return Hash::SHA1;
+  if (normalized == "crc32") return Hash::CRC;
+  return Hash::UNKNOWN;
+}
+
+std::string HashTypeToRClone(Hash::Type type) {
+  switch (type) {
+    case Hash::MD5: return "md5";
+    case Hash::SHA1: return "sha1";
+    case Hash::CRC: return "crc32";
+    default: return "none";
+  }
+}
+
+StatusOr<std::vector<std::string>> RemoteHashReader::SupportedHashes(
+    std::string_view fs) {
+  json info;
+  switch (opts_.backend) {
+    case Backend::kRc: {
+      ASSIGN_OR_RETURN(info, rc_.Call("operations/fsinfo", {{"fs", fs}}));
+      break;
+    }
+    case Backend::kLsjson: {
+      ASSIGN_OR_RETURN(std::unique_ptr<Subprocess> proc,
+                       Subprocess::Start(
+                           RCloneCommand({"backend", "features", fs})));
+      ASSIGN_OR_RETURN(std::string output, proc->ReadAll());
+      RETURN_IF_ERROR(proc->Wait());
+      info = json::parse(output, /*cb=*/nullptr, /*allow_exceptions=*/false);
+      if (info.is_discarded()) {
+        return UnknownErrorBuilder()
+            << "rclone backend features returned invalid JSON: " << output;
+      }
+      break;
+    }
+  }
+
+  std::vector<std::string> supported;
+  for (const json &name : info.value("Hashes", json::array())) {
+    supported.emplace_back(name.get<std::string>());
+  }
+  return supported;
+}
+
+StatusOr<Hash::Type> RemoteHashReader::NegotiateHashType(
+    std::string_view path, absl::Span<const Hash::Type> preferred) {
+  ASSIGN_OR_RETURN(auto fs_remote, SplitRemotePath(path));
+  hash_type_ = Hash::UNKNOWN;
+  hash_name_.clear();
+  ASSIGN_OR_RETURN(std::vector<std::string> supported,
+                   SupportedHashes(fs_remote.first));
+
+  for (Hash::Type type : preferred) {
+    auto it = absl::c_find_if(supported, [type](const std::string &name) {
+      return HashTypeFromRClone(name) == type;
+    });
+    if (it == supported.end()) continue;
+    hash_type_ = type;
+    hash_name_ = *it;
+    return type;
+  }
+
+  std::vector<std::string> wanted;
+  for (Hash::Type type : preferred) wanted.push_back(Hash::TypeToString(type));
+  return InvalidArgumentErrorBuilder()
+      << fs_remote.first << " supports hashes ["
+      << absl::StrJoin(supported, ", ") << "], none of which are usable. "
+      << "Usable hashes are [" << absl::StrJoin(wanted, ", ") << "]";
+}
+
+Status RemoteHashReader::Read(std::string_view path,
+                              std::function<Status(RemoteFile)> callback) {
+  return Read(path, opts_.recurse, std::move(callback));
+}
+
+Status RemoteHashReader::Read(std::string_view path, bool recurse,
+                              std::function<Status(RemoteFile)> callback) {
+  ASSIGN_OR_RETURN(auto fs_remote, SplitRemotePath(path));
+  const auto &[fs, remote] = fs_remote;
+  switch (opts_.backend) {
+    case Backend::kRc:
+      return ReadRc(fs, remote, recurse, callback);
+    case Backend::kLsjson:
+      return ReadLsjson(fs, remote, recurse, callback);
+  }
+  return OkStatus();
+}
+
+StatusOr<std::vector<std::string>> RemoteHashReader::ListDirs(
+    std::string_view path) {
+  ASSIGN_OR_RETURN(auto fs_remote, SplitRemotePath(path));
+  const auto &[fs, remote] = fs_remote;
+  std::vector<std::string> dirs;
+  switch (opts_.backend) {
+    case Backend::kRc: {
+      ASSIGN_OR_RETURN(json output, rc_.Call("operations/list", {
+            {"fs", fs},
+            {"remote", remote},
+            {"opt", {{"dirsOnly", true}, {"noModTime", true}}},
+          }));
+      for (const json &entry : output.value("list", json::array())) {
+        dirs.push_back(entry.value("Name", std::string()));
+      }
+      break;
+    }
+    case Backend::kLsjson: {
+      ASSIGN_OR_RETURN(std::unique_ptr<Subprocess> proc,
+                       Subprocess::Start(RCloneCommand(
+                           {"lsjson", "--dirs-only", "--no-mimetype",
+                            "--no-modtime", absl::StrCat(fs, remote)})));
+      ASSIGN_OR_RETURN(std::string output, proc->ReadAll());
+      RETURN_IF_ERROR(WaitRClone(proc.get(), path));
+      json list = json::parse(output, /*cb=*/nullptr,
+                              /*allow_exceptions=*/false);
+      if (list.is_discarded() || !list.is_array()) {
+        return UnknownErrorBuilder()
+            << "rclone lsjson printed invalid JSON: " << output;
+      }
+      for (const json &entry : list) {
+        dirs.push_back(entry.value("Name", std::string()));
+      }
+      break;
+    }
+  }
+  return dirs;
+}
+
+Status RemoteHashReader::ReadRc(
+    std::string_view fs, std::string_view remote, bool recurse,
+    const std::function<Status(RemoteFile)> &callback) {
+  json opt = {
+    {"showHash", hash_type_ != Hash::UNKNOWN},
+    {"recurse", recurse},
+    {"filesOnly", true},
+    {"noModTime", !opts_.mod_time},
+  };
+  if (!hash_name_.empty()) opt["hashTypes"] = {hash_name_};
+
+  json params = {
+    {"fs", fs},
+    {"remote", remote},
+    {"opt", std::move(opt)},
+  };
+  if (!opts_.filter.empty()) params["_filter"] = opts_.filter.ToRc();
+  ASSIGN_OR_RETURN(json output,
+                   rc_.CallAsync("operations/list", std::move(params)));
+  if (!output.contains("list")) {
+    return UnknownErrorBuilder()
+        << "rclone operations/list returned no list: " << output.dump();
+  }
+
+  // operations/list paths are already relative to the root of the fs.
+  for (const json &entry : output["list"]) {
+    RETURN_IF_ERROR(callback(ParseEntry(/*dir=*/"", entry)));
+  }
+  return OkStatus();
+}
+
+Status RemoteHashReader::ReadLsjson(
+    std::string_view fs, std::string_view remote, bool recurse,
+    const std::function<Status(RemoteFile)> &callback) {
+  std::vector<std::string> command = RCloneCommand(
+      {"lsjson", "--files-only", "--no-mimetype"});
+  if (!opts_.mod_time) command.push_back("--no-modtime");
+  if (recurse) command.push_back("--recursive");
+  if (hash_type_ != Hash::UNKNOWN) {
+    command.push_back("--hash");
+    command.push_back("--hash-type");
+    command.push_back(hash_name_.empty() ? "md5" : hash_name_);
+  }
+  for (std::string &arg : opts_.filter.ToArgs()) {
+    command.push_back(std::move(arg));
+  }
+  command.push_back(absl::StrCat(fs, remote));
+  ASSIGN_OR_RETURN(std::unique_ptr<Subprocess> proc,
+                   Subprocess::Start(command));
+
+  // lsjson paths are relative to the directory listed.
+  std::string dir(absl::StripPrefix(remote, "/"));
+  if (!dir.empty() && !absl::EndsWith(dir, "/")) dir += "/";
+
+  // The output is a JSON array with one entry per line:
+  //   [
+  //   {"Path":"a","Name":"a",...},
+  //   {"Path":"b","Name":"b",...}
+  //   ]
+  std::string line;
+  while (true) {
+    ASSIGN_OR_RETURN(bool more, proc->ReadLine(&line));
+    if (!more) break;
+    std::string_view entry_text = absl::StripAsciiWhitespace(line);
+    absl::ConsumeSuffix(&entry_text, ",");
+    if (entry_text.empty() || entry_text == "[" || entry_text == "]") {
+      continue;
+    }
+    json entry = json::parse(entry_text, /*cb=*/nullptr,
+                             /*allow_exceptions=*/false);
+    if (entry.is_discarded()) {
+      return UnknownErrorBuilder()
+          << "rclone lsjson printed invalid JSON: " << line;
+    }
+    // On error, the Subprocess is killed as it goes out of scope.
+    RETURN_IF_ERROR(callback(ParseEntry(dir, entry)));
+  }
+  return WaitRClone(proc.get(), absl::StrCat(fs, remote));
+}
+
+Status RemoteHashReader::WaitRClone(Subprocess *proc, std::string_view path) {
+  Status status = proc->Wait();
+  // See https://rclone.org/docs/#exit-code.
+  constexpr int kExitDirNotFound = 3;
+  if (!status.ok() && proc->exit_status() == kExitDirNotFound) {
+    return NotFoundErrorBuilder() << "Directory " << path << " not found";
+  }
+  return status;
+}
+
+RemoteFile RemoteHashReader::ParseEntry(std::string_view dir,
+                                        const json &entry) const {
+  RemoteFile file;
+  file.path = absl::StrCat(dir, entry.value("Path", std::string()));
+  file.size = entry.value("Size", std::int64_t{-1});
+  file.mod_time = entry.value("ModTime", std::string());
+  if (hash_type_ == Hash::UNKNOWN) return file;
+  for (const auto &[name, value] :
+       entry.value("Hashes", json::object()).items()) {
+    if (HashTypeFromRClone(name) != hash_type_) continue;
+    auto hval = value.get<std::string>();
+    if (!hval.empty()) file.hash.emplace(hash_type_, hval);
+  }
+  return file;
+}
+
+std::vector<std::string> RemoteHashReader::RCloneCommand(
+    std::initializer_list<std::string_view> args) const {
+  std::vector<std::string> command = {opts_.rclone_binary};
+  command.insert(command.end(), opts_.rclone_args.begin(),
+                 opts_.rclone_args.end());
+  for (std::string_view arg : args) command.emplace_back(arg);
+  return command;
+}
+
+}  // namespace roman
@@ -0,0 +1,136 @@
+#ifndef ROMAN_RCLONE_REMOTE_HASH_READER_H_
+#define ROMAN_RCLONE_REMOTE_HASH_READER_H_
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "nlohmann/json.hpp"
+#include "rhutil/status.h"
+#include "roman/hash.h"
+#include "roman/rclone/listing_filter.h"
+#include "roman/rclone/rc_client.h"
+#include "roman/util/subprocess.h"
+
+namespace roman {
+
+// Splits an rclone path specifier such as "gdrive:/Games" into its fs
+// ("gdrive:") and the path within it ("/Games").
+rhutil::StatusOr<std::pair<std::string, std::string>> SplitRemotePath(
+    std::string_view path);
+
+// Maps an rclone hash name (e.g. "MD5", "SHA-1" or "sha1") onto a Hash::Type.
+// Returns Hash::UNKNOWN for hashes roman does not understand.
+Hash::Type HashTypeFromRClone(std::string_view name);
+
+// The name rclone gives a Hash::Type, e.g. "md5".
+std::string HashTypeToRClone(Hash::Type type);
+
+struct RemoteFile {
+  // Relative to the root of the fs.
+  std::string path;
+  std::int64_t size = -1;
+  // Only set if requested with RemoteHashReader::Options::mod_time.
+  std::string mod_time;
+  // Absent when the remote has no hash of the selected type for this file.
+  std::optional<Hash> hash;
+};
+
+// Lists files on an rclone remote along with their hashes.
+//
+// There are two backends. kRc calls operations/list on a running `rclone rcd`,
+// which answers each call with a single JSON document holding the whole
+// listing. kLsjson runs `rclone lsjson` instead, which needs no rcd and prints
+// an entry per line as it walks the tree; entries are parsed and passed on as
+// they arrive, so memory use doesn't grow with the size of the tree.
+//
+// Once the hash type is negotiated, Read and ListDirs may be called from
+// several threads at once.
+class RemoteHashReader {
+ public:
+  enum class Backend {
+    kRc,
+    kLsjson,
+  };
+
+  struct Options {
+    Backend backend = Backend::kRc;
+    // For Backend::kRc.
+    RcClient::Options rc;
+    // For Backend::kLsjson. Extra arguments are passed to every rclone
+    // command, e.g. {"--config", "rclone.conf"}.
+    std::string rclone_binary = "rclone";
+    std::vector<std::string> rclone_args;
+
+    bool recurse = false;
+    // Whether to ask for modification times, which some remotes must fetch
+    // separately.
+    bool mod_time = false;
+    // Files which don't pass are left out by rclone itself, so they are
+    // neither listed nor hashed.
+    ListingFilter filter;
+  };
+
+  RemoteHashReader() = default;
+  explicit RemoteHashReader(const Options &opts) : opts_(opts), rc_(opts.rc) {}
+
+  // Asks the remote holding `path` which hash types it supports, and selects
+  // the first of `preferred` which it does. Subsequent Reads ask the remote
+  // for only that hash type, which matters for backends that compute hashes
+  // on the fly.
+  //
+  // If the remote supports none of `preferred`, returns an InvalidArgument
+  // error and subsequent Reads list files without hashes. Without a call to
+  // NegotiateHashType, Read asks for MD5.
+  rhutil::StatusOr<Hash::Type> NegotiateHashType(
+      std::string_view path, absl::Span<const Hash::Type> preferred);
+
+  // Lists the files under `path`, descending into subdirectories if `recurse`
+  // (by default, Options::recurse). Returns a NotFound error if `path` is not
+  // a directory.
+  rhutil::Status Read(std::string_view path,
+                      std::function<rhutil::Status(RemoteFile)> callback);
+  rhutil::Status Read(std::string_view path, bool recurse,
+                      std::function<rhutil::Status(RemoteFile)> callback);
+
+  // The names of the directories directly under `path`.
+  rhutil::StatusOr<std::vector<std::string>> ListDirs(std::string_view path);
+
+ private:
+  rhutil::StatusOr<std::vector<std::string>> SupportedHashes(
+      std::string_view fs);
+  rhutil::Status ReadRc(
+      std::string_view fs, std::string_view remote, bool recurse,
+      const std::function<rhutil::Status(RemoteFile)> &callback);
+  rhutil::Status ReadLsjson(
+      std::string_view fs, std::string_view remote, bool recurse,
+      const std::function<rhutil::Status(RemoteFile)> &callback);
+  // Waits for an rclone command, mapping rclone's exit status for a missing
+  // directory onto NotFound.
+  rhutil::Status WaitRClone(Subprocess *proc, std::string_view path);
+
+  // Parses an entry of operations/list or lsjson output. `dir` is prepended
+  // to its path.
+  RemoteFile ParseEntry(std::string_view dir,
+                        const nlohmann::json &entry) const;
+
+  std::vector<std::string> RCloneCommand(
+      std::initializer_list<std::string_view> args) const;
+
+  Options opts_;
+  RcClient rc_;
+
+  Hash::Type hash_type_ = Hash::MD5;
+  // The name rclone uses for hash_type_, if it has been negotiated.
+  std::string hash_name_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_REMOTE_HASH_READER_H_
@@ -0,0 +1,110 @@
+#include "roman/rclone/remote_hasher.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "nlohmann/json.hpp"
+#include "roman/rclone/listing_filter.h"
+#include "roman/util/thread_pool.h"
+#include "roman/util/weighted_semaphore.h"
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+using json = ::nlohmann::json;
+
+Status RemoteHasher::HashFiles(
+    std::string_view fs, std::vector<RemoteFile> files,
+    const std::function<Status(RemoteFile)> &callback) {
+  absl::Mutex mu;
+  Status status = OkStatus();
+
+  // Serializes calls to `callback`, and records the first error.
+  auto finish = [&](RemoteFile file, StatusOr<Hash> hash, bool cached) {
+    absl::MutexLock lock(&mu);
+    if (!status.ok()) return;
+    if (!hash.ok()) {
+      status = hash.status();
+      return;
+    }
+    if (cached) {
+      stats_.cached++;
+    } else {
+      stats_.downloaded++;
+      stats_.bytes_downloaded += file.size;
+    }
+    file.hash = std::move(hash).value();
+    status = callback(std::move(file));
+  };
+
+  WeightedSemaphore budget(opts_.max_bytes_in_flight);
+  {
+    ThreadPool pool(opts_.concurrency);
+    for (RemoteFile &file : files) {
+      std::string path = absl::StrCat(fs, file.path);
+      if (opts_.cache != nullptr) {
+        std::optional<Hash> hash = opts_.cache->Lookup(
+            path, file.size, file.mod_time, opts_.hash_type);
+        if (hash) {
+          finish(std::move(file), *std::move(hash), /*cached=*/true);
+          continue;
+        }
+      }
+
+      pool.Schedule([&, file = std::move(file), path = std::move(path)]() {
+        {
+          absl::MutexLock lock(&mu);
+          if (!status.ok()) return;
+        }
+        std::int64_t weight = budget.Acquire(file.size);
+        StatusOr<Hash> hash = Download(fs, file);
+        budget.Release(weight);
+
+        if (hash.ok() && opts_.cache != nullptr) {
+          opts_.cache->Insert(path, file.size, file.mod_time, hash.value());
+        }
+        finish(file, std::move(hash), /*cached=*/false);
+      });
+    }
+    pool.Wait();
+  }
+  return status;
+}
+
+StatusOr<Hash> RemoteHasher::Download(std::string_view fs,
+                                      const RemoteFile &file) const {
+  // rc calls take a directory as their fs, so select the one file with a
+  // filter rather than hashing its whole directory.
+  std::string_view dir, name = file.path;
+  if (auto slash = file.path.rfind('/'); slash != std::string::npos) {
+    dir = std::string_view(file.path).substr(0, slash);
+    name = std::string_view(file.path).substr(slash + 1);
+  }
+
+  ASSIGN_OR_RETURN(json output, rc_.CallAsync("operations/hashsum", {
+        {"fs", absl::StrCat(fs, dir)},
+        {"hashType", HashTypeToRClone(opts_.hash_type)},
+        {"download", true},
+        {"_filter", {{"IncludeRule", {absl::StrCat("/", GlobEscape(name))}}}},
+      }));
+
+  // Each line is "<hash>  <path>".
+  for (const json &line : output.value("hashsum", json::array())) {
+    std::pair<std::string, std::string> hash_path =
+        absl::StrSplit(line.get<std::string>(), absl::MaxSplits("  ", 1));
+    if (hash_path.second != name) continue;
+    return Hash(opts_.hash_type, hash_path.first);
+  }
+  return UnknownErrorBuilder()
+      << "rclone operations/hashsum returned no hash for " << fs << file.path
+      << ": " << output.dump();
+}
+
+}  // namespace roman
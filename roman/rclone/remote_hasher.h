@@ -0,0 +1,66 @@
+#ifndef ROMAN_RCLONE_REMOTE_HASHER_H_
+#define ROMAN_RCLONE_REMOTE_HASHER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "rhutil/status.h"
+#include "roman/hash.h"
+#include "roman/rclone/hash_cache.h"
+#include "roman/rclone/rc_client.h"
+#include "roman/rclone/remote_hash_reader.h"
+
+namespace roman {
+
+// Hashes files on remotes which can't report hashes themselves (e.g. crypt),
+// by having rclone download them through operations/hashsum.
+//
+// Downloads run concurrently, bounded both by a number of files and by the
+// total size of the files being downloaded at once. Hashes are recorded in an
+// optional HashCache, so that each file is downloaded only once.
+class RemoteHasher {
+ public:
+  struct Options {
+    RcClient::Options rc;
+    Hash::Type hash_type = Hash::MD5;
+    // How many files to download at once.
+    int concurrency = 4;
+    // The most bytes to have in flight at once. A file larger than this is
+    // downloaded on its own.
+    std::int64_t max_bytes_in_flight = std::int64_t{1} << 30;
+    // Not owned. May be null.
+    HashCache *cache = nullptr;
+  };
+
+  struct Stats {
+    std::int64_t cached = 0;
+    std::int64_t downloaded = 0;
+    std::int64_t bytes_downloaded = 0;
+  };
+
+  explicit RemoteHasher(const Options &opts) : opts_(opts), rc_(opts.rc) {}
+
+  // Hashes each of `files`, whose paths are relative to `fs` (e.g. "crypt:"),
+  // and calls `callback` with each file's hash filled in. Calls to `callback`
+  // are serialized, but come from worker threads in no particular order.
+  // Stops at the first error.
+  rhutil::Status HashFiles(
+      std::string_view fs, std::vector<RemoteFile> files,
+      const std::function<rhutil::Status(RemoteFile)> &callback);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  rhutil::StatusOr<Hash> Download(std::string_view fs,
+                                  const RemoteFile &file) const;
+
+  Options opts_;
+  RcClient rc_;
+  Stats stats_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_REMOTE_HASHER_H_
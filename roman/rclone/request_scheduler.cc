@@ -0,0 +1,116 @@
+#include "roman/rclone/request_scheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+namespace roman {
+
+RequestScheduler::RequestScheduler(const Options &opts)
+    : opts_(opts),
+      bucket_(opts.initial_rate, /*burst=*/opts.initial_concurrency),
+      rate_(opts.initial_rate),
+      concurrency_(opts.initial_concurrency) {}
+
+void RequestScheduler::Acquire() {
+  {
+    absl::MutexLock lock(&mu_);
+    while (true) {
+      if (absl::Now() < backoff_until_) {
+        cv_.WaitWithDeadline(&mu_, backoff_until_);
+        continue;
+      }
+      if (in_flight_ >= static_cast<int>(concurrency_)) {
+        cv_.Wait(&mu_);
+        continue;
+      }
+      break;
+    }
+    in_flight_++;
+  }
+  bucket_.Take();
+}
+
+void RequestScheduler::Release(Outcome outcome, absl::Duration latency) {
+  absl::MutexLock lock(&mu_);
+  in_flight_--;
+  requests_++;
+
+  absl::Time now = absl::Now();
+  bool may_decrease = now - last_decrease_ >= opts_.target_latency;
+  switch (outcome) {
+    case Outcome::kThrottled:
+      throttled_++;
+      if (!may_decrease) break;
+      last_decrease_ = now;
+      concurrency_ = std::max(1.0, concurrency_ / 2);
+      rate_ = std::max(opts_.min_rate, rate_ / 2);
+      bucket_.SetRate(rate_);
+      backoff_ = backoff_ == absl::ZeroDuration()
+          ? opts_.initial_backoff
+          : std::min(backoff_ * 2, opts_.max_backoff);
+      backoff_until_ = now + backoff_;
+      Log("throttled");
+      break;
+    case Outcome::kSuccess:
+      backoff_ = absl::ZeroDuration();
+      if (latency > opts_.target_latency) {
+        if (!may_decrease) break;
+        last_decrease_ = now;
+        concurrency_ = std::max(1.0, concurrency_ * 0.75);
+        Log("slow");
+        break;
+      }
+      // Roughly +1 per window of `concurrency_` requests, and
+      // +rate_increase per second at the current rate.
+      concurrency_ = std::min<double>(opts_.max_concurrency,
+                                      concurrency_ + 1 / concurrency_);
+      rate_ = std::min(opts_.max_rate, rate_ + opts_.rate_increase / rate_);
+      bucket_.SetRate(rate_);
+      if (now - last_log_ >= absl::Seconds(5)) Log("growing");
+      break;
+    case Outcome::kError:
+      break;
+  }
+  cv_.SignalAll();
+}
+
+RequestScheduler::State RequestScheduler::GetState() const {
+  absl::MutexLock lock(&mu_);
+  return GetStateLocked();
+}
+
+RequestScheduler::State RequestScheduler::GetStateLocked() const {
+  State state;
+  state.rate = rate_;
+  state.concurrency = concurrency_;
+  state.in_flight = in_flight_;
+  state.backoff = absl::Now() < backoff_until_ ? backoff_
+                                               : absl::ZeroDuration();
+  state.requests = requests_;
+  state.throttled = throttled_;
+  return state;
+}
+
+std::string RequestScheduler::StateToString(const State &state) {
+  std::string str = absl::StrFormat(
+      "rate %.1f/s, concurrency %d/%.1f, %d requests (%d throttled)",
+      state.rate, state.in_flight, state.concurrency, state.requests,
+      state.throttled);
+  if (state.backoff != absl::ZeroDuration()) {
+    absl::StrAppendFormat(&str, ", backing off for %s",
+                          absl::FormatDuration(state.backoff));
+  }
+  return str;
+}
+
+void RequestScheduler::Log(const char *event) {
+  last_log_ = absl::Now();
+  if (!opts_.verbose) return;
+  absl::FPrintF(stderr, "rclone scheduler %s: %s\n", event,
+                StateToString(GetStateLocked()));
+}
+
+}  // namespace roman
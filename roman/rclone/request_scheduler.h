@@ -0,0 +1,105 @@
+#ifndef ROMAN_RCLONE_REQUEST_SCHEDULER_H_
+#define ROMAN_RCLONE_REQUEST_SCHEDULER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "roman/rclone/token_bucket.h"
+
+namespace roman {
+
+// Shared admission control for rclone rc calls.
+//
+// Requests are paced by a token bucket and bounded by a concurrency limit.
+// Both adapt with AIMD: every successful request grows them additively, while
+// a throttling response (HTTP 403/429, or a backend rate limit error) halves
+// them and starts an exponential backoff during which no new requests are
+// admitted. Latencies above Options::target_latency are treated as a milder
+// congestion signal which shrinks only the concurrency limit.
+//
+// Decreases happen at most once per target_latency, so that a burst of
+// throttled responses to requests which were all in flight together counts as
+// a single congestion event.
+class RequestScheduler {
+ public:
+  struct Options {
+    // Requests per second.
+    double initial_rate = 10;
+    double min_rate = 0.5;
+    double max_rate = 100;
+    // How much the rate grows per second of uninterrupted success.
+    double rate_increase = 1;
+
+    int initial_concurrency = 4;
+    int max_concurrency = 32;
+
+    absl::Duration target_latency = absl::Seconds(2);
+    absl::Duration initial_backoff = absl::Seconds(1);
+    absl::Duration max_backoff = absl::Minutes(1);
+
+    // Print state changes to stderr.
+    bool verbose = false;
+  };
+
+  enum class Outcome {
+    kSuccess,
+    // The remote asked us to slow down.
+    kThrottled,
+    // Any other failure. Does not affect scheduling.
+    kError,
+  };
+
+  struct State {
+    double rate;
+    double concurrency;
+    int in_flight;
+    // Zero unless backing off.
+    absl::Duration backoff;
+    std::int64_t requests;
+    std::int64_t throttled;
+  };
+
+  RequestScheduler() : RequestScheduler(Options()) {}
+  explicit RequestScheduler(const Options &opts);
+
+  RequestScheduler(const RequestScheduler &) = delete;
+  RequestScheduler &operator=(const RequestScheduler &) = delete;
+
+  // Blocks until a request may be issued. Every Acquire must be paired with a
+  // Release.
+  void Acquire();
+
+  // Reports the outcome of a request admitted by Acquire. `latency` is
+  // ignored when zero, for requests whose duration says nothing about
+  // congestion (e.g. long running async jobs).
+  void Release(Outcome outcome, absl::Duration latency);
+
+  State GetState() const;
+
+  static std::string StateToString(const State &state);
+
+ private:
+  State GetStateLocked() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Log(const char *event) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options opts_;
+  TokenBucket bucket_;
+
+  mutable absl::Mutex mu_;
+  absl::CondVar cv_;
+  double rate_ GUARDED_BY(mu_);
+  double concurrency_ GUARDED_BY(mu_);
+  int in_flight_ GUARDED_BY(mu_) = 0;
+  absl::Duration backoff_ GUARDED_BY(mu_) = absl::ZeroDuration();
+  absl::Time backoff_until_ GUARDED_BY(mu_) = absl::InfinitePast();
+  absl::Time last_decrease_ GUARDED_BY(mu_) = absl::InfinitePast();
+  absl::Time last_log_ GUARDED_BY(mu_) = absl::InfinitePast();
+  std::int64_t requests_ GUARDED_BY(mu_) = 0;
+  std::int64_t throttled_ GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_REQUEST_SCHEDULER_H_
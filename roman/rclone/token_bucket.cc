@@ -0,0 +1,44 @@
+#include "roman/rclone/token_bucket.h"
+
+#include <algorithm>
+
+#include "absl/time/clock.h"
+
+namespace roman {
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate), burst_(burst), tokens_(burst), last_refill_(absl::Now()) {}
+
+void TokenBucket::Take(double tokens) {
+  absl::SleepFor(Reserve(tokens));
+}
+
+absl::Duration TokenBucket::Reserve(double tokens) {
+  absl::MutexLock lock(&mu_);
+  if (rate_ <= 0) return absl::ZeroDuration();
+  Refill(absl::Now());
+  tokens_ -= tokens;
+  if (tokens_ >= 0) return absl::ZeroDuration();
+  return absl::Seconds(-tokens_ / rate_);
+}
+
+void TokenBucket::SetRate(double rate) {
+  absl::MutexLock lock(&mu_);
+  Refill(absl::Now());
+  rate_ = rate;
+}
+
+double TokenBucket::rate() const {
+  absl::MutexLock lock(&mu_);
+  return rate_;
+}
+
+void TokenBucket::Refill(absl::Time now) {
+  if (rate_ > 0) {
+    tokens_ = std::min(
+        burst_, tokens_ + absl::ToDoubleSeconds(now - last_refill_) * rate_);
+  }
+  last_refill_ = now;
+}
+
+}  // namespace roman
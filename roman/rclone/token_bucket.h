@@ -0,0 +1,38 @@
+#ifndef ROMAN_RCLONE_TOKEN_BUCKET_H_
+#define ROMAN_RCLONE_TOKEN_BUCKET_H_
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace roman {
+
+// A thread-safe token bucket which refills at `rate` tokens per second up to
+// `burst` tokens. A non-positive rate means unlimited.
+class TokenBucket {
+ public:
+  TokenBucket(double rate, double burst);
+
+  // Takes `tokens` from the bucket, sleeping until they are available.
+  void Take(double tokens = 1);
+
+  // Takes `tokens` from the bucket without waiting, and returns how long the
+  // caller must wait before using them. The bucket may go into debt, which
+  // later callers wait out.
+  absl::Duration Reserve(double tokens = 1);
+
+  void SetRate(double rate);
+  double rate() const;
+
+ private:
+  void Refill(absl::Time now) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable absl::Mutex mu_;
+  double rate_ GUARDED_BY(mu_);
+  const double burst_;
+  double tokens_ GUARDED_BY(mu_);
+  absl::Time last_refill_ GUARDED_BY(mu_);
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_RCLONE_TOKEN_BUCKET_H_
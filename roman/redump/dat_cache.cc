@@ -0,0 +1,94 @@
+#include "roman/redump/dat_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "absl/strings/str_cat.h"
+#include "roman/proto_file.h"
+#include "roman/util/dirs.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+std::string TmpPath(std::string_view path) {
+  return absl::StrCat(path, ".tmp");
+}
+
+Status Rename(const std::string &tmp, const std::string &path) {
+  if (std::rename(tmp.c_str(), path.c_str()) == -1) {
+    return UnknownErrorBuilder() << "rename " << tmp << " to " << path << ": "
+                                 << std::strerror(errno);
+  }
+  return OkStatus();
+}
+
+// Writes `data` to a sibling of `path` and renames it into place, so that
+// readers never see a partial file.
+Status WriteFileAtomically(const std::string &path, std::string_view data) {
+  std::string tmp = TmpPath(path);
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(data.data(), data.size()) || !out.flush()) {
+      return UnknownErrorBuilder() << "Failed to write " << tmp;
+    }
+  }
+  return Rename(tmp, path);
+}
+
+}  // namespace
+
+std::optional<CachedDat> DatCache::Lookup(std::string_view key,
+                                          std::string_view url) const {
+  std::ifstream in(Path(key, ".meta"), std::ios::binary);
+  CachedDat meta;
+  if (!in || !meta.ParseFromIstream(&in) || meta.url() != url) {
+    return std::nullopt;
+  }
+  return meta;
+}
+
+StatusOr<RomDat> DatCache::LoadDat(std::string_view key) const {
+  RomDat dat;
+  RETURN_IF_ERROR(ReadProtoFile(Path(key, ".datpb"), &dat));
+  return dat;
+}
+
+StatusOr<std::unique_ptr<std::ofstream>> DatCache::OpenPartialZip(
+    std::string_view key) {
+  std::string tmp = TmpPath(Path(key, ".zip"));
+  RETURN_IF_ERROR(MakeParentDirs(tmp));
+  auto out = std::make_unique<std::ofstream>(
+      tmp, std::ios::binary | std::ios::trunc);
+  if (!*out) {
+    return UnknownErrorBuilder() << "Failed to open " << tmp << ": "
+                                 << std::strerror(errno);
+  }
+  return out;
+}
+
+Status DatCache::Store(std::string_view key, const CachedDat &meta,
+                       const RomDat &dat) {
+  std::string zip = Path(key, ".zip");
+  RETURN_IF_ERROR(Rename(TmpPath(zip), zip));
+  RETURN_IF_ERROR(
+      WriteFileAtomically(Path(key, ".datpb"), dat.SerializeAsString()));
+  return WriteFileAtomically(Path(key, ".meta"), meta.SerializeAsString());
+}
+
+std::string DatCache::DefaultPath() { return UserCachePath("dats"); }
+
+std::string DatCache::Path(std::string_view key,
+                           std::string_view extension) const {
+  return absl::StrCat(dir_, "/", key, extension);
+}
+
+}  // namespace roman
@@ -0,0 +1,62 @@
+#ifndef ROMAN_REDUMP_DAT_CACHE_H_
+#define ROMAN_REDUMP_DAT_CACHE_H_
+
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/status.h"
+#include "roman/redump/dat_cache.pb.h"
+
+namespace roman {
+
+// A directory of fetched dats. For each key (e.g. a redump console), it
+// keeps the zip as it was downloaded, the datpb parsed from it, and the
+// response's ETag and Last-Modified headers, so that a later fetch can ask the
+// server whether the dat changed and skip both the download and the parse if
+// it didn't.
+//
+//   <dir>/<key>.zip
+//   <dir>/<key>.datpb
+//   <dir>/<key>.meta - A binary CachedDat.
+//
+// The zip is written as it downloads, to a file which only replaces the
+// cached one once Store is called. The .meta is written last, so an
+// interrupted download or Store leaves the previous entry, or none, in place.
+class DatCache {
+ public:
+  explicit DatCache(std::string dir) : dir_(std::move(dir)) {}
+
+  // What the entry for `key` was fetched with, if there is one and it was
+  // fetched from `url`.
+  std::optional<CachedDat> Lookup(std::string_view key,
+                                  std::string_view url) const;
+
+  // The datpb cached for `key`.
+  rhutil::StatusOr<dat2pb::RomDat> LoadDat(std::string_view key) const;
+
+  // Opens the file to write the zip of `key` to while it downloads.
+  rhutil::StatusOr<std::unique_ptr<std::ofstream>> OpenPartialZip(
+      std::string_view key);
+
+  // Replaces the entry for `key` with `dat` and the zip written to
+  // OpenPartialZip, which must have been closed.
+  rhutil::Status Store(std::string_view key, const CachedDat &meta,
+                       const dat2pb::RomDat &dat);
+
+  // The default location, under $XDG_CACHE_HOME.
+  static std::string DefaultPath();
+
+ private:
+  std::string Path(std::string_view key, std::string_view extension) const;
+
+  const std::string dir_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_REDUMP_DAT_CACHE_H_
@@ -0,0 +1,449 @@
+#include "roman/redump/redump_fetcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
+#include "dat2pb/parser.h"
+#include "roman/util/bounded_queue.h"
+#include "roman/util/thread_pool.h"
+#include "roman/util/zip_entry_stream.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::rhutil::CurlEasyInit;
+using ::rhutil::CurlEasyPerform;
+using ::rhutil::CurlEasySetWriteCallback;
+using ::rhutil::CurlEasySetopt;
+using ::rhutil::CurlHandleDeleter;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+class CurlSlistDeleter {
+ public:
+  void operator()(curl_slist *list) {
+    curl_slist_free_all(list);
+  }
+};
+
+class CurlMultiDeleter {
+ public:
+  void operator()(CURLM *multi) {
+    curl_multi_cleanup(multi);
+  }
+};
+
+// curl's default is 16 KiB. Larger reads mean fewer chunks to hand over to
+// the parser.
+constexpr long kReceiveBufferSize = 128 << 10;
+
+// How many received chunks may wait for the parser before the download is
+// paused.
+constexpr int kQueuedChunks = 16;
+
+// How long to wait on the connections before looking again for finished
+// parses and paused downloads with room to resume. curl_multi_wakeup, which
+// could end the wait early, is newer than the curl this builds with.
+constexpr int kPollTimeoutMs = 50;
+
+}  // namespace
+
+struct RedumpFetcher::Transfer {
+  // Sets up `curl` to GET `url`, conditional on the dat having changed since
+  // it was cached, if it was.
+  Status Prepare(bool verbose) {
+    if (verbose) {
+      RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_VERBOSE, true));
+    }
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_URL, url.c_str()));
+    RETURN_IF_ERROR(
+        CurlEasySetopt(curl.get(), CURLOPT_BUFFERSIZE, kReceiveBufferSize));
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_WRITEFUNCTION, &OnBody));
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_WRITEDATA, this));
+    RETURN_IF_ERROR(
+        CurlEasySetopt(curl.get(), CURLOPT_HEADERFUNCTION, &OnHeader));
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_HEADERDATA, this));
+
+    curl_slist *list = nullptr;
+    if (cached && !cached->etag().empty()) {
+      list = curl_slist_append(
+          list, absl::StrCat("If-None-Match: ", cached->etag()).c_str());
+    }
+    if (cached && !cached->last_modified().empty()) {
+      list = curl_slist_append(
+          list,
+          absl::StrCat("If-Modified-Since: ", cached->last_modified()).c_str());
+    }
+    headers.reset(list);
+    return CurlEasySetopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
+  }
+
+  // Hands the body of a dat to the parser, pausing the download while the
+  // parser is behind. Bodies of other responses are dropped.
+  static size_t OnBody(char *data, size_t size, size_t nitems,
+                       void *userdata) {
+    auto *transfer = static_cast<Transfer *>(userdata);
+    if (!transfer->streaming) return size * nitems;
+    std::string chunk(data, size * nitems);
+    switch (transfer->chunks.TryPush(&chunk)) {
+      case BoundedQueue<std::string>::TryPushResult::kPushed:
+        return size * nitems;
+      case BoundedQueue<std::string>::TryPushResult::kFull:
+        // curl passes the same data again once the transfer is unpaused.
+        transfer->paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+      case BoundedQueue<std::string>::TryPushResult::kClosed:
+        break;
+    }
+    return 0;
+  }
+
+  // Records the status and validators of the response, as curl passes its
+  // header lines.
+  static size_t OnHeader(char *data, size_t size, size_t nitems,
+                         void *userdata) {
+    auto *transfer = static_cast<Transfer *>(userdata);
+    std::string_view line(data, size * nitems);
+    // Headers of an earlier response (e.g. 100 Continue) don't count.
+    if (absl::StartsWith(line, "HTTP/")) {
+      transfer->etag.clear();
+      transfer->last_modified.clear();
+      std::vector<std::string_view> status = absl::StrSplit(line, ' ');
+      if (status.size() < 2 ||
+          !absl::SimpleAtoi(status[1], &transfer->response_code)) {
+        transfer->response_code = 0;
+      }
+      return size * nitems;
+    }
+    // A blank line ends the headers. What follows is the body.
+    if (absl::StripAsciiWhitespace(line).empty()) {
+      transfer->streaming = transfer->response_code == 200;
+      return size * nitems;
+    }
+    std::pair<std::string_view, std::string_view> header =
+        absl::StrSplit(line, absl::MaxSplits(':', 1));
+    std::string_view name = absl::StripAsciiWhitespace(header.first);
+    std::string_view value = absl::StripAsciiWhitespace(header.second);
+    if (absl::EqualsIgnoreCase(name, "ETag")) {
+      transfer->etag = std::string(value);
+    } else if (absl::EqualsIgnoreCase(name, "Last-Modified")) {
+      transfer->last_modified = std::string(value);
+    }
+    return size * nitems;
+  }
+
+  std::string console;
+  std::string url;
+  std::optional<CachedDat> cached;
+  std::unique_ptr<CURL, CurlHandleDeleter> curl;
+  std::unique_ptr<curl_slist, CurlSlistDeleter> headers;
+
+  // Of the last response.
+  int response_code = 0;
+  std::string etag;
+  std::string last_modified;
+
+  // Whether the body is a dat, which is passed through `chunks` to the parser
+  // as it arrives. Only touched by the thread driving curl.
+  bool streaming = false;
+  bool parse_started = false;
+  BoundedQueue<std::string> chunks{kQueuedChunks};
+  // Set when the download was paused because `chunks` was full.
+  std::atomic<bool> paused{false};
+  // How the download ended. Set before `chunks` is closed.
+  CURLcode result = CURLE_OK;
+};
+
+StatusOr<RomDat> RedumpFetcher::GetRomDat(std::string_view console) {
+  std::vector<std::string> consoles = {std::string(console)};
+  std::optional<StatusOr<RomDat>> fetched;
+  RETURN_IF_ERROR(GetRomDats(
+      consoles, [&fetched](std::string_view, StatusOr<RomDat> dat) {
+        fetched = std::move(dat);
+        return OkStatus();
+      }));
+  return *std::move(fetched);
+}
+
+Status RedumpFetcher::GetRomDats(absl::Span<const std::string> consoles,
+                                 const Callback &callback) {
+  std::unique_ptr<CURLM, CurlMultiDeleter> multi(curl_multi_init());
+  curl_multi_setopt(multi.get(), CURLMOPT_MAX_HOST_CONNECTIONS,
+                    static_cast<long>(opts_.max_connections));
+  // One dat per connection, rather than all of them multiplexed over one.
+  curl_multi_setopt(multi.get(), CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+
+  // Transfers are shared with the threads parsing them.
+  absl::flat_hash_map<CURL *, std::shared_ptr<Transfer>> active;
+  auto start = [&](std::shared_ptr<Transfer> transfer) -> Status {
+    RETURN_IF_ERROR(transfer->Prepare(opts_.verbose));
+    CURL *curl = transfer->curl.get();
+    if (CURLMcode code = curl_multi_add_handle(multi.get(), curl);
+        code != CURLM_OK) {
+      return UnknownErrorBuilder()
+          << "curl_multi_add_handle: " << curl_multi_strerror(code);
+    }
+    active[curl] = std::move(transfer);
+    return OkStatus();
+  };
+  // Transfers still in `multi` must leave it before it is cleaned up, and
+  // their parsers must stop waiting for them.
+  auto remove_all = [&] {
+    for (auto &[curl, transfer] : active) {
+      curl_multi_remove_handle(multi.get(), curl);
+      transfer->result = CURLE_ABORTED_BY_CALLBACK;
+      transfer->chunks.Close();
+    }
+    active.clear();
+  };
+
+  // Shared with the parsing threads.
+  absl::Mutex mu;
+  int parsing = 0;
+  std::vector<std::string> retries;
+  Status status;
+  absl::Mutex callback_mu;
+
+  // Passes a dat to `callback`, or queues the console to be fetched again if
+  // there is no dat.
+  auto finish = [&](const std::string &console,
+                    std::optional<StatusOr<RomDat>> dat) {
+    if (dat) {
+      absl::MutexLock callback_lock(&callback_mu);
+      bool stopped;
+      {
+        absl::MutexLock lock(&mu);
+        stopped = !status.ok();
+      }
+      Status called = stopped ? OkStatus() : callback(console, *std::move(dat));
+      absl::MutexLock lock(&mu);
+      if (status.ok()) status = called;
+    }
+    absl::MutexLock lock(&mu);
+    if (!dat) retries.push_back(console);
+    parsing--;
+  };
+
+  ThreadPool pool(std::max(1, opts_.parse_threads));
+  auto schedule = [&](std::function<void()> task) {
+    {
+      absl::MutexLock lock(&mu);
+      parsing++;
+    }
+    pool.Schedule(std::move(task));
+  };
+  // Starts parsing a dat while it downloads.
+  auto parse = [&](std::shared_ptr<Transfer> transfer) {
+    transfer->parse_started = true;
+    schedule([this, &finish, transfer] {
+      finish(transfer->console, Stream(transfer.get()));
+    });
+  };
+
+  for (const std::string &console : consoles) {
+    if (Status started = start(NewTransfer(console, /*conditional=*/true));
+        !started.ok()) {
+      remove_all();
+      return started;
+    }
+  }
+
+  while (true) {
+    int running;
+    if (CURLMcode code = curl_multi_perform(multi.get(), &running);
+        code != CURLM_OK) {
+      absl::MutexLock lock(&mu);
+      status = UnknownErrorBuilder()
+          << "curl_multi_perform: " << curl_multi_strerror(code);
+      break;
+    }
+    int queued;
+    while (CURLMsg *msg = curl_multi_info_read(multi.get(), &queued)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      auto it = active.find(msg->easy_handle);
+      std::shared_ptr<Transfer> transfer = std::move(it->second);
+      active.erase(it);
+      curl_multi_remove_handle(multi.get(), msg->easy_handle);
+      CURLcode result = msg->data.result;
+      if (transfer->streaming) {
+        transfer->result = result;
+        transfer->chunks.Close();
+        if (!transfer->parse_started) parse(std::move(transfer));
+        continue;
+      }
+      schedule([this, &finish, transfer, result] {
+        finish(transfer->console, Complete(transfer.get(), result));
+      });
+    }
+    for (auto &[curl, transfer] : active) {
+      if (transfer->streaming && !transfer->parse_started) parse(transfer);
+      // Resumes downloads paused on a parser which has since made room.
+      if (transfer->paused && !transfer->chunks.Full()) {
+        transfer->paused = false;
+        curl_easy_pause(curl, CURLPAUSE_CONT);
+      }
+    }
+
+    bool done;
+    {
+      absl::MutexLock lock(&mu);
+      for (const std::string &console : retries) {
+        if (status.ok()) {
+          status = start(NewTransfer(console, /*conditional=*/false));
+        }
+      }
+      retries.clear();
+      done = !status.ok() || (active.empty() && parsing == 0);
+    }
+    if (done) break;
+    curl_multi_poll(multi.get(), nullptr, 0, kPollTimeoutMs, nullptr);
+  }
+
+  remove_all();
+  pool.Wait();
+  absl::MutexLock lock(&mu);
+  return status;
+}
+
+StatusOr<std::vector<std::string>> RedumpFetcher::ListConsoles() {
+  std::unique_ptr<CURL, CurlHandleDeleter> curl = CurlEasyInit();
+  if (opts_.verbose) {
+    RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_VERBOSE, true));
+  }
+  std::string url = absl::StrCat(opts_.url, "/downloads/");
+  RETURN_IF_ERROR(CurlEasySetopt(curl.get(), CURLOPT_URL, url.c_str()));
+  std::string page;
+  RETURN_IF_ERROR(CurlEasySetWriteCallback(
+        curl.get(),
+        [&page](std::string_view data, size_t*) -> Status {
+          page.append(data);
+          return OkStatus();
+        }));
+  RETURN_IF_ERROR(CurlEasyPerform(curl.get()));
+
+  // Every console's row links to its dat as /datfile/<console>/.
+  std::vector<std::string> consoles;
+  absl::flat_hash_set<std::string> seen;
+  std::vector<std::string_view> parts = absl::StrSplit(page, "/datfile/");
+  for (size_t i = 1; i < parts.size(); i++) {
+    std::string_view console = parts[i].substr(0, parts[i].find('/'));
+    if (console.empty() || console.size() == parts[i].size()) continue;
+    bool valid = absl::c_all_of(console, [](char c) {
+      return absl::ascii_isalnum(c) || c == '-' || c == '_';
+    });
+    if (valid && seen.emplace(console).second) {
+      consoles.emplace_back(console);
+    }
+  }
+  if (consoles.empty()) {
+    return UnknownErrorBuilder() << "Found no dats on " << url;
+  }
+  return consoles;
+}
+
+std::shared_ptr<RedumpFetcher::Transfer> RedumpFetcher::NewTransfer(
+    std::string_view console, bool conditional) const {
+  auto transfer = std::make_shared<Transfer>();
+  transfer->console = std::string(console);
+  transfer->url =
+      absl::StrFormat("%s/datfile/%s/serial,version", opts_.url, console);
+  if (opts_.cache != nullptr && conditional) {
+    transfer->cached = opts_.cache->Lookup(console, transfer->url);
+  }
+  transfer->curl = CurlEasyInit();
+  return transfer;
+}
+
+std::optional<StatusOr<RomDat>> RedumpFetcher::Complete(
+    Transfer *transfer, CURLcode result) const {
+  if (result != CURLE_OK) {
+    return StatusOr<RomDat>(UnknownErrorBuilder()
+        << "GET " << transfer->url << ": " << curl_easy_strerror(result));
+  }
+  if (transfer->cached && transfer->response_code == 304) {
+    StatusOr<RomDat> dat = opts_.cache->LoadDat(transfer->console);
+    if (dat.ok()) return dat;
+    std::cerr << "Ignoring the cached " << transfer->console << " dat: "
+              << dat.status() << std::endl;
+    return std::nullopt;
+  }
+  // A dat would have been streamed to the parser.
+  return StatusOr<RomDat>(UnknownErrorBuilder()
+      << "GET " << transfer->url << " returned HTTP "
+      << transfer->response_code);
+}
+
+StatusOr<RomDat> RedumpFetcher::Stream(Transfer *transfer) const {
+  // Without validators, there is no asking whether the dat changed, so
+  // caching it would gain nothing.
+  std::unique_ptr<std::ofstream> zip;
+  if (opts_.cache != nullptr &&
+      (!transfer->etag.empty() || !transfer->last_modified.empty())) {
+    StatusOr<std::unique_ptr<std::ofstream>> opened =
+        opts_.cache->OpenPartialZip(transfer->console);
+    if (opened.ok()) {
+      zip = std::move(opened).ValueOrDie();
+    } else {
+      std::cerr << "Not caching the " << transfer->console << " dat: "
+                << opened.status() << std::endl;
+    }
+  }
+
+  auto next_chunk = [transfer, &zip](std::string *chunk) {
+    std::optional<std::string> next = transfer->chunks.Pop();
+    if (!next) return false;
+    if (zip) zip->write(next->data(), next->size());
+    *chunk = *std::move(next);
+    return true;
+  };
+  ZipEntryInputStream unzipped(next_chunk);
+  StatusOr<RomDat> dat = dat2pb::ParseRomDat(&unzipped);
+  // Whatever follows the dat (e.g. the zip's central directory) is read too,
+  // both to cache all of the zip and to learn how the download ended.
+  std::string rest;
+  while (next_chunk(&rest)) {}
+
+  if (transfer->result != CURLE_OK) {
+    return UnknownErrorBuilder() << "GET " << transfer->url << ": "
+                                 << curl_easy_strerror(transfer->result);
+  }
+  RETURN_IF_ERROR(unzipped.status());
+  if (!dat.ok() || !zip) return dat;
+
+  zip->close();
+  CachedDat meta;
+  meta.set_url(transfer->url);
+  meta.set_etag(transfer->etag);
+  meta.set_last_modified(transfer->last_modified);
+  // The dat is good either way, so a failure to cache it is not fatal.
+  Status stored;
+  if (zip->fail()) {
+    stored = UnknownErrorBuilder() << "Failed to write the zip";
+  } else {
+    stored = opts_.cache->Store(transfer->console, meta, *dat);
+  }
+  if (!stored.ok()) {
+    std::cerr << "Failed to cache the " << transfer->console << " dat: "
+              << stored << std::endl;
+  }
+  return dat;
+}
+
+}  // namespace roman
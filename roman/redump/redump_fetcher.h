@@ -0,0 +1,80 @@
+#ifndef ROMAN_REDUMP_REDUMP_FETCHER_H_
+#define ROMAN_REDUMP_REDUMP_FETCHER_H_
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/curl/curl.h"
+#include "rhutil/status.h"
+#include "roman/redump/dat_cache.h"
+
+namespace roman {
+
+// Downloads dats from redump.org and parses them into datpbs.
+class RedumpFetcher {
+ public:
+  struct Options {
+    // Where redump is. Anything serving the same /datfile/ paths will do.
+    std::string url = "http://redump.org";
+    // Revalidates dats kept here rather than downloading them again, and
+    // keeps what was downloaded. Not owned. May be null.
+    DatCache *cache = nullptr;
+    // How many connections to redump are open at once. Each downloads one
+    // dat at a time.
+    int max_connections = 4;
+    // How many dats are unzipped and parsed at once, each while it downloads.
+    // Downloads of any others wait for a free thread.
+    int parse_threads = 1;
+    bool verbose = false;
+  };
+
+  // Called with each fetched dat, or the error fetching it.
+  using Callback = std::function<rhutil::Status(
+      std::string_view console, rhutil::StatusOr<dat2pb::RomDat> dat)>;
+
+  explicit RedumpFetcher(const Options &opts) : opts_(opts) {}
+
+  // Fetches the dat of `console`, the system part of its datfile URL (e.g.
+  // "acd" for http://redump.org/datfile/acd/).
+  rhutil::StatusOr<dat2pb::RomDat> GetRomDat(std::string_view console);
+
+  // Fetches the dats of `consoles` concurrently, over up to max_connections
+  // connections. Each dat is unzipped and parsed on one of parse_threads
+  // threads as it downloads, and then passed to `callback`. Callbacks run one
+  // at a time, in the order the dats complete. An error fetching one dat is
+  // passed to `callback` and doesn't stop the others, but an error returned
+  // by `callback` stops everything and is returned.
+  rhutil::Status GetRomDats(absl::Span<const std::string> consoles,
+                            const Callback &callback);
+
+  // The consoles redump has dats for, as listed on its downloads page.
+  rhutil::StatusOr<std::vector<std::string>> ListConsoles();
+
+ private:
+  struct Transfer;
+
+  // Without `conditional`, the dat is downloaded even if it is cached.
+  std::shared_ptr<Transfer> NewTransfer(std::string_view console,
+                                        bool conditional) const;
+
+  // The dat of a `transfer` which didn't download one, or nullopt if it has
+  // to be downloaded again, unconditionally.
+  std::optional<rhutil::StatusOr<dat2pb::RomDat>> Complete(
+      Transfer *transfer, CURLcode result) const;
+
+  // Parses the dat `transfer` is downloading as it arrives, and caches it.
+  // Returns once the download ended.
+  rhutil::StatusOr<dat2pb::RomDat> Stream(Transfer *transfer) const;
+
+  const Options opts_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_REDUMP_REDUMP_FETCHER_H_
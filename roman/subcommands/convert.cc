@@ -1,155 +1,118 @@
-#define G_LOG_DOMAIN "CDManip"
-
-#include <string>
-#include <cstdlib>
-#include <cstdio>
-#include <ostream>
 #include <iostream>
-#include <stdlib.h>
-#include <cstring>
-#include <cerrno>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-#include "absl/algorithm/container.h"
-#include "absl/strings/str_split.h"
-#include "absl/strings/str_format.h"
-#include "absl/strings/str_join.h"
-#include "absl/strings/string_view.h"
-#include "absl/container/flat_hash_set.h"
-#include "absl/types/span.h"
 #include "absl/flags/flag.h"
+#include "absl/types/span.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/module_init.h"
+#include "rhutil/status.h"
+#include "roman/common_flags.h"
+#include "roman/convert/dat_converter.h"
+#include "roman/print_proto.h"
+#include "roman/proto_file.h"
 #include "roman/subcommands/subcommands.h"
-#include "roman/util/errors.h"
-#include "roman/util/glib.h"
-#include "roman/util/cleanup.h"
-#include "roman/cdmap/cdmap.pb.h"
-
-#include "mirage/mirage.h"
-#include "mirage/writer.h"
 
-ABSL_FLAG(std::vector<std::string>, mirage_debug_masks, {},
-          "Emit libmirage debug messages. Use the mask \"HELP\" to list valid "
-          "masks.");
+ABSL_FLAG(bool, reconvert, false,
+          "Convert every dat, even those unchanged since they were last "
+          "converted into --output_dir.");
 
 namespace roman {
-
 namespace {
 
-absl::Span<const MirageDebugMaskInfo> MirageDebugMasks(GError **error) {
-  const MirageDebugMaskInfo *masks;
-  int num_masks = -1;
-  if (!mirage_get_supported_debug_masks(&masks, &num_masks, error)) return {};
-  g_assert(num_masks >= 0);
-  return {masks, static_cast<unsigned int>(num_masks)};
+using ::dat2pb::RomDat;
+using ::rhutil::InvalidArgumentError;
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::UnknownErrorBuilder;
+
+constexpr char kUsageMessage[] = R"(Usage: roman convert [options] dat...
+
+Convert dat files to datpbs. Each dat is either a dat file, a zip of any
+number of them, or a directory which is searched recursively for *.dat, *.xml
+and *.zip files. Given a single dat, writes its datpb to stdout. Given
+several, writes each to <name>.datpb in --output_dir, where <name> is the dat
+file's name without its extension, under the same subdirectory as the dat was
+found in.
+
+Dats are converted in parallel on --parse_threads threads, and every dat of a
+zip is converted on a thread of its own. A dat which fails doesn't stop the
+others.
+
+The SHA-1 of every input converted into --output_dir is kept there, and an
+input which is unchanged since is skipped, as long as its datpbs still exist.
+Use --reconvert after changing options such as --binary or --compress.
+
+Example usage:
+$ roman convert "Nintendo - Game Boy (20200101).dat" > gb.datpb
+$ roman convert --binary --output_dir=datpbs dats/ no-intro.zip)";
+
+// Writes the only dat of `path` to stdout.
+Status ConvertToStdout(const std::string &path) {
+  std::optional<RomDat> dat;
+  RETURN_IF_ERROR(ParseDatFile(
+      path, [&](std::string_view name, RomDat parsed) -> Status {
+        if (dat) {
+          return InvalidArgumentErrorBuilder()
+              << path << " holds several dats. Convert them with "
+              << "--output_dir.";
+        }
+        dat = std::move(parsed);
+        return OkStatus();
+      }));
+  if (!dat) {
+    return InvalidArgumentErrorBuilder() << "Found no dats in " << path;
+  }
+  return PrintDatPB(&dat.value(), &std::cout);
 }
 
-GObjectPtr<MirageContext> CreateContext(GError **error) {
-  auto ctx = NewGObject<MirageContext>(MIRAGE_TYPE_CONTEXT, nullptr);
-
-  mirage_context_set_debug_domain(ctx.Get(), G_LOG_DOMAIN);
-
-  GError *err = nullptr;
-  absl::Span<const MirageDebugMaskInfo> supported_masks = MirageDebugMasks(&err);
-  if (err != nullptr) {
-    g_propagate_error(error, err);
-    return nullptr;
+Status SubCommandConvert(absl::Span<std::string_view> args) {
+  if (args.size() < 2) {
+    return InvalidArgumentError(kUsageMessage);
   }
-
-  std::vector<std::string> wanted_masks =
-      absl::GetFlag(FLAGS_mirage_debug_masks);
-
-  if (!wanted_masks.empty()) {
-    constexpr const char kDebugEnvVar[] = "G_MESSAGES_DEBUG";
-    absl::string_view old_log_domains_str(std::getenv(kDebugEnvVar));
-    absl::flat_hash_set<absl::string_view> log_domains =
-        absl::StrSplit(old_log_domains_str, " ", absl::SkipWhitespace());
-    log_domains.emplace(G_LOG_DOMAIN);
-    std::string new_log_domains_str = absl::StrJoin(log_domains, " ");
-    if (setenv(kDebugEnvVar, new_log_domains_str.c_str(), true) != 0) {
-      g_set_error(error, ROMAN_ERROR, roman::ERR_OS,
-          "Failed to set environment variable %s: %s", kDebugEnvVar,
-          std::strerror(errno));
-      return nullptr;
+  std::vector<std::string> inputs(args.begin() + 1, args.end());
+  std::string output_dir = absl::GetFlag(FLAGS_output_dir);
+  if (output_dir.empty()) {
+    if (inputs.size() > 1) {
+      return InvalidArgumentError(
+          "Converting several dats needs an --output_dir");
     }
+    return ConvertToStdout(inputs[0]);
   }
-
-  int masks = 0;
-  for (const MirageDebugMaskInfo &mask : supported_masks) {
-    auto it = absl::c_find(wanted_masks, mask.name);
-    if (it == wanted_masks.end()) continue;
-    wanted_masks.erase(it);
-    masks |= mask.value;
+  ASSIGN_OR_RETURN(std::optional<GameWriter::Format> format,
+                   GameFormatFromFlags());
+  if (format) {
+    return InvalidArgumentError(
+        "--output_format only applies to a single dat written to stdout");
   }
 
-  if (!wanted_masks.empty()) {
-    absl::FPrintF(stderr, "Unsupported mask(s): [%s]\n", absl::StrJoin(wanted_masks, ","));
-    absl::FPrintF(stderr, "Supported masks are:\n");
-    for (const MirageDebugMaskInfo &mask : supported_masks) {
-      absl::FPrintF(stderr, "%s\n", mask.name);
-    }
-    std::exit(EXIT_SUCCESS);
+  DatConverter::Options opts;
+  opts.output_dir = output_dir;
+  opts.threads = absl::GetFlag(FLAGS_parse_threads);
+  if (opts.threads <= 0) {
+    opts.threads = std::thread::hardware_concurrency();
   }
-
-  mirage_context_set_debug_mask(ctx.Get(), masks);
-
-  return ctx;
-}
-
-}  // namespace
-
-bool SubCommand::Convert(
-    absl::Span<absl::string_view> args,
-    GError **error) {
-  if (args.size() != 4) {
-    g_set_error(
-        error, ROMAN_ERROR, roman::ERR_USAGE,
-        "Usage: %s %s source dest_writer dest", getprogname(), args[0].data());
-    return false;
+  opts.force = absl::GetFlag(FLAGS_reconvert);
+  opts.write = &PrintDatPB;
+  DatConverter converter(opts);
+  ASSIGN_OR_RETURN(DatConverter::Stats stats, converter.Convert(inputs));
+  std::cerr << "Converted " << stats.converted << " dats. "
+            << stats.unchanged << " inputs were unchanged." << std::endl;
+  if (stats.failed > 0) {
+    return UnknownErrorBuilder()
+        << "Failed to convert " << stats.failed << " dats";
   }
-  absl::string_view source_file = args[1];
-  absl::string_view writer_name = args[2];
-  absl::string_view dest_file = args[3];
-
-  if (!mirage_initialize(error)) return false;
-  Cleanup cleanup([]() {
-      GError *err = nullptr;
-      mirage_shutdown(&err);
-      CHECK_OK(err);
-  });
-
-  GObjectPtr<MirageContext> ctx = CreateContext(error);
-  if (!ctx) return false;
-
-  char *source_file_nullterm[2] = {
-    const_cast<char*>(source_file.data()), nullptr
-  };
-  auto disc = WrapGObject<MirageDisc>(mirage_context_load_image(
-        ctx.Get(), source_file_nullterm, error));
-  if (!disc) return false;
-
-  auto writer =
-    WrapGObject<MirageWriter>(mirage_create_writer(writer_name.data(), error));
-  if (!writer) return false;
-
-  mirage_contextual_set_context(MIRAGE_CONTEXTUAL(writer.Get()), ctx.Get());
-
-  // TODO(eatnumber1): Progress reporting.
-
-  std::unique_ptr<GHashTable, GHashTableDestroy> parameters(
-    g_hash_table_new(g_str_hash, g_str_equal));
-  if (!mirage_writer_convert_image(writer.Get(), dest_file.data(), disc.Get(),
-                                   parameters.get(), /*cancellable=*/nullptr,
-                                   error)) {
-    return false;
-  }
-
-  std::vector<const char *> filenames;
-  filenames.reserve(args.size());
-  for (int i = 1; i < args.size(); i++) filenames.emplace_back(args[i].data());
-  filenames.emplace_back(nullptr);
+  return OkStatus();
+}
 
-  absl::PrintF("Converted image %s to %s using %s\n", source_file, dest_file,
-               writer_name);
-  return true;
+static void Initialize() {
+  SubCommands::Instance()->Add("convert", &SubCommandConvert);
 }
+rhutil::ModuleInit module_init(&Initialize);
 
+}  // namespace
 }  // namespace roman
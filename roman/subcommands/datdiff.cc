@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string_view>
+
+#include "absl/types/span.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/module_init.h"
+#include "rhutil/status.h"
+#include "roman/index/dat_diff.h"
+#include "roman/index/dat_diff.pb.h"
+#include "roman/print_proto.h"
+#include "roman/proto_file.h"
+#include "roman/subcommands/subcommands.h"
+
+namespace roman {
+namespace {
+
+using ::dat2pb::RomDat;
+using ::rhutil::InvalidArgumentError;
+using ::rhutil::Status;
+
+constexpr char kUsageMessage[] = R"(Usage: roman datdiff [options] old new
+
+Print how the datpb new differs from the datpb old: the games only one of them
+has, and for each game both have but which differs, the ROMs which were added,
+removed or changed. Games and ROMs are matched by name.
+
+Given the diff with --dat_diff, roman index turns an index of old into one of
+new without listing the remote again, which keeps the index of a large
+collection current across dat revisions which change a few games. For that,
+write the diff with --binary.
+
+Example usage:
+$ roman datdiff psx-old.datpb psx.datpb
+$ roman datdiff --binary psx-old.datpb psx.datpb > psx.datdiff
+$ roman index --binary --dat_diff=psx.datdiff psx-old.index > psx.index)";
+
+Status SubCommandDatDiff(absl::Span<std::string_view> args) {
+  if (args.size() != 3) {
+    return InvalidArgumentError(kUsageMessage);
+  }
+  ASSIGN_OR_RETURN(ArenaMessage<RomDat> old_dat,
+                   LoadProtoFile<RomDat>(args[1]));
+  ASSIGN_OR_RETURN(ArenaMessage<RomDat> new_dat,
+                   LoadProtoFile<RomDat>(args[2]));
+  ASSIGN_OR_RETURN(DatDiff diff, DiffDats(*old_dat, *new_dat));
+  std::cerr << diff.added_size() << " games added, " << diff.removed_size()
+            << " removed, " << diff.changed_size() << " changed" << std::endl;
+  return PrintProto(diff, &std::cout);
+}
+
+static void Initialize() {
+  SubCommands::Instance()->Add("datdiff", &SubCommandDatDiff);
+}
+rhutil::ModuleInit module_init(&Initialize);
+
+}  // namespace
+}  // namespace roman
@@ -1,208 +1,145 @@
-#include <cstdlib>
-#include <memory>
-#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #include "absl/flags/flag.h"
-#include "absl/strings/str_format.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "roman/subcommands/subcommands.h"
 #include "roman/print_proto.h"
-#include "dat2pb/parser.h"
 #include "dat2pb/romdat.pb.h"
 #include "rhutil/curl/curl.h"
 #include "rhutil/module_init.h"
 #include "rhutil/status.h"
-#include "zip.h"
 #include "roman/common_flags.h"
+#include "roman/proto_file.h"
+#include "roman/redump/dat_cache.h"
+#include "roman/redump/redump_fetcher.h"
+#include "roman/util/dirs.h"
+
+ABSL_FLAG(bool, all, false, "Fetch the dat of every console redump has.");
+ABSL_FLAG(int, fetch_connections, 4,
+          "How many dats to download from redump at once.");
+ABSL_FLAG(std::string, redump_url, "http://redump.org",
+          "Where to fetch dats from.");
+ABSL_FLAG(bool, use_dat_cache, true,
+          "Keep fetched dats in --dat_cache, and only download them again "
+          "if they changed.");
+ABSL_FLAG(std::string, dat_cache, "",
+          "Where to keep fetched dats. Defaults to "
+          "$XDG_CACHE_HOME/roman/dats.");
 
 namespace roman {
 namespace {
 
 using ::dat2pb::RomDat;
-using ::rhutil::CurlURL;
-using ::rhutil::StatusOr;
 using ::rhutil::Status;
+using ::rhutil::StatusOr;
 using ::rhutil::OkStatus;
-using ::rhutil::UnknownErrorBuilder;
-using ::rhutil::CurlHandleDeleter;
-using ::rhutil::CurlEasySetopt;
-using ::rhutil::CurlEasyInit;
-using ::rhutil::CurlEasyPerform;
-using ::rhutil::CurlEasySetWriteCallback;
 using ::rhutil::InvalidArgumentError;
-using ::rhutil::InvalidArgumentErrorBuilder;
-using ::rhutil::UnknownError;
-
-class ZipDiscard {
- public:
-  void operator()(zip_t *archive) {
-    zip_discard(archive);
-  }
-};
-
-class ZipFClose {
- public:
-  void operator()(zip_file_t *file) {
-    if (zip_fclose(file) != 0) {
-      std::abort();
-    }
-  }
-};
-
-class ZipError {
- public:
-  ZipError() {
-    zip_error_init(&error_);
-  }
-
-  ~ZipError() {
-    zip_error_fini(&error_);
-  }
-
-  zip_error_t *ptr() { return &error_; }
-
- private:
-  zip_error_t error_;
-};
-
-class ZipFileStreambuf : public std::streambuf {
- public:
-   ZipFileStreambuf(zip_t *archive, zip_file_t *file)
-     : archive_(archive), file_(file) {}
-
-   Status status() const {
-     return status_;
-   }
-
- protected:
-   int underflow() override {
-      zip_int64_t nbytes = zip_fread(file_, &buf_, bufsiz_);
-      if (nbytes == -1) {
-        status_ = UnknownErrorBuilder()
-            << "Zipped read failed: " << zip_strerror(archive_);
-        setg(nullptr, nullptr, nullptr);
-        return traits_type::eof();
-      }
-      setg(buf_, buf_, buf_ + nbytes);
-      if (nbytes == 0) {
-        return traits_type::eof();
-      }
-      return traits_type::to_int_type(buf_[0]);
-   }
-
- private:
-   zip_t *archive_;
-   zip_file_t *file_;
-   static constexpr int bufsiz_ = 4096;
-   char buf_[bufsiz_];
-   Status status_;
-};
-
-class RedumpFetcher {
- public:
-  RedumpFetcher() : curl_(CurlEasyInit()) {
-    if (absl::GetFlag(FLAGS_verbose)) {
-      CHECK_OK(CurlEasySetopt(curl_.get(), CURLOPT_VERBOSE, true));
-    }
-
-    CHECK_OK(url_.SetURL("http://redump.org"));
-    CHECK_OK(CurlEasySetopt(curl_.get(), CURLOPT_CURLU, url_.GetCURLU()));
-  }
+using ::rhutil::UnknownErrorBuilder;
 
-  StatusOr<RomDat> GetRomDat(std::string_view console) {
-    ASSIGN_OR_RETURN(
-        std::stringstream strm,
-        Get(absl::StrFormat("/datfile/%s/serial,version", console)));
-
-    ZipError error;
-    zip_source_t *source = zip_source_buffer_create(
-        strm.str().data(), strm.str().size(), /*freep=*/false, error.ptr());
-    if (source == nullptr) {
-      return UnknownErrorBuilder()
-          << "Failed to create a zip source: "
-          << zip_error_strerror(error.ptr());
-    }
-
-    // zip_open_from_source takes ownership of "source" unless it errors.
-    std::unique_ptr<zip_t, ZipDiscard> archive(
-        zip_open_from_source(source, ZIP_RDONLY, error.ptr()));
-    if (archive == nullptr) {
-      zip_source_free(source);
-      return UnknownErrorBuilder()
-          << "Failed to create a zip source: "
-          << zip_error_strerror(error.ptr());
-    }
-
-    if (zip_int64_t entries = zip_get_num_entries(archive.get(), /*flags=*/0);
-        entries != 1) {
-      return UnknownErrorBuilder()
-          << "Expected only one entry in zip archive. Found " << entries;
-    }
-
-    std::unique_ptr<zip_file_t, ZipFClose> file(
-        zip_fopen_index(archive.get(), /*index=*/0, /*flags=*/0));
-    if (file == nullptr) {
-      return UnknownErrorBuilder()
-          << "Failed to open zipped file 0: " << zip_strerror(archive.get());
-    }
-
-    ZipFileStreambuf zipstrm(archive.get(), file.get());
-    std::istream unzipped(&zipstrm);
-    auto dat_or = dat2pb::ParseRomDat(&unzipped);
-    if (auto sb = zipstrm.status(); !sb.ok()) return sb;
-    return dat_or;
-  }
+constexpr char kUsageMessage[] = R"(Usage: roman fetch [options] console...
 
- private:
-  StatusOr<std::stringstream> Get(absl::string_view path) {
-    url_.SetPath(path);
-
-    std::stringstream strm;
-    RETURN_IF_ERROR(CurlEasySetWriteCallback(
-          curl_.get(),
-          [&strm](std::string_view data, size_t*) -> Status {
-            strm << data;
-            if (strm.bad()) {
-              return UnknownError("Failed to write into stream.");
-            }
-            return OkStatus();
-          }));
-
-    RETURN_IF_ERROR(CurlEasyPerform(curl_.get()));
-    return std::move(strm);
-  }
+Fetch datpbs from redump.org. Given a single console, writes its datpb to
+stdout. Given several, or --all for every console redump has, writes each to
+<console>.datpb in --output_dir.
 
-  std::unique_ptr<CURL, CurlHandleDeleter> curl_;
-  CurlURL url_;
-};
+Several dats are downloaded at once over up to --fetch_connections
+connections. Each is unzipped and parsed on one of --parse_threads threads
+while it downloads, and written out as soon as it is complete. A console which
+fails doesn't stop the others.
 
-constexpr char kUsageMessage[] = R"(Usage: roman fetch [options] console
+With --binary --chunked, the datpb is written as independently parseable
+chunks of --chunk_size games, which every reader parses in parallel. Readers
+accept both kinds of datpb.
 
-Fetch a datpb from redump.org. Writes the binary datpb to stdout.
+Fetched dats are kept in --dat_cache along with their ETag and Last-Modified
+headers. Fetching a dat again asks redump whether it changed, and if it
+didn't, the cached datpb is used without downloading or parsing anything.
 
 The console argument must be a valid console as listed at
 http://redump.org/downloads/. It is the system part of the datfile URL, so if
 the URL to download "Commodore Amiga CD" is http://redump.org/datfile/acd/, the
 correct argument is "acd".
 
-Also see rclone --help for additional options.
-
 Example usage:
-$ roman fetch ps2 > ps2.datpb)";
+$ roman fetch ps2 > ps2.datpb
+$ roman fetch --binary --output_dir=dats ps2 psx acd
+$ roman fetch --binary --all --output_dir=dats)";
 
 Status SubCommandFetch(absl::Span<std::string_view> args) {
-  if (args.size() != 2) {
+  bool all = absl::GetFlag(FLAGS_all);
+  if (args.size() < 2 && !all) {
     return InvalidArgumentError(kUsageMessage);
   }
-  std::string_view console(args[1]);
+  if (all && args.size() > 1) {
+    return InvalidArgumentError("Either give consoles or --all, not both");
+  }
+  std::vector<std::string> consoles(args.begin() + 1, args.end());
+  std::string output_dir = absl::GetFlag(FLAGS_output_dir);
+  if ((all || consoles.size() > 1) && output_dir.empty()) {
+    return InvalidArgumentError(
+        "Fetching several consoles needs an --output_dir");
+  }
 
   RETURN_IF_ERROR(rhutil::CurlGlobalInit());
 
-  ASSIGN_OR_RETURN(RomDat dat, RedumpFetcher().GetRomDat(console));
-  RETURN_IF_ERROR(PrintProto(dat, &std::cout));
+  std::optional<DatCache> cache;
+  if (absl::GetFlag(FLAGS_use_dat_cache)) {
+    std::string dir = absl::GetFlag(FLAGS_dat_cache);
+    cache.emplace(dir.empty() ? DatCache::DefaultPath() : dir);
+  }
+  RedumpFetcher::Options opts;
+  opts.url = absl::GetFlag(FLAGS_redump_url);
+  opts.cache = cache ? &cache.value() : nullptr;
+  opts.max_connections = absl::GetFlag(FLAGS_fetch_connections);
+  opts.parse_threads = absl::GetFlag(FLAGS_parse_threads);
+  if (opts.parse_threads <= 0) {
+    opts.parse_threads = std::thread::hardware_concurrency();
+  }
+  opts.verbose = absl::GetFlag(FLAGS_verbose);
+  RedumpFetcher fetcher(opts);
+
+  if (output_dir.empty()) {
+    ASSIGN_OR_RETURN(RomDat dat, fetcher.GetRomDat(consoles[0]));
+    return PrintDatPB(&dat, &std::cout);
+  }
 
+  if (all) {
+    ASSIGN_OR_RETURN(consoles, fetcher.ListConsoles());
+  }
+  RETURN_IF_ERROR(MakeParentDirs(absl::StrCat(output_dir, "/")));
+  int failed = 0;
+  RETURN_IF_ERROR(fetcher.GetRomDats(
+      consoles, [&](std::string_view console, StatusOr<RomDat> dat) -> Status {
+        std::string path = absl::StrCat(output_dir, "/", console, ".datpb");
+        Status status = dat.status();
+        if (status.ok()) {
+          std::ofstream out(path, std::ios::binary | std::ios::trunc);
+          status = PrintDatPB(&dat.value(), &out);
+          if (status.ok() && !out.flush()) {
+            status = UnknownErrorBuilder() << "Failed to write " << path;
+          }
+        }
+        if (!status.ok()) {
+          failed++;
+          std::cerr << console << ": " << status << std::endl;
+          return OkStatus();
+        }
+        std::cerr << "Wrote " << dat->game_size() << " games to " << path
+                  << std::endl;
+        return OkStatus();
+      }));
+  if (failed > 0) {
+    return UnknownErrorBuilder()
+        << "Failed to fetch " << failed << " of " << consoles.size()
+        << " consoles";
+  }
   return OkStatus();
 }
 
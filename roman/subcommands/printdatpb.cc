@@ -6,12 +6,12 @@
 #include <fstream>
 
 #include "rhutil/file.h"
-#include "google/protobuf/io/zero_copy_stream_impl.h"
-#include "google/protobuf/text_format.h"
 #include "rhutil/module_init.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/types/span.h"
+#include "roman/print_proto.h"
+#include "roman/proto_file.h"
 #include "roman/subcommands/subcommands.h"
 #include "rhutil/status.h"
 #include "dat2pb/romdat.pb.h"
@@ -28,30 +28,17 @@ using ::rhutil::UnknownErrorBuilder;
 using ::rhutil::UnknownError;
 using ::rhutil::InvalidArgumentError;
 using ::rhutil::InvalidArgumentErrorBuilder;
-using ::rhutil::OpenInputFile;
-using ::google::protobuf::io::OstreamOutputStream;
-using ::google::protobuf::TextFormat;
 
 Status SubCommandPrintDatPB(absl::Span<std::string_view> args) {
   if (args.size() != 2) {
-    return InvalidArgumentError("Usage: roman printdatpb datpb");
+    return InvalidArgumentError(
+        "Usage: roman printdatpb [--output_format=tsv|jsonl] datpb");
   }
   std::string_view datpb(args[1]);
 
-  RomDat dat;
-  {
-    ASSIGN_OR_RETURN(std::ifstream datpb_in, OpenInputFile(datpb));
-    if (!dat.ParseFromIstream(&datpb_in)) {
-      return UnknownErrorBuilder() << "Failed to read romdat from " << datpb;
-    }
-  }
-
-  OstreamOutputStream strm(&std::cout);
-  if (!TextFormat::Print(dat, &strm)) {
-    return UnknownError("Failed to write romdat textproto to stdout");
-  }
+  ASSIGN_OR_RETURN(ArenaMessage<RomDat> dat, LoadProtoFile<RomDat>(datpb));
 
-  return OkStatus();
+  return PrintProto(*dat, &std::cout);
 }
 
 static void Initialize() {
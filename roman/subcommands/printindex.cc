@@ -0,0 +1,78 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "absl/flags/flag.h"
+#include "absl/types/span.h"
+#include "rhutil/module_init.h"
+#include "rhutil/status.h"
+#include "roman/game_writer.h"
+#include "roman/index/game_index.pb.h"
+#include "roman/index/index_reader.h"
+#include "roman/print_proto.h"
+#include "roman/proto_file.h"
+#include "roman/proto_stream.h"
+#include "roman/subcommands/subcommands.h"
+
+namespace roman {
+namespace {
+
+using ::rhutil::InvalidArgumentError;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+
+constexpr char kUsageMessage[] = R"(Usage: roman printindex [options] index
+
+Print a binary game index, as written by roman index --binary, or - to read it
+from stdin.
+
+The index is read and printed one game at a time, so that printing starts
+right away and memory use stays flat however large the index is. By default
+it is printed as a textproto. --output_format=tsv prints a line per ROM, and
+--output_format=jsonl a line per game, for grep, awk or jq:
+
+$ roman printindex --output_format=tsv pce.index | awk -F'\t' '$7 == ""'
+$ roman printindex --output_format=jsonl pce.index | jq 'select(.complete)'
+
+With --binary, the index is instead rewritten as a binary proto, e.g. to
+compress it with --compress.)";
+
+Status SubCommandPrintIndex(absl::Span<std::string_view> args) {
+  if (args.size() != 2) {
+    return InvalidArgumentError(kUsageMessage);
+  }
+  std::string_view indexpb(args[1]);
+
+  ASSIGN_OR_RETURN(std::optional<GameWriter::Format> format,
+                   GameFormatFromFlags());
+  if (format) {
+    GameWriter writer(STDOUT_FILENO, *format);
+    RETURN_IF_ERROR(ReadGameIndex(indexpb, [&](GameIndex::Game game) {
+      writer.Write(game);
+      return OkStatus();
+    }));
+    return writer.Flush();
+  }
+
+  ASSIGN_OR_RETURN(std::unique_ptr<ProtoOutput> output,
+                   ProtoOutput::Create(&std::cout));
+  RepeatedFieldWriter writer(
+      output->stream(),
+      GameIndex::descriptor()->FindFieldByNumber(GameIndex::kGameFieldNumber),
+      absl::GetFlag(FLAGS_binary));
+  RETURN_IF_ERROR(ReadGameIndex(indexpb, [&](GameIndex::Game game) {
+    return writer.Write(game);
+  }));
+  return output->Finish();
+}
+
+static void Initialize() {
+  SubCommands::Instance()->Add("printindex", &SubCommandPrintIndex);
+}
+rhutil::ModuleInit module_init(&Initialize);
+
+}  // namespace
+}  // namespace roman
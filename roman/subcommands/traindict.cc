@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/types/span.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/module_init.h"
+#include "rhutil/status.h"
+#include "roman/proto_file.h"
+#include "roman/subcommands/subcommands.h"
+#include "roman/util/zstd_stream.h"
+
+ABSL_FLAG(int64_t, dictionary_size, 112640,
+          "The largest dictionary to train, in bytes.");
+
+namespace roman {
+namespace {
+
+using ::dat2pb::RomDat;
+using ::rhutil::InvalidArgumentError;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::UnknownError;
+
+constexpr char kUsageMessage[] = R"(Usage: roman traindict [options] datpb...
+
+Train a zstd dictionary on a corpus of datpbs. Writes the dictionary to
+stdout.
+
+Small datpbs and game indexes compress poorly on their own, since zstd has
+little repetition to learn from. A dictionary trained on many of them holds
+the structure they share, so that each compresses nearly as well as the whole
+corpus would. Pass it with --zstd_dictionary to any command writing with
+--compress, and to every command reading what those wrote.
+
+Each game of each datpb is a training sample, which suits datpbs and binary
+indexes alike, as both are made of one record per game.
+
+Example usage:
+$ roman traindict *.datpb > redump.dict
+$ roman fetch --binary --compress --zstd_dictionary=redump.dict pce \
+    > pce.datpb)";
+
+Status SubCommandTrainDict(absl::Span<std::string_view> args) {
+  if (args.size() < 2) {
+    return InvalidArgumentError(kUsageMessage);
+  }
+
+  std::vector<std::string> samples;
+  for (std::string_view datpb : args.subspan(1)) {
+    RomDat dat;
+    RETURN_IF_ERROR(ReadProtoFile(datpb, &dat));
+    for (const RomDat::Game &game : dat.game()) {
+      samples.push_back(game.SerializeAsString());
+    }
+  }
+  std::cerr << "Training on " << samples.size() << " games" << std::endl;
+
+  ASSIGN_OR_RETURN(std::string dictionary,
+                   TrainZstdDictionary(
+                       samples, absl::GetFlag(FLAGS_dictionary_size)));
+  if (!std::cout.write(dictionary.data(), dictionary.size()).flush()) {
+    return UnknownError("Failed to write dictionary to stdout");
+  }
+  std::cerr << "Wrote a " << dictionary.size() << " byte dictionary"
+            << std::endl;
+  return OkStatus();
+}
+
+static void Initialize() {
+  SubCommands::Instance()->Add("traindict", &SubCommandTrainDict);
+}
+rhutil::ModuleInit module_init(&Initialize);
+
+}  // namespace
+}  // namespace roman
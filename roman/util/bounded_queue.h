@@ -0,0 +1,83 @@
+#ifndef ROMAN_UTIL_BOUNDED_QUEUE_H_
+#define ROMAN_UTIL_BOUNDED_QUEUE_H_
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+namespace roman {
+
+// A thread-safe FIFO holding at most `capacity` items, for handing work
+// between pipeline stages. Push blocks while the queue is full, so that a fast
+// producer can't run arbitrarily far ahead of its consumer.
+template <typename T>
+class BoundedQueue {
+ public:
+  enum class TryPushResult { kPushed, kFull, kClosed };
+
+  explicit BoundedQueue(std::size_t capacity)
+      : capacity_(capacity > 0 ? capacity : 1) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  // Returns false, dropping `item`, if the queue has been closed.
+  bool Push(T item) {
+    absl::MutexLock lock(&mu_);
+    while (items_.size() >= capacity_ && !closed_) cv_.Wait(&mu_);
+    if (closed_) return false;
+    items_.push_back(std::move(item));
+    cv_.SignalAll();
+    return true;
+  }
+
+  // Like Push, but never blocks. `item` is only moved from if it was pushed,
+  // for producers which must not wait (e.g. an event loop) and retry later.
+  TryPushResult TryPush(T *item) {
+    absl::MutexLock lock(&mu_);
+    if (closed_) return TryPushResult::kClosed;
+    if (items_.size() >= capacity_) return TryPushResult::kFull;
+    items_.push_back(std::move(*item));
+    cv_.SignalAll();
+    return TryPushResult::kPushed;
+  }
+
+  // Whether Push would block. With several producers, only a hint.
+  bool Full() const {
+    absl::MutexLock lock(&mu_);
+    return items_.size() >= capacity_ && !closed_;
+  }
+
+  // Blocks until an item is available. Returns nullopt once the queue is
+  // closed and drained.
+  std::optional<T> Pop() {
+    absl::MutexLock lock(&mu_);
+    while (items_.empty() && !closed_) cv_.Wait(&mu_);
+    if (items_.empty()) return std::nullopt;
+    T item = std::move(items_.front());
+    items_.pop_front();
+    cv_.SignalAll();
+    return item;
+  }
+
+  // Wakes every waiter. Subsequent Pushes fail, and Pops drain what is left.
+  void Close() {
+    absl::MutexLock lock(&mu_);
+    closed_ = true;
+    cv_.SignalAll();
+  }
+
+ private:
+  const std::size_t capacity_;
+  mutable absl::Mutex mu_;
+  absl::CondVar cv_;
+  std::deque<T> items_ GUARDED_BY(mu_);
+  bool closed_ GUARDED_BY(mu_) = false;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_BOUNDED_QUEUE_H_
@@ -0,0 +1,87 @@
+#include "roman/util/dirs.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+Status ListFilesUnder(const std::string &root, const std::string &prefix,
+                      std::vector<std::string> *files) {
+  std::string dir = prefix.empty() ? root : absl::StrCat(root, "/", prefix);
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) {
+    return UnknownErrorBuilder()
+        << "opendir " << dir << ": " << std::strerror(errno);
+  }
+  std::vector<std::string> subdirs;
+  while (struct dirent *entry = readdir(d)) {
+    std::string_view name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    std::string path =
+        prefix.empty() ? std::string(name) : absl::StrCat(prefix, "/", name);
+    // Symlinks to files are followed, but not ones to directories, which
+    // could loop.
+    std::string full = absl::StrCat(root, "/", path);
+    struct stat st;
+    if (lstat(full.c_str(), &st) == -1) continue;
+    if (S_ISDIR(st.st_mode)) {
+      subdirs.push_back(std::move(path));
+    } else if (stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      files->push_back(std::move(path));
+    }
+  }
+  closedir(d);
+  for (const std::string &subdir : subdirs) {
+    RETURN_IF_ERROR(ListFilesUnder(root, subdir, files));
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+Status MakeParentDirs(std::string_view path) {
+  std::vector<std::string_view> parts = absl::StrSplit(path, '/');
+  parts.pop_back();
+  std::string dir;
+  for (std::string_view part : parts) {
+    absl::StrAppend(&dir, part, "/");
+    if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+      return UnknownErrorBuilder()
+          << "mkdir " << dir << ": " << std::strerror(errno);
+    }
+  }
+  return OkStatus();
+}
+
+StatusOr<std::vector<std::string>> ListFiles(std::string_view dir) {
+  std::vector<std::string> files;
+  RETURN_IF_ERROR(ListFilesUnder(std::string(dir), "", &files));
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::string UserCachePath(std::string_view name) {
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return absl::StrCat(xdg, "/roman/", name);
+  }
+  const char *home = std::getenv("HOME");
+  return absl::StrCat(home ? home : ".", "/.cache/roman/", name);
+}
+
+}  // namespace roman
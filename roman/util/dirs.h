@@ -0,0 +1,24 @@
+#ifndef ROMAN_UTIL_DIRS_H_
+#define ROMAN_UTIL_DIRS_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rhutil/status.h"
+
+namespace roman {
+
+// Creates every missing parent directory of `path`.
+rhutil::Status MakeParentDirs(std::string_view path);
+
+// The paths of the regular files under `dir`, recursively, relative to it and
+// sorted.
+rhutil::StatusOr<std::vector<std::string>> ListFiles(std::string_view dir);
+
+// `name` under $XDG_CACHE_HOME/roman, or ~/.cache/roman.
+std::string UserCachePath(std::string_view name);
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_DIRS_H_
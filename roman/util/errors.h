@@ -25,6 +25,7 @@ enum Error : int {
   ERR_OS = EX_OSERR,
   ERR_FLAC = 111,
   ERR_OPENSSL = 112,
+  ERR_ZSTD = 113,
 };
 
 }  // namespace roman
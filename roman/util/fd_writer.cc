@@ -0,0 +1,62 @@
+#include "roman/util/fd_writer.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace roman {
+
+using ::rhutil::Status;
+using ::rhutil::UnknownErrorBuilder;
+
+FdWriter::FdWriter(int fd, std::size_t buffer_size)
+    : fd_(fd), buffer_(buffer_size) {}
+
+FdWriter::~FdWriter() { (void)Flush(); }
+
+void FdWriter::Append(std::string_view data) {
+  if (data.size() > buffer_.size() - size_) {
+    FlushBuffer();
+    // Too large to be worth buffering.
+    if (data.size() >= buffer_.size()) {
+      WriteAll(data);
+      return;
+    }
+  }
+  std::memcpy(buffer_.data() + size_, data.data(), data.size());
+  size_ += data.size();
+}
+
+void FdWriter::AppendInt(std::int64_t value) {
+  char digits[24];
+  std::to_chars_result result =
+      std::to_chars(digits, digits + sizeof(digits), value);
+  Append(std::string_view(digits, result.ptr - digits));
+}
+
+Status FdWriter::Flush() {
+  FlushBuffer();
+  return status_;
+}
+
+void FdWriter::FlushBuffer() {
+  WriteAll(std::string_view(buffer_.data(), size_));
+  size_ = 0;
+}
+
+void FdWriter::WriteAll(std::string_view data) {
+  while (!data.empty() && status_.ok()) {
+    ssize_t written = write(fd_, data.data(), data.size());
+    if (written == -1) {
+      if (errno == EINTR) continue;
+      status_ = UnknownErrorBuilder()
+          << "Failed to write output: " << std::strerror(errno);
+      return;
+    }
+    data.remove_prefix(written);
+  }
+}
+
+}  // namespace roman
@@ -0,0 +1,48 @@
+#ifndef ROMAN_UTIL_FD_WRITER_H_
+#define ROMAN_UTIL_FD_WRITER_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "rhutil/status.h"
+
+namespace roman {
+
+// Buffers output to a file descriptor, writing it out with write(2) whenever
+// the buffer fills, without the locale and formatting machinery of iostreams.
+//
+// Errors are sticky: once a write fails, later ones are dropped, and the
+// error is returned by Flush.
+class FdWriter {
+ public:
+  explicit FdWriter(int fd, std::size_t buffer_size = 1 << 16);
+  // Flushes, ignoring errors.
+  ~FdWriter();
+
+  FdWriter(const FdWriter &) = delete;
+  FdWriter &operator=(const FdWriter &) = delete;
+
+  void Append(std::string_view data);
+  void Append(char c) {
+    if (size_ == buffer_.size()) FlushBuffer();
+    buffer_[size_++] = c;
+  }
+  void AppendInt(std::int64_t value);
+
+  // Writes out everything buffered.
+  rhutil::Status Flush();
+
+ private:
+  void FlushBuffer();
+  void WriteAll(std::string_view data);
+
+  const int fd_;
+  std::vector<char> buffer_;
+  std::size_t size_ = 0;
+  rhutil::Status status_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_FD_WRITER_H_
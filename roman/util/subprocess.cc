@@ -0,0 +1,152 @@
+#include "roman/util/subprocess.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+constexpr std::size_t kReadSize = 64 << 10;
+
+}  // namespace
+
+StatusOr<std::unique_ptr<Subprocess>> Subprocess::Start(
+    const std::vector<std::string> &argv) {
+  if (argv.empty()) {
+    return UnknownErrorBuilder() << "No program to start";
+  }
+  std::vector<char *> args;
+  for (const std::string &arg : argv) {
+    args.push_back(const_cast<char *>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1) {
+    return UnknownErrorBuilder() << "pipe: " << std::strerror(errno);
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+
+  pid_t pid;
+  int err = posix_spawnp(&pid, args[0], &actions, /*attrp=*/nullptr,
+                         args.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if (err != 0) {
+    close(fds[0]);
+    return UnknownErrorBuilder()
+        << "Failed to start " << argv[0] << ": " << std::strerror(err);
+  }
+  return std::unique_ptr<Subprocess>(new Subprocess(argv[0], pid, fds[0]));
+}
+
+Subprocess::~Subprocess() {
+  if (pid_ != -1) Kill();
+  if (stdout_fd_ != -1) close(stdout_fd_);
+}
+
+StatusOr<bool> Subprocess::Fill() {
+  if (stdout_fd_ == -1) return false;
+  // Drop what has been consumed, so that the buffer only ever holds about one
+  // line.
+  buf_.erase(0, buf_pos_);
+  buf_pos_ = 0;
+  std::size_t size = buf_.size();
+  buf_.resize(size + kReadSize);
+  ssize_t n;
+  do {
+    n = read(stdout_fd_, &buf_[size], kReadSize);
+  } while (n == -1 && errno == EINTR);
+  if (n == -1) {
+    buf_.resize(size);
+    return UnknownErrorBuilder()
+        << "Failed to read from " << name_ << ": " << std::strerror(errno);
+  }
+  buf_.resize(size + n);
+  return n > 0;
+}
+
+StatusOr<bool> Subprocess::ReadLine(std::string *line) {
+  while (true) {
+    std::size_t newline = buf_.find('\n', buf_pos_);
+    if (newline != std::string::npos) {
+      line->assign(buf_, buf_pos_, newline - buf_pos_);
+      buf_pos_ = newline + 1;
+      return true;
+    }
+    ASSIGN_OR_RETURN(bool more, Fill());
+    if (more) continue;
+    if (buf_pos_ == buf_.size()) return false;
+    // The last line had no newline.
+    line->assign(buf_, buf_pos_, std::string::npos);
+    buf_pos_ = buf_.size();
+    return true;
+  }
+}
+
+StatusOr<std::string> Subprocess::ReadAll() {
+  while (true) {
+    ASSIGN_OR_RETURN(bool more, Fill());
+    if (!more) break;
+  }
+  std::string out = buf_.substr(buf_pos_);
+  buf_.clear();
+  buf_pos_ = 0;
+  return out;
+}
+
+Status Subprocess::Wait() {
+  if (stdout_fd_ != -1) {
+    close(stdout_fd_);
+    stdout_fd_ = -1;
+  }
+  if (pid_ == -1) return OkStatus();
+  int wstatus;
+  pid_t pid;
+  do {
+    pid = waitpid(pid_, &wstatus, 0);
+  } while (pid == -1 && errno == EINTR);
+  pid_ = -1;
+  if (pid == -1) {
+    return UnknownErrorBuilder() << "waitpid: " << std::strerror(errno);
+  }
+  if (WIFSIGNALED(wstatus)) {
+    return UnknownErrorBuilder()
+        << name_ << " was killed by signal " << WTERMSIG(wstatus);
+  }
+  exit_status_ = WEXITSTATUS(wstatus);
+  if (exit_status_ != 0) {
+    return UnknownErrorBuilder()
+        << name_ << " exited with status " << exit_status_;
+  }
+  return OkStatus();
+}
+
+void Subprocess::Kill() {
+  if (pid_ == -1) return;
+  kill(pid_, SIGTERM);
+  // Having been killed, its exit status says nothing.
+  (void)Wait();
+}
+
+}  // namespace roman
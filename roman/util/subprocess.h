@@ -0,0 +1,63 @@
+#ifndef ROMAN_UTIL_SUBPROCESS_H_
+#define ROMAN_UTIL_SUBPROCESS_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "rhutil/status.h"
+
+namespace roman {
+
+// A child process whose stdout is read through a pipe. Its stdin is
+// /dev/null, and its stderr is inherited.
+class Subprocess {
+ public:
+  // Starts argv[0], searching $PATH if it contains no slash.
+  static rhutil::StatusOr<std::unique_ptr<Subprocess>> Start(
+      const std::vector<std::string> &argv);
+
+  // Kills the child if it is still running.
+  ~Subprocess();
+
+  Subprocess(const Subprocess &) = delete;
+  Subprocess &operator=(const Subprocess &) = delete;
+
+  // Reads the next line of stdout into `line`, without its newline. Returns
+  // false at the end of stdout.
+  rhutil::StatusOr<bool> ReadLine(std::string *line);
+
+  // Reads the rest of stdout.
+  rhutil::StatusOr<std::string> ReadAll();
+
+  // Closes stdout and waits for the child to exit. Returns an error unless it
+  // exited successfully.
+  rhutil::Status Wait();
+
+  // Terminates the child and waits for it.
+  void Kill();
+
+  // The child's exit status once Wait has returned, or -1 if it hasn't, or
+  // the child was killed by a signal.
+  int exit_status() const { return exit_status_; }
+
+ private:
+  Subprocess(std::string name, pid_t pid, int stdout_fd)
+      : name_(std::move(name)), pid_(pid), stdout_fd_(stdout_fd) {}
+
+  // Reads more of stdout into buf_. Returns false at the end of stdout.
+  rhutil::StatusOr<bool> Fill();
+
+  const std::string name_;
+  pid_t pid_;
+  int stdout_fd_;
+  std::string buf_;
+  std::size_t buf_pos_ = 0;
+  int exit_status_ = -1;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_SUBPROCESS_H_
@@ -0,0 +1,53 @@
+#include "roman/util/thread_pool.h"
+
+#include <utility>
+
+namespace roman {
+
+ThreadPool::ThreadPool(int num_threads) {
+  if (num_threads < 1) num_threads = 1;
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&ThreadPool::Work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+    work_cv_.SignalAll();
+  }
+  for (std::thread &thread : threads_) thread.join();
+}
+
+void ThreadPool::Schedule(std::function<void()> fn) {
+  absl::MutexLock lock(&mu_);
+  queue_.push_back(std::move(fn));
+  work_cv_.Signal();
+}
+
+void ThreadPool::Wait() {
+  absl::MutexLock lock(&mu_);
+  while (!queue_.empty() || running_ > 0) idle_cv_.Wait(&mu_);
+}
+
+void ThreadPool::Work() {
+  while (true) {
+    std::function<void()> fn;
+    {
+      absl::MutexLock lock(&mu_);
+      while (queue_.empty() && !stopping_) work_cv_.Wait(&mu_);
+      // Drain the queue before stopping.
+      if (queue_.empty()) return;
+      fn = std::move(queue_.front());
+      queue_.pop_front();
+      running_++;
+    }
+    fn();
+    absl::MutexLock lock(&mu_);
+    if (--running_ == 0 && queue_.empty()) idle_cv_.SignalAll();
+  }
+}
+
+}  // namespace roman
@@ -0,0 +1,45 @@
+#ifndef ROMAN_UTIL_THREAD_POOL_H_
+#define ROMAN_UTIL_THREAD_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace roman {
+
+// A fixed set of threads running scheduled closures in FIFO order.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+
+  // Waits for all scheduled closures to finish.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void Schedule(std::function<void()> fn);
+
+  // Blocks until every closure scheduled so far has finished.
+  void Wait();
+
+  int num_threads() const { return threads_.size(); }
+
+ private:
+  void Work();
+
+  absl::Mutex mu_;
+  absl::CondVar work_cv_;
+  absl::CondVar idle_cv_;
+  std::deque<std::function<void()>> queue_ GUARDED_BY(mu_);
+  int running_ GUARDED_BY(mu_) = 0;
+  bool stopping_ GUARDED_BY(mu_) = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_THREAD_POOL_H_
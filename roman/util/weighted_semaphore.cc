@@ -0,0 +1,24 @@
+#include "roman/util/weighted_semaphore.h"
+
+#include <algorithm>
+
+namespace roman {
+
+WeightedSemaphore::WeightedSemaphore(std::int64_t capacity)
+    : capacity_(std::max<std::int64_t>(capacity, 1)), available_(capacity_) {}
+
+std::int64_t WeightedSemaphore::Acquire(std::int64_t weight) {
+  weight = std::clamp<std::int64_t>(weight, 0, capacity_);
+  absl::MutexLock lock(&mu_);
+  while (available_ < weight) cv_.Wait(&mu_);
+  available_ -= weight;
+  return weight;
+}
+
+void WeightedSemaphore::Release(std::int64_t weight) {
+  absl::MutexLock lock(&mu_);
+  available_ += weight;
+  cv_.SignalAll();
+}
+
+}  // namespace roman
@@ -0,0 +1,38 @@
+#ifndef ROMAN_UTIL_WEIGHTED_SEMAPHORE_H_
+#define ROMAN_UTIL_WEIGHTED_SEMAPHORE_H_
+
+#include <cstdint>
+
+#include "absl/synchronization/mutex.h"
+
+namespace roman {
+
+// A counting semaphore whose holders take varying amounts of a shared
+// capacity, e.g. bytes in flight.
+//
+// Requests larger than the capacity are clamped to it, so that they run alone
+// rather than never running at all.
+class WeightedSemaphore {
+ public:
+  explicit WeightedSemaphore(std::int64_t capacity);
+
+  WeightedSemaphore(const WeightedSemaphore &) = delete;
+  WeightedSemaphore &operator=(const WeightedSemaphore &) = delete;
+
+  // Blocks until `weight` is available, and takes it. Returns the weight
+  // actually taken, which must be passed to Release.
+  std::int64_t Acquire(std::int64_t weight);
+  void Release(std::int64_t weight);
+
+  std::int64_t capacity() const { return capacity_; }
+
+ private:
+  const std::int64_t capacity_;
+  absl::Mutex mu_;
+  absl::CondVar cv_;
+  std::int64_t available_ GUARDED_BY(mu_);
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_WEIGHTED_SEMAPHORE_H_
@@ -0,0 +1,41 @@
+#include "roman/util/zip_archive.h"
+
+namespace roman {
+
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownErrorBuilder;
+
+StatusOr<ZipPtr> OpenZipBuffer(std::string_view data) {
+  ZipError error;
+  zip_source_t *source = zip_source_buffer_create(
+      data.data(), data.size(), /*freep=*/false, error.ptr());
+  if (source == nullptr) {
+    return UnknownErrorBuilder()
+        << "Failed to create a zip source: "
+        << zip_error_strerror(error.ptr());
+  }
+
+  // zip_open_from_source takes ownership of "source" unless it errors.
+  ZipPtr archive(zip_open_from_source(source, ZIP_RDONLY, error.ptr()));
+  if (archive == nullptr) {
+    zip_source_free(source);
+    return UnknownErrorBuilder()
+        << "Failed to open zip: " << zip_error_strerror(error.ptr());
+  }
+  return archive;
+}
+
+ZipFileStreambuf::int_type ZipFileStreambuf::underflow() {
+  if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+  zip_int64_t nbytes = zip_fread(file_, buf_.data(), buf_.size());
+  if (nbytes == -1) {
+    status_ = UnknownErrorBuilder()
+        << "Zipped read failed: " << zip_strerror(archive_);
+    return traits_type::eof();
+  }
+  if (nbytes == 0) return traits_type::eof();
+  setg(buf_.data(), buf_.data(), buf_.data() + nbytes);
+  return traits_type::to_int_type(*gptr());
+}
+
+}  // namespace roman
@@ -0,0 +1,75 @@
+#ifndef ROMAN_UTIL_ZIP_ARCHIVE_H_
+#define ROMAN_UTIL_ZIP_ARCHIVE_H_
+
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <string_view>
+#include <vector>
+
+#include "rhutil/status.h"
+#include "zip.h"
+
+namespace roman {
+
+// Helpers for reading zip archives with libzip.
+
+class ZipDiscard {
+ public:
+  void operator()(zip_t *archive) {
+    zip_discard(archive);
+  }
+};
+
+class ZipFClose {
+ public:
+  void operator()(zip_file_t *file) {
+    zip_fclose(file);
+  }
+};
+
+using ZipPtr = std::unique_ptr<zip_t, ZipDiscard>;
+using ZipFilePtr = std::unique_ptr<zip_file_t, ZipFClose>;
+
+class ZipError {
+ public:
+  ZipError() {
+    zip_error_init(&error_);
+  }
+
+  ~ZipError() {
+    zip_error_fini(&error_);
+  }
+
+  zip_error_t *ptr() { return &error_; }
+
+ private:
+  zip_error_t error_;
+};
+
+// Opens the zip held by `data`, which must outlive it.
+rhutil::StatusOr<ZipPtr> OpenZipBuffer(std::string_view data);
+
+// Inflates an entry of a zip `buffer_size` bytes at a time. A failed read
+// looks like the end of the stream; status() tells it apart.
+class ZipFileStreambuf : public std::streambuf {
+ public:
+  ZipFileStreambuf(zip_t *archive, zip_file_t *file,
+                   std::size_t buffer_size = 1 << 20)
+      : archive_(archive), file_(file), buf_(buffer_size) {}
+
+  const rhutil::Status &status() const { return status_; }
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  zip_t *const archive_;
+  zip_file_t *const file_;
+  std::vector<char> buf_;
+  rhutil::Status status_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_ZIP_ARCHIVE_H_
@@ -0,0 +1,243 @@
+#include "roman/util/zip_entry_stream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "zlib.h"
+
+namespace roman {
+
+using ::rhutil::Status;
+using ::rhutil::UnknownError;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+constexpr std::uint32_t kLocalFileHeaderSignature = 0x04034b50;
+constexpr std::uint32_t kDataDescriptorSignature = 0x08074b50;
+constexpr int kLocalFileHeaderSize = 30;
+
+constexpr std::uint16_t kFlagEncrypted = 1 << 0;
+// The CRC and sizes follow the data, in a data descriptor.
+constexpr std::uint16_t kFlagDataDescriptor = 1 << 3;
+
+constexpr std::uint16_t kMethodStored = 0;
+constexpr std::uint16_t kMethodDeflated = 8;
+
+// Large, so that whoever reads the stream (e.g. an XML parser) gets big
+// buffers to work on rather than many small ones.
+constexpr std::size_t kOutputBufferSize = 1 << 20;
+
+std::uint16_t Le16(const char *p) {
+  return static_cast<std::uint8_t>(p[0]) |
+         static_cast<std::uint8_t>(p[1]) << 8;
+}
+
+std::uint32_t Le32(const char *p) {
+  return Le16(p) | static_cast<std::uint32_t>(Le16(p + 2)) << 16;
+}
+
+}  // namespace
+
+class ZipEntryInputStream::Buf : public std::streambuf {
+ public:
+  explicit Buf(std::function<bool(std::string *)> source)
+      : source_(std::move(source)), out_(kOutputBufferSize) {}
+
+  ~Buf() override {
+    if (inflating_) inflateEnd(&zstrm_);
+  }
+
+  const Status &status() const { return status_; }
+
+ protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (done_ || !status_.ok()) return traits_type::eof();
+    if (!header_read_ && !ReadHeader()) return traits_type::eof();
+
+    size_t produced = method_ == kMethodStored ? CopyStored() : Inflate();
+    crc_ = crc32(crc_, reinterpret_cast<const Bytef *>(out_.data()), produced);
+    if (done_) CheckTrailer();
+    if (produced == 0) {
+      if (status_.ok() && !done_) {
+        status_ = UnknownError("Truncated zip entry");
+      }
+      return traits_type::eof();
+    }
+    setg(out_.data(), out_.data(), out_.data() + produced);
+    return traits_type::to_int_type(*gptr());
+  }
+
+ private:
+  // Makes sure some input is buffered. Returns false at the end of the
+  // source.
+  bool FillInput() {
+    while (in_pos_ == in_.size()) {
+      in_pos_ = 0;
+      if (!source_(&in_)) {
+        in_.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Reads exactly `size` bytes into `out`, which may be null to skip them.
+  bool ReadExact(char *out, size_t size) {
+    while (size > 0) {
+      if (!FillInput()) return false;
+      size_t n = std::min(size, in_.size() - in_pos_);
+      if (out != nullptr) {
+        std::memcpy(out, in_.data() + in_pos_, n);
+        out += n;
+      }
+      in_pos_ += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  bool ReadHeader() {
+    header_read_ = true;
+    char header[kLocalFileHeaderSize];
+    if (!ReadExact(header, sizeof(header))) {
+      status_ = UnknownError("Truncated zip local file header");
+      return false;
+    }
+    if (Le32(header) != kLocalFileHeaderSignature) {
+      status_ = UnknownError("Not a zip archive");
+      return false;
+    }
+    flags_ = Le16(header + 6);
+    method_ = Le16(header + 8);
+    expected_crc_ = Le32(header + 14);
+    remaining_ = Le32(header + 18);
+    if (flags_ & kFlagEncrypted) {
+      status_ = UnknownError("Encrypted zip entries are not supported");
+      return false;
+    }
+    if (method_ == kMethodStored && (flags_ & kFlagDataDescriptor)) {
+      status_ = UnknownError(
+          "Stored zip entries of unknown size are not supported");
+      return false;
+    }
+    if (method_ != kMethodStored && method_ != kMethodDeflated) {
+      status_ = UnknownErrorBuilder()
+          << "Unsupported zip compression method " << method_;
+      return false;
+    }
+    if (!ReadExact(nullptr, Le16(header + 26) + Le16(header + 28))) {
+      status_ = UnknownError("Truncated zip local file header");
+      return false;
+    }
+    if (method_ == kMethodDeflated) {
+      std::memset(&zstrm_, 0, sizeof(zstrm_));
+      // Negative window bits: raw deflate data, without a zlib header.
+      if (inflateInit2(&zstrm_, -MAX_WBITS) != Z_OK) {
+        status_ = UnknownError("inflateInit2 failed");
+        return false;
+      }
+      inflating_ = true;
+    }
+    return true;
+  }
+
+  size_t CopyStored() {
+    size_t produced = 0;
+    while (produced < out_.size() && remaining_ > 0) {
+      if (!FillInput()) break;
+      size_t n = std::min<size_t>({out_.size() - produced, remaining_,
+                                   in_.size() - in_pos_});
+      std::memcpy(out_.data() + produced, in_.data() + in_pos_, n);
+      in_pos_ += n;
+      remaining_ -= n;
+      produced += n;
+    }
+    if (remaining_ == 0) done_ = true;
+    return produced;
+  }
+
+  size_t Inflate() {
+    zstrm_.next_out = reinterpret_cast<Bytef *>(out_.data());
+    zstrm_.avail_out = out_.size();
+    while (zstrm_.avail_out > 0) {
+      if (!FillInput()) break;
+      zstrm_.next_in =
+          reinterpret_cast<Bytef *>(in_.data() + in_pos_);
+      zstrm_.avail_in = in_.size() - in_pos_;
+      int ret = inflate(&zstrm_, Z_NO_FLUSH);
+      in_pos_ = in_.size() - zstrm_.avail_in;
+      if (ret == Z_STREAM_END) {
+        done_ = true;
+        break;
+      }
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        status_ = UnknownErrorBuilder()
+            << "Corrupt zip entry: "
+            << (zstrm_.msg != nullptr ? zstrm_.msg : "inflate failed");
+        break;
+      }
+    }
+    return out_.size() - zstrm_.avail_out;
+  }
+
+  // Checks the CRC of everything read against the header or, for entries
+  // which have one, the data descriptor following the data.
+  void CheckTrailer() {
+    if (flags_ & kFlagDataDescriptor) {
+      // The descriptor's signature is optional.
+      char descriptor[4];
+      if (!ReadExact(descriptor, sizeof(descriptor))) {
+        status_ = UnknownError("Truncated zip data descriptor");
+        return;
+      }
+      expected_crc_ = Le32(descriptor);
+      if (expected_crc_ == kDataDescriptorSignature) {
+        if (!ReadExact(descriptor, sizeof(descriptor))) {
+          status_ = UnknownError("Truncated zip data descriptor");
+          return;
+        }
+        expected_crc_ = Le32(descriptor);
+      }
+    }
+    if (crc_ != expected_crc_) {
+      status_ = UnknownErrorBuilder()
+          << "Zip entry CRC mismatch: expected " << std::hex << expected_crc_
+          << ", got " << crc_;
+    }
+  }
+
+  std::function<bool(std::string *)> source_;
+  std::string in_;
+  size_t in_pos_ = 0;
+  std::vector<char> out_;
+
+  bool header_read_ = false;
+  std::uint16_t flags_ = 0;
+  std::uint16_t method_ = 0;
+  std::uint32_t expected_crc_ = 0;
+  // Of a stored entry, the bytes left to copy.
+  std::uint32_t remaining_ = 0;
+
+  z_stream zstrm_;
+  bool inflating_ = false;
+  std::uint32_t crc_ = 0;
+  bool done_ = false;
+  Status status_;
+};
+
+ZipEntryInputStream::ZipEntryInputStream(
+    std::function<bool(std::string *)> source)
+    : std::istream(nullptr), buf_(std::make_unique<Buf>(std::move(source))) {
+  rdbuf(buf_.get());
+}
+
+ZipEntryInputStream::~ZipEntryInputStream() = default;
+
+Status ZipEntryInputStream::status() const { return buf_->status(); }
+
+}  // namespace roman
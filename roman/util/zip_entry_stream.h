@@ -0,0 +1,39 @@
+#ifndef ROMAN_UTIL_ZIP_ENTRY_STREAM_H_
+#define ROMAN_UTIL_ZIP_ENTRY_STREAM_H_
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "rhutil/status.h"
+
+namespace roman {
+
+// An istream of the contents of the first entry of a zip archive, which is
+// read front to back from `source` as it arrives. Unlike libzip, which needs
+// the central directory at the end of the archive, the entry is inflated
+// while the rest of the archive is still being downloaded.
+//
+// `source` sets its argument to the next chunk of the archive, and returns
+// false at its end. Whatever follows the first entry is left unread.
+//
+// The entry's CRC-32 is checked once it has been read. A corrupt, truncated
+// or unsupported (e.g. encrypted) entry looks like the end of the stream;
+// status() tells it apart.
+class ZipEntryInputStream : public std::istream {
+ public:
+  explicit ZipEntryInputStream(std::function<bool(std::string *)> source);
+  ~ZipEntryInputStream() override;
+
+  // The error which ended the stream early, if any.
+  rhutil::Status status() const;
+
+ private:
+  class Buf;
+  std::unique_ptr<Buf> buf_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_ZIP_ENTRY_STREAM_H_
@@ -0,0 +1,270 @@
+#include "roman/util/zstd_stream.h"
+
+#include <cstring>
+#include <utility>
+
+#include "zdict.h"
+#include "zstd.h"
+
+namespace roman {
+
+using ::rhutil::InvalidArgumentErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::StatusOr;
+using ::rhutil::UnknownError;
+using ::rhutil::UnknownErrorBuilder;
+
+namespace {
+
+// The first bytes of every zstd frame, 0xFD2FB528 in little endian.
+constexpr char kZstdMagic[] = {'\x28', '\xB5', '\x2F', '\xFD'};
+
+}  // namespace
+
+class ZstdOutputStream::Buf : public std::streambuf {
+ public:
+  Buf(std::ostream *sink, const Options &opts)
+      : sink_(sink), cctx_(ZSTD_createCCtx()), in_(ZSTD_CStreamInSize()),
+        out_(ZSTD_CStreamOutSize()) {
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, opts.level);
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 1);
+    if (!opts.dictionary.empty()) {
+      size_t ret = ZSTD_CCtx_loadDictionary(cctx_, opts.dictionary.data(),
+                                            opts.dictionary.size());
+      if (ZSTD_isError(ret)) {
+        status_ = InvalidArgumentErrorBuilder()
+            << "Invalid zstd dictionary: " << ZSTD_getErrorName(ret);
+      }
+    }
+    setp(in_.data(), in_.data() + in_.size());
+  }
+
+  ~Buf() override { ZSTD_freeCCtx(cctx_); }
+
+  Status Finish() {
+    if (finished_) return status_;
+    finished_ = true;
+    RETURN_IF_ERROR(Compress(ZSTD_e_end));
+    if (!sink_->flush()) {
+      status_ = UnknownError("Failed to write zstd stream");
+    }
+    return status_;
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!Compress(ZSTD_e_continue).ok()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    if (finished_) return status_.ok() ? 0 : -1;
+    if (!Compress(ZSTD_e_flush).ok()) return -1;
+    return sink_->flush() ? 0 : -1;
+  }
+
+ private:
+  // Compresses the buffered input into `sink_`. With ZSTD_e_flush or
+  // ZSTD_e_end, also everything zstd buffered internally.
+  Status Compress(ZSTD_EndDirective mode) {
+    RETURN_IF_ERROR(status_);
+    if (finished_ && mode != ZSTD_e_end) {
+      return status_ = UnknownError("Write to finished zstd stream");
+    }
+    ZSTD_inBuffer in = {pbase(), static_cast<size_t>(pptr() - pbase()), 0};
+    while (true) {
+      ZSTD_outBuffer out = {out_.data(), out_.size(), 0};
+      size_t remaining = ZSTD_compressStream2(cctx_, &out, &in, mode);
+      if (ZSTD_isError(remaining)) {
+        return status_ = UnknownErrorBuilder()
+            << "zstd compression failed: " << ZSTD_getErrorName(remaining);
+      }
+      if (!sink_->write(out_.data(), out.pos)) {
+        return status_ = UnknownError("Failed to write zstd stream");
+      }
+      bool done = mode == ZSTD_e_continue ? in.pos == in.size
+                                          : remaining == 0;
+      if (done) break;
+    }
+    setp(in_.data(), in_.data() + in_.size());
+    return OkStatus();
+  }
+
+  std::ostream *const sink_;
+  ZSTD_CCtx *const cctx_;
+  std::vector<char> in_;
+  std::vector<char> out_;
+  Status status_;
+  bool finished_ = false;
+};
+
+ZstdOutputStream::ZstdOutputStream(std::ostream *sink, const Options &opts)
+    : std::ostream(nullptr), buf_(std::make_unique<Buf>(sink, opts)) {
+  rdbuf(buf_.get());
+}
+
+ZstdOutputStream::~ZstdOutputStream() { (void)buf_->Finish(); }
+
+Status ZstdOutputStream::Finish() {
+  Status status = buf_->Finish();
+  if (!status.ok()) setstate(std::ios::badbit);
+  return status;
+}
+
+class ZstdInputStream::Buf : public std::streambuf {
+ public:
+  Buf(std::istream *source, std::string_view dictionary)
+      : source_(source), dictionary_(dictionary),
+        in_(ZSTD_DStreamInSize()), out_(ZSTD_DStreamOutSize()) {}
+
+  ~Buf() override { ZSTD_freeDCtx(dctx_); }
+
+  bool compressed() const { return mode_ == Mode::kZstd; }
+  const Status &status() const { return status_; }
+
+ protected:
+  int_type underflow() override {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (!status_.ok()) return traits_type::eof();
+    if (mode_ == Mode::kUnknown) {
+      if (!Detect()) return traits_type::eof();
+    }
+    if (mode_ == Mode::kPlain) return UnderflowPlain();
+    return UnderflowZstd();
+  }
+
+ private:
+  enum class Mode { kUnknown, kPlain, kZstd };
+
+  // Reads the next chunk of `source_` into `in_`. Returns false at its end.
+  bool FillInput() {
+    source_->read(in_.data(), in_.size());
+    in_pos_ = 0;
+    in_size_ = source_->gcount();
+    if (in_size_ == 0 && source_->bad()) {
+      status_ = UnknownError("Failed to read zstd stream");
+    }
+    return in_size_ > 0;
+  }
+
+  // Reads the first chunk of `source_` and decides whether it is compressed.
+  bool Detect() {
+    if (!FillInput()) return false;
+    if (!HasZstdMagic(std::string_view(in_.data(), in_size_))) {
+      mode_ = Mode::kPlain;
+      return true;
+    }
+    mode_ = Mode::kZstd;
+    dctx_ = ZSTD_createDCtx();
+    if (!dictionary_.empty()) {
+      size_t ret = ZSTD_DCtx_loadDictionary(dctx_, dictionary_.data(),
+                                            dictionary_.size());
+      if (ZSTD_isError(ret)) {
+        status_ = InvalidArgumentErrorBuilder()
+            << "Invalid zstd dictionary: " << ZSTD_getErrorName(ret);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int_type UnderflowPlain() {
+    if (in_pos_ == in_size_ && !FillInput()) return traits_type::eof();
+    setg(in_.data() + in_pos_, in_.data() + in_pos_, in_.data() + in_size_);
+    in_pos_ = in_size_;
+    return traits_type::to_int_type(*gptr());
+  }
+
+  int_type UnderflowZstd() {
+    while (true) {
+      // A full output buffer may mean zstd holds more output, which it
+      // produces without further input.
+      if (in_pos_ == in_size_ && !output_full_ && !FillInput()) {
+        if (frame_remaining_ != 0 && status_.ok()) {
+          status_ = UnknownError("Truncated zstd stream");
+        }
+        return traits_type::eof();
+      }
+      ZSTD_inBuffer in = {in_.data(), in_size_, in_pos_};
+      ZSTD_outBuffer out = {out_.data(), out_.size(), 0};
+      size_t ret = ZSTD_decompressStream(dctx_, &out, &in);
+      if (ZSTD_isError(ret)) {
+        status_ = UnknownErrorBuilder()
+            << "zstd decompression failed: " << ZSTD_getErrorName(ret);
+        return traits_type::eof();
+      }
+      in_pos_ = in.pos;
+      frame_remaining_ = ret;
+      output_full_ = out.pos == out.size;
+      if (out.pos > 0) {
+        setg(out_.data(), out_.data(), out_.data() + out.pos);
+        return traits_type::to_int_type(*gptr());
+      }
+    }
+  }
+
+  std::istream *const source_;
+  const std::string_view dictionary_;
+  ZSTD_DCtx *dctx_ = nullptr;
+  Mode mode_ = Mode::kUnknown;
+  std::vector<char> in_;
+  size_t in_pos_ = 0;
+  size_t in_size_ = 0;
+  std::vector<char> out_;
+  bool output_full_ = false;
+  // What ZSTD_decompressStream last returned; 0 at the end of a frame.
+  size_t frame_remaining_ = 0;
+  Status status_;
+};
+
+ZstdInputStream::ZstdInputStream(std::istream *source,
+                                 std::string_view dictionary)
+    : std::istream(nullptr), buf_(std::make_unique<Buf>(source, dictionary)) {
+  rdbuf(buf_.get());
+}
+
+ZstdInputStream::ZstdInputStream(std::unique_ptr<std::istream> source,
+                                 std::string_view dictionary)
+    : ZstdInputStream(source.get(), dictionary) {
+  owned_source_ = std::move(source);
+}
+
+ZstdInputStream::~ZstdInputStream() = default;
+
+bool ZstdInputStream::compressed() const { return buf_->compressed(); }
+
+Status ZstdInputStream::status() const { return buf_->status(); }
+
+bool HasZstdMagic(std::string_view data) {
+  return data.size() >= sizeof(kZstdMagic) &&
+         std::memcmp(data.data(), kZstdMagic, sizeof(kZstdMagic)) == 0;
+}
+
+StatusOr<std::string> TrainZstdDictionary(
+    const std::vector<std::string> &samples, size_t max_size) {
+  std::string concatenated;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const std::string &sample : samples) {
+    concatenated += sample;
+    sizes.push_back(sample.size());
+  }
+  std::string dictionary(max_size, '\0');
+  size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+                                      concatenated.data(), sizes.data(),
+                                      sizes.size());
+  if (ZDICT_isError(size)) {
+    return InvalidArgumentErrorBuilder()
+        << "Failed to train zstd dictionary from " << samples.size()
+        << " samples: " << ZDICT_getErrorName(size);
+  }
+  dictionary.resize(size);
+  return dictionary;
+}
+
+}  // namespace roman
@@ -0,0 +1,82 @@
+#ifndef ROMAN_UTIL_ZSTD_STREAM_H_
+#define ROMAN_UTIL_ZSTD_STREAM_H_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rhutil/status.h"
+
+namespace roman {
+
+// An ostream which zstd compresses everything written to it into `sink`.
+//
+// Data is compressed as it is written, and handed to `sink` whenever zstd's
+// internal buffers fill up or the stream is flushed, so arbitrarily large
+// outputs never need to be in memory at once. Flushing more often than
+// necessary hurts the compression ratio.
+class ZstdOutputStream : public std::ostream {
+ public:
+  struct Options {
+    int level = 19;
+    // A dictionary as trained by TrainZstdDictionary. Readers need the same
+    // dictionary to decompress the output. Must outlive the stream.
+    std::string_view dictionary;
+  };
+
+  ZstdOutputStream(std::ostream *sink, const Options &opts);
+  // Finishes the stream if Finish was not called.
+  ~ZstdOutputStream() override;
+
+  // Ends the zstd frame and flushes `sink`. Nothing may be written after.
+  rhutil::Status Finish();
+
+ private:
+  class Buf;
+  std::unique_ptr<Buf> buf_;
+};
+
+// An istream which reads `source`, decompressing it if it begins with a zstd
+// frame and passing it through unchanged otherwise. Concatenated frames are
+// decompressed one after the other.
+//
+// Decompression happens as the stream is read. A corrupt or truncated input
+// looks like the end of the stream; status() tells it apart.
+class ZstdInputStream : public std::istream {
+ public:
+  // `dictionary` is needed if `source` was compressed with one, and must
+  // outlive the stream.
+  explicit ZstdInputStream(std::istream *source,
+                           std::string_view dictionary = {});
+  ZstdInputStream(std::unique_ptr<std::istream> source,
+                  std::string_view dictionary = {});
+  ~ZstdInputStream() override;
+
+  // Whether the source was zstd compressed. Only known once something has
+  // been read.
+  bool compressed() const;
+
+  // The error which ended the stream early, if any.
+  rhutil::Status status() const;
+
+ private:
+  class Buf;
+  std::unique_ptr<std::istream> owned_source_;
+  std::unique_ptr<Buf> buf_;
+};
+
+// Whether `data` begins with a zstd frame.
+bool HasZstdMagic(std::string_view data);
+
+// Trains a dictionary of at most `max_size` bytes for compressing data which
+// resembles `samples`. zstd needs many small samples, and a few hundred
+// times more sample data than dictionary.
+rhutil::StatusOr<std::string> TrainZstdDictionary(
+    const std::vector<std::string> &samples, size_t max_size);
+
+}  // namespace roman
+
+#endif  // ROMAN_UTIL_ZSTD_STREAM_H_
@@ -0,0 +1,91 @@
+#include "roman/verify/completeness.h"
+
+#include "absl/algorithm/container.h"
+
+namespace roman {
+
+using ::dat2pb::RomDat;
+using ::rhutil::NotFoundErrorBuilder;
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+
+Completeness::Completeness(const RomDat &dat) : dat_(dat) {
+  first_rom_.reserve(dat.game_size() + 1);
+  games_by_name_.reserve(dat.game_size());
+  std::int64_t roms = 0;
+  for (int i = 0; i < dat.game_size(); i++) {
+    first_rom_.push_back(roms);
+    roms += dat.game(i).rom_size();
+    games_by_name_.emplace(dat.game(i).name(), i);
+  }
+  first_rom_.push_back(roms);
+  found_.resize(roms);
+}
+
+Status Completeness::Add(const GameIndex::Game &game) {
+  auto it = games_by_name_.find(game.dat().name());
+  if (it == games_by_name_.end()) {
+    return NotFoundErrorBuilder()
+        << "Game " << game.dat().name() << " is not in the dat";
+  }
+  const RomDat::Game &dat_game = dat_.game(it->second);
+  std::int64_t first = first_rom_[it->second];
+
+  // Nothing is marked until every ROM has matched, so that a game with a ROM
+  // the dat lacks counts towards nothing.
+  std::vector<std::int64_t> matches;
+  matches.reserve(game.rom_size());
+  auto taken = [this, &matches](std::int64_t rom) {
+    return found_[rom] || absl::c_linear_search(matches, rom);
+  };
+  for (const GameIndex::Game::Rom &rom : game.rom()) {
+    // Games rarely have more than a few dozen ROMs, so a scan is cheaper
+    // than an index. A dat may list identical ROMs more than once (e.g. the
+    // same track in two versions), so prefer one not yet found.
+    std::int64_t match = -1;
+    for (int j = 0; j < dat_game.rom_size(); j++) {
+      const RomDat::Game::Rom &dat_rom = dat_game.rom(j);
+      if (dat_rom.name() != rom.dat().name() ||
+          dat_rom.size() != rom.dat().size()) {
+        continue;
+      }
+      match = first + j;
+      if (!taken(match)) break;
+    }
+    if (match == -1) {
+      return NotFoundErrorBuilder()
+          << "ROM " << rom.dat().name() << " of game " << game.dat().name()
+          << " is not in the dat";
+    }
+    matches.push_back(match);
+  }
+  for (std::int64_t match : matches) found_[match] = true;
+  return OkStatus();
+}
+
+Completeness::Counts Completeness::Classify(
+    const std::function<void(const RomDat::Game &, State)> &callback) const {
+  Counts counts;
+  for (int i = 0; i < dat_.game_size(); i++) {
+    std::int64_t found = 0;
+    for (std::int64_t r = first_rom_[i]; r < first_rom_[i + 1]; r++) {
+      found += found_[r];
+    }
+    std::int64_t total = first_rom_[i + 1] - first_rom_[i];
+    State state;
+    if (found == total) {
+      state = State::kComplete;
+      counts.complete++;
+    } else if (found == 0) {
+      state = State::kMissing;
+      counts.missing++;
+    } else {
+      state = State::kIncomplete;
+      counts.incomplete++;
+    }
+    if (callback) callback(dat_.game(i), state);
+  }
+  return counts;
+}
+
+}  // namespace roman
@@ -0,0 +1,64 @@
+#ifndef ROMAN_VERIFY_COMPLETENESS_H_
+#define ROMAN_VERIFY_COMPLETENESS_H_
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "dat2pb/romdat.pb.h"
+#include "rhutil/status.h"
+#include "roman/index/game_index.pb.h"
+
+namespace roman {
+
+// Works out which of a dat's games an index holds completely, partly or not
+// at all.
+//
+// Found ROMs are tracked in a dense bitset indexed by each ROM's ordinal in
+// the dat (its game's first ordinal plus its position within the game), so
+// that besides the dat itself this needs a bit per ROM and a few words per
+// game, rather than a set of hashes.
+class Completeness {
+ public:
+  enum class State {
+    kComplete,
+    kIncomplete,
+    kMissing,
+  };
+
+  struct Counts {
+    std::int64_t complete = 0;
+    std::int64_t incomplete = 0;
+    std::int64_t missing = 0;
+  };
+
+  // `dat` must outlive the Completeness.
+  explicit Completeness(const dat2pb::RomDat &dat);
+
+  Completeness(const Completeness &) = delete;
+  Completeness &operator=(const Completeness &) = delete;
+
+  // Marks the ROMs of an indexed game as found. Returns NotFound, marking
+  // none of them, if the dat has no such game or ROM, e.g. because the index
+  // was built from another version of the dat.
+  rhutil::Status Add(const GameIndex::Game &game);
+
+  // Classifies every game of the dat, in dat order, with a single pass over
+  // the bitset.
+  Counts Classify(
+      const std::function<void(const dat2pb::RomDat::Game &, State)>
+          &callback = nullptr) const;
+
+ private:
+  const dat2pb::RomDat &dat_;
+  // The ordinal of each game's first ROM, with a final entry for the total.
+  std::vector<std::int64_t> first_rom_;
+  absl::flat_hash_map<std::string_view, int> games_by_name_;
+  std::vector<bool> found_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_VERIFY_COMPLETENESS_H_
@@ -0,0 +1,98 @@
+#include "roman/verify/deep_verifier.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "roman/hash.h"
+#include "roman/hash/content_hasher.h"
+#include "roman/util/bounded_queue.h"
+#include "roman/util/thread_pool.h"
+
+namespace roman {
+
+using ::rhutil::OkStatus;
+using ::rhutil::Status;
+using ::rhutil::UnknownError;
+
+namespace {
+
+// The hashes the dat records for `rom`, most trustworthy first.
+std::vector<Hash> DatHashes(const dat2pb::RomDat::Game::Rom &rom) {
+  std::vector<Hash> hashes;
+  if (!rom.sha1().empty()) hashes.emplace_back(Hash::SHA1, rom.sha1());
+  if (!rom.md5().empty()) hashes.emplace_back(Hash::MD5, rom.md5());
+  if (!rom.crc().empty()) hashes.emplace_back(Hash::CRC, rom.crc());
+  return hashes;
+}
+
+}  // namespace
+
+void DeepVerifier::Verify(std::string_view fs,
+                          absl::Span<const IndexedRom> roms,
+                          const std::function<void(Result)> &callback) {
+  absl::Mutex mu;
+  ThreadPool pool(opts_.concurrency);
+  for (const auto &[game, rom] : roms) {
+    pool.Schedule([&, game = game, rom = rom]() {
+      std::int64_t bytes = 0;
+      std::string problem = VerifyRom(fs, *rom, &bytes);
+      absl::MutexLock lock(&mu);
+      stats_.files++;
+      stats_.bytes += bytes;
+      callback(Result{game, rom, std::move(problem)});
+    });
+  }
+  pool.Wait();
+}
+
+std::string DeepVerifier::VerifyRom(std::string_view fs,
+                                    const GameIndex::Game::Rom &rom,
+                                    std::int64_t *bytes) const {
+  std::vector<Hash> expected = DatHashes(rom.dat());
+  std::vector<Hash::Type> types;
+  for (const Hash &hash : expected) types.push_back(hash.GetType());
+  ContentHasher hasher(types);
+
+  BoundedQueue<std::string> chunks(opts_.queue_depth);
+  Status read_status = OkStatus();
+  std::thread download([&]() {
+    read_status = reader_.Read(fs, rom.path(), [&](std::string chunk) {
+      if (!chunks.Push(std::move(chunk))) {
+        return UnknownError("Hashing stopped");
+      }
+      return OkStatus();
+    });
+    chunks.Close();
+  });
+  while (std::optional<std::string> chunk = chunks.Pop()) {
+    hasher.Update(*chunk);
+  }
+  download.join();
+  *bytes = hasher.size();
+
+  if (!read_status.ok()) {
+    std::ostringstream problem;
+    problem << "read failed: " << read_status;
+    return problem.str();
+  }
+  if (hasher.size() != static_cast<std::int64_t>(rom.dat().size())) {
+    return absl::StrCat("size is ", hasher.size(), ", expected ",
+                        rom.dat().size());
+  }
+  std::vector<Hash> actual = hasher.Finalize();
+  for (std::size_t i = 0; i < expected.size(); i++) {
+    if (!absl::EqualsIgnoreCase(actual[i].GetValue(),
+                                expected[i].GetValue())) {
+      return absl::StrCat(Hash::TypeToString(expected[i].GetType()), " is ",
+                          actual[i].GetValue(), ", expected ",
+                          expected[i].GetValue());
+    }
+  }
+  return "";
+}
+
+}  // namespace roman
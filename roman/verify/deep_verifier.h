@@ -0,0 +1,71 @@
+#ifndef ROMAN_VERIFY_DEEP_VERIFIER_H_
+#define ROMAN_VERIFY_DEEP_VERIFIER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/types/span.h"
+#include "roman/index/game_index.pb.h"
+#include "roman/rclone/remote_file_reader.h"
+
+namespace roman {
+
+// Checks indexed ROMs against their dat entries by streaming their contents
+// through rclone and hashing them locally, rather than trusting the hashes the
+// remote reports.
+//
+// Several files are verified at once. For each, one thread downloads while
+// another hashes, with up to Options::queue_depth chunks buffered between
+// them, so that neither the network nor the CPU waits on the other.
+class DeepVerifier {
+ public:
+  struct Options {
+    RemoteFileReader::Options reader;
+    // How many files to verify at once.
+    int concurrency = 4;
+    int queue_depth = 4;
+  };
+
+  using IndexedRom =
+      std::pair<const GameIndex::Game*, const GameIndex::Game::Rom*>;
+
+  struct Result {
+    const GameIndex::Game *game;
+    const GameIndex::Game::Rom *rom;
+    // Empty if the contents match the dat.
+    std::string problem;
+  };
+
+  struct Stats {
+    std::int64_t files = 0;
+    std::int64_t bytes = 0;
+  };
+
+  explicit DeepVerifier(const Options &opts)
+      : opts_(opts), reader_(opts.reader) {}
+
+  // Verifies each of `roms`, whose paths are relative to `fs` (e.g.
+  // "gdrive:"), and calls `callback` with the result for each. Calls to
+  // `callback` are serialized, but come from worker threads in no particular
+  // order. Failures to read a file are reported as problems with it.
+  void Verify(std::string_view fs, absl::Span<const IndexedRom> roms,
+              const std::function<void(Result)> &callback);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  // Returns a description of what is wrong with `rom`, or the empty string.
+  std::string VerifyRom(std::string_view fs, const GameIndex::Game::Rom &rom,
+                        std::int64_t *bytes) const;
+
+  Options opts_;
+  RemoteFileReader reader_;
+  Stats stats_;
+};
+
+}  // namespace roman
+
+#endif  // ROMAN_VERIFY_DEEP_VERIFIER_H_